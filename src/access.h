@@ -33,32 +33,22 @@
 extern const struct parport_access_methods io_access_methods;
 extern const struct parport_access_methods ppdev_access_methods;
 extern const struct parport_access_methods lpt_access_methods;
+extern const struct parport_access_methods sim_access_methods;
 
 #ifdef _MSC_VER
 /* Visual C++ doesn't allow inline in C source code */
 #define inline __inline
 #endif
 
+/* IO_POLL_DELAY is a back-off between polls, so it gives up the CPU.
+ * The others are settling times, and are kept short by busy-waiting. */
 static inline void
 delay (int which)
 {
-  struct timeval tv;
-  lookup_delay (which, &tv);
-#if !(defined __MINGW32__ || defined _MSC_VER)
-  select (0, NULL, NULL, NULL, &tv);
-#else
-	{
-		struct timeb tb;
-		long int t0, t1;
-	
-		ftime(&tb);
-		t0 = tb.time * 1000 + tb.millitm;
-		do {
-			ftime(&tb);
-			t1 = tb.time * 1000 + tb.millitm;
-		} while (t1 - t0 < (tv.tv_sec * 1000 + tv.tv_usec / 1000));
-	}
-#endif
+  if (which == IO_POLL_DELAY)
+    usleep_poll (delay_table[which]);
+  else
+    udelay (delay_table[which]);
 }
 
 #if defined(HAVE_NBSD_I386)
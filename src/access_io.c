@@ -37,15 +37,24 @@
 #ifdef __unix__
 #include <unistd.h>
 #endif
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
 
 #include "access.h"
+#include "conf.h"
 #include "debug.h"
 #include "default.h"
 #include "delay.h"
 #include "ieee1284.h"
 #include "detect.h"
+#include "ecr.h"
+#include "epp.h"
 #include "parport.h"
 #include "ppdev.h"
+#include "shadow.h"
+#include "stats.h"
+#include "trace.h"
 
 #ifdef HAVE_LINUX
 
@@ -181,14 +190,84 @@ raw_outb (struct parport_internal *port, unsigned char val, unsigned long addr)
 #endif
 }
 
+/* outb_p follows each write with a write to port 0x80, which stalls
+ * the bus for about a microsecond.  Ports that keep up without it
+ * can use this instead; the engines' own delays still give the
+ * IEEE 1284 setup and hold times. */
+static void
+raw_outb_nopause (struct parport_internal *port, unsigned char val,
+		  unsigned long addr)
+{
+#if ((defined(HAVE_LINUX) && defined(HAVE_SYS_IO_H)) \
+	|| defined(HAVE_CYGWIN_9X) || defined(HAVE_OBSD_I386) \
+	|| defined(HAVE_FBSD_I386) || defined(HAVE_NBSD_i386)) \
+	&& (defined(__i386__) || defined(__x86_64__) || defined(_MSC_VER))
+  outb (val, (unsigned short)addr);
+#else
+  raw_outb (port, val, addr);
+#endif
+}
+
+#if defined(HAVE_LINUX) && defined(HAVE_SYS_IO_H) \
+	&& (defined(__i386__) || defined(__x86_64__))
+/* Wide access, for ECP FIFOs with 16- and 32-bit PWords, and for
+ * fast EPP. */
+static unsigned short
+raw_inw (struct parport_internal *port, unsigned long addr)
+{
+  return inw ((unsigned short)addr);
+}
+
+static void
+raw_outw (struct parport_internal *port, unsigned short val,
+	  unsigned long addr)
+{
+  outw (val, (unsigned short)addr);
+}
+
+static unsigned int
+raw_inl (struct parport_internal *port, unsigned long addr)
+{
+  return inl ((unsigned short)addr);
+}
+
+static void
+raw_outl (struct parport_internal *port, unsigned int val,
+	  unsigned long addr)
+{
+  outl (val, (unsigned short)addr);
+}
+#else
+#define raw_inw NULL
+#define raw_outw NULL
+#define raw_inl NULL
+#define raw_outl NULL
+#endif
+
+/* /dev/port is read and written at the offset of the I/O port, so
+ * each access is a single positional read or write where the C
+ * library has them.  That also leaves the file offset alone, so
+ * nothing else sharing the descriptor can move it between the seek
+ * and the access. */
+static ssize_t
+port_pread (struct parport_internal *port, void *buf, size_t n,
+	    unsigned long addr)
+{
+  port->stats.c.syscalls++;
+#ifdef HAVE_PREAD
+  return pread (port->fd, buf, n, (off_t) addr);
+#else
+  if (lseek (port->fd, addr, SEEK_SET) == (off_t)-1)
+    return -1;
+  return read (port->fd, buf, n);
+#endif
+}
+
 static unsigned char
 port_inb (struct parport_internal *port, unsigned long addr)
 {
   unsigned char byte = 0xff;
-
-  if (lseek (port->fd, addr, SEEK_SET) != (off_t)-1)
-    read (port->fd, &byte, 1);
-
+  port_pread (port, &byte, 1, addr);
   return byte;
 }
 
@@ -196,23 +275,240 @@ static void
 port_outb (struct parport_internal *port, unsigned char val,
 	   unsigned long addr)
 {
+  port->stats.c.syscalls++;
+#ifdef HAVE_PWRITE
+  pwrite (port->fd, &val, 1, (off_t) addr);
+#else
   if (lseek (port->fd, addr, SEEK_SET) != (off_t)-1)
     write (port->fd, &val, 1);
+#endif
+}
+
+/* The kernel reads a run of bytes from /dev/port one port at a time,
+ * in ascending order, so these are inb at ADDR, ADDR+1, ... in one
+ * system call rather than true word reads.  That is what the EPP
+ * data register wants: each of base+4..base+7 is a data cycle.
+ * There are no matching writes, since a run written at the ECP data
+ * FIFO would carry on into cnfgB. */
+static unsigned short
+port_inw (struct parport_internal *port, unsigned long addr)
+{
+  unsigned char b[2] = { 0xff, 0xff };
+  port_pread (port, b, 2, addr);
+  return (unsigned short) (b[0] | b[1] << 8);
+}
+
+static unsigned int
+port_inl (struct parport_internal *port, unsigned long addr)
+{
+  unsigned char b[4] = { 0xff, 0xff, 0xff, 0xff };
+  port_pread (port, b, 4, addr);
+  return ((unsigned int) b[0] | (unsigned int) b[1] << 8 |
+	  (unsigned int) b[2] << 16 | (unsigned int) b[3] << 24);
+}
+
+/* Read the data register and then the status register, which sit
+ * next to each other, in one system call. */
+static void
+port_sample (struct parport_internal *port, unsigned char *data,
+	     unsigned char *status)
+{
+#ifdef HAVE_PREADV
+  struct iovec iov[2];
+
+  *data = *status = 0xff;
+  iov[0].iov_base = data;
+  iov[0].iov_len = 1;
+  iov[1].iov_base = status;
+  iov[1].iov_len = 1;
+  port->stats.c.syscalls++;
+  preadv (port->fd, iov, 2, (off_t) port->base);
+#else
+  unsigned char b[2] = { 0xff, 0xff };
+  port_pread (port, b, 2, port->base);
+  *data = b[0];
+  *status = b[1];
+#endif
+}
+
+/* Register access for the engines below.  These do what read_status,
+ * write_data and raw_frob_control do, and keep the shadow registers
+ * up to date, but take the inb and outb functions as arguments so
+ * that, once inlined, each engine calls them directly. */
+typedef unsigned char (*inb_fn) (struct parport_internal *port,
+				 unsigned long addr);
+typedef void (*outb_fn) (struct parport_internal *port, unsigned char val,
+			 unsigned long addr);
+
+static inline unsigned char
+io_read_status (struct parport_internal *port, inb_fn in)
+{
+  unsigned char st = (unsigned char) (in (port, port->base + 1) ^
+				      S1284_INVERTED);
+  TRACE_STATUS (port, st);
+  return st;
+}
+
+static inline unsigned char
+io_read_data (struct parport_internal *port, inb_fn in)
+{
+  unsigned char d = in (port, port->base);
+  TRACE_DATA (port, d);
+  return d;
+}
+
+static inline void
+io_write_data (struct parport_internal *port, unsigned char val, outb_fn out)
+{
+  struct shadow_regs *sh = &port->shadow;
+
+  if ((sh->valid & SHADOW_DATA) && sh->data == val)
+    {
+      sh->skipped++;
+      return;
+    }
+
+  out (port, val, port->base);
+  sh->data = val;
+  sh->valid |= SHADOW_DATA;
+  TRACE_DATA (port, val);
+}
+
+/* MASK and VAL are as for frob_control, and may include the
+ * direction bit. */
+static inline void
+io_frob_control (struct parport_internal *port, unsigned char mask,
+		 unsigned char val, outb_fn out)
+{
+  const unsigned char wm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  struct shadow_regs *sh = &port->shadow;
+  unsigned char ctr = (port->ctr & ~mask) ^ (val ^ (mask & C1284_INVERTED));
+
+  /* Once the register has been written, port->ctr is what it holds. */
+  if ((sh->valid & SHADOW_CTR) && ctr == port->ctr)
+    {
+      sh->skipped++;
+      return;
+    }
+
+  out (port, ctr, port->base + 2);
+  port->ctr = ctr;
+  sh->ctr = (ctr ^ C1284_INVERTED) & wm;
+  sh->reverse = (ctr & 0x20) ? 1 : 0;
+  sh->valid |= SHADOW_CTR | SHADOW_DIR;
+  TRACE_CONTROL (port, sh->ctr);
+  TRACE_DIR (port, sh->reverse);
+}
+
+#define ENGINE_SCOPE static
+#define ENGINE_READ_DATA(port) io_read_data (port, ENGINE_IN)
+#define ENGINE_WRITE_DATA(port, val) io_write_data (port, val, ENGINE_OUT)
+#define ENGINE_READ_STATUS(port) io_read_status (port, ENGINE_IN)
+#define ENGINE_WRITE_CONTROL(port, ct)					\
+  io_frob_control (port, (C1284_NSTROBE | C1284_NAUTOFD |		\
+			  C1284_NINIT | C1284_NSELECTIN), ct, ENGINE_OUT)
+#define ENGINE_FROB_CONTROL(port, mask, val) \
+  io_frob_control (port, mask, val, ENGINE_OUT)
+#define ENGINE_DATA_DIR(port, reverse) \
+  io_frob_control (port, 0x20, (unsigned char)(reverse ? 0x20 : 0x00), \
+		   ENGINE_OUT)
+#define ENGINE_WAIT_STATUS(port, mask, val, timeout) \
+  ENGINE (poll_lines) (port, 1, mask, val, timeout)
+
+/* Engines for ports we can reach with inb and outb. */
+#define ENGINE(name) raw_##name
+#define ENGINE_TAG "raw"
+#define ENGINE_IN raw_inb
+#define ENGINE_OUT raw_outb
+#include "engine.h"
+#undef ENGINE
+#undef ENGINE_TAG
+#undef ENGINE_IN
+#undef ENGINE_OUT
+
+/* Engines for ports we reach with inb and outb, without the pause. */
+#define ENGINE(name) nopause_##name
+#define ENGINE_TAG "nopause"
+#define ENGINE_IN raw_inb
+#define ENGINE_OUT raw_outb_nopause
+#include "engine.h"
+#undef ENGINE
+#undef ENGINE_TAG
+#undef ENGINE_IN
+#undef ENGINE_OUT
+
+/* Engines for ports we reach through /dev/port. */
+#define ENGINE(name) port_##name
+#define ENGINE_TAG "port"
+#define ENGINE_IN port_inb
+#define ENGINE_OUT port_outb
+#include "engine.h"
+#undef ENGINE
+#undef ENGINE_TAG
+#undef ENGINE_IN
+#undef ENGINE_OUT
+
+/* Before doing without the pause, check that the port keeps up:
+ * each value written to the data register, even straight after
+ * another, should read back at once.  That only shows the register
+ * latches the writes, not that the lines meet the IEEE 1284 setup
+ * and hold times; the engines still time those themselves.  The
+ * data register is put back afterwards. */
+static int
+nopause_selftest (struct parport_internal *port)
+{
+  static const unsigned char pattern[] = { 0x00, 0xff, 0x55, 0xaa,
+					   0x0f, 0xf0, 0x00 };
+  const size_t n = sizeof pattern / sizeof pattern[0];
+  unsigned char data;
+  size_t i;
+  int ok = 1;
+
+  /* In reverse, the data register reads the peripheral's lines. */
+  if (raw_inb (port, port->base + 2) & 0x20)
+    return 0;
+
+  data = raw_inb (port, port->base);
+  for (i = 0; ok && i < n; i++)
+    {
+      raw_outb_nopause (port, pattern[i], port->base);
+      if (raw_inb (port, port->base) != pattern[i])
+	ok = 0;
+    }
+
+  for (i = 0; ok && i + 1 < n; i++)
+    {
+      raw_outb_nopause (port, pattern[i], port->base);
+      raw_outb_nopause (port, pattern[i + 1], port->base);
+      if (raw_inb (port, port->base) != pattern[i + 1])
+	ok = 0;
+    }
+
+  raw_outb (port, data, port->base);
+  return ok;
 }
 
 static int
 init (struct parport *pport, int flags, int *capabilities)
 {
   struct parport_internal *port = pport->priv;
+  int epp_regs = 1;
 #ifdef HAVE_SOLARIS
   struct iopbuf tmpbuf;
 #elif defined(HAVE_OBSD_I386)
   u_long *iomap;
 #endif
 
-  if (flags)
+  if (flags & ~(F1284_NOPAUSE | F1284_DIRECTIO))
     return E1284_NOTAVAIL;
 
+  /* ECP registers, if any, are usually here. */
+  if (!port->base_hi)
+    port->base_hi = port->base + 0x400;
+
   /* TODO: To support F1284_EXCL here we need to open the relevant
    * /dev/lp device. */
 
@@ -223,6 +519,19 @@ init (struct parport *pport, int flags, int *capabilities)
 #ifdef HAVE_SYS_IO_H
       if (ioperm (port->base, 3, 1) || ioperm (0x80, 1, 1))
         return E1284_INIT;
+      if (ioperm (port->base_hi, 3, 1))
+	{
+	  debugprintf ("No access to ECP registers at %#lx\n",
+		       port->base_hi);
+	  port->base_hi = 0;
+	}
+      /* The EPP registers are optional too. */
+      if (ioperm (port->base + 3, 5, 1))
+	{
+	  debugprintf ("No access to EPP registers at %#lx\n",
+		       port->base + 3);
+	  epp_regs = 0;
+	}
 #else
       return E1284_SYS; /* might not be the best error code to use */
 #endif /* HAVE_SYS_IO_H */
@@ -282,23 +591,79 @@ init (struct parport *pport, int flags, int *capabilities)
 	return E1284_INIT;
       port->fn->do_inb = port_inb;
       port->fn->do_outb = port_outb;
+      port->fn->do_inw = port_inw;
+      port->fn->do_outw = NULL;
+      port->fn->do_inl = port_inl;
+      port->fn->do_outl = NULL;
+      port->fn->nibble_read = port_nibble_read;
+      port->fn->compat_write = port_compat_write;
+      port->fn->byte_read = port_byte_read;
+      port->fn->epp_read_data = port_epp_read_data;
+      port->fn->epp_write_data = port_epp_write_data;
+      port->fn->ecp_read_data = port_ecp_read_data;
+      port->fn->ecp_write_data = port_ecp_write_data;
+      port->fn->ecp_write_addr = port_ecp_write_addr;
       break;
     }
 
   if (capabilities)
     *capabilities |= CAP1284_RAW;
 
-  /* Need to write this.
-   * If we find an ECP port, we can adjust some of the access function
-   * pointers in io_access_functions to point to functions that use
-   * hardware assistance. */
+  port->hw_probe = HW_PROBE_PENDING | (epp_regs ? HW_PROBE_EPP : 0);
+  if (port->type == IO_CAPABLE &&
+      ((flags & F1284_NOPAUSE) || conf.no_io_pause))
+    port->hw_probe |= HW_PROBE_NOPAUSE;
+  return E1284_OK;
+}
 
+/* Run the self-test for F1284_NOPAUSE, and look for the ECR and EPP
+ * registers, the first time the port is claimed, not at open: until
+ * then another driver may be using the port, and these write to
+ * it. */
+static int
+claim (struct parport_internal *port)
+{
+  if (!(port->hw_probe & HW_PROBE_PENDING))
+    return E1284_OK;
+
+  /* First, so that the ECR and EPP methods installed below are not
+   * replaced. */
+  if (port->hw_probe & HW_PROBE_NOPAUSE)
+    {
+      if (nopause_selftest (port))
+	{
+	  debugprintf ("Writing to %#lx without pausing\n", port->base);
+	  port->fn->do_outb = raw_outb_nopause;
+	  port->fn->nibble_read = nopause_nibble_read;
+	  port->fn->compat_write = nopause_compat_write;
+	  port->fn->byte_read = nopause_byte_read;
+	  port->fn->epp_read_data = nopause_epp_read_data;
+	  port->fn->epp_write_data = nopause_epp_write_data;
+	  port->fn->ecp_read_data = nopause_ecp_read_data;
+	  port->fn->ecp_write_data = nopause_ecp_write_data;
+	  port->fn->ecp_write_addr = nopause_ecp_write_addr;
+	}
+      else
+	debugprintf ("Port at %#lx failed the self-test; pausing\n",
+		     port->base);
+    }
+
+  /* If there is an ECP port, use its FIFO for ECP transfers, and
+   * if there are EPP registers, use them for EPP. */
+#ifdef HAVE_LINUX
+  ecr_install (port);
+  if (port->hw_probe & HW_PROBE_EPP)
+    epp_install (port);
+#endif
+
+  port->hw_probe = 0;
   return E1284_OK;
 }
 
 static void
 cleanup (struct parport_internal *port)
 {
+  ecr_cleanup (port);
   if (port->type != IO_CAPABLE && port->fd >= 0)
     close (port->fd);
 #if defined(HAVE_FBSD_I386) || defined (HAVE_SOLARIS)
@@ -310,7 +675,9 @@ cleanup (struct parport_internal *port)
 static int
 read_data (struct parport_internal *port)
 {
-  return port->fn->do_inb (port, port->base);
+  unsigned char d = port->fn->do_inb (port, port->base);
+  TRACE_DATA (port, d);
+  return d;
 }
 
 static void
@@ -322,8 +689,10 @@ write_data (struct parport_internal *port, unsigned char reg)
 static int
 read_status (struct parport_internal *port)
 {
-  return debug_display_status ((unsigned char)
-    (port->fn->do_inb (port, port->base + 1) ^ S1284_INVERTED));
+  unsigned char st = (unsigned char) (port->fn->do_inb (port, port->base + 1)
+				      ^ S1284_INVERTED);
+  TRACE_STATUS (port, st);
+  return st;
 }
 
 static void
@@ -337,7 +706,10 @@ raw_frob_control (struct parport_internal *port,
   ctr = (ctr & ~mask) ^ val;
   port->fn->do_outb (port, ctr, port->base + 2);
   port->ctr = ctr;
-  debug_frob_control (mask, val);
+  TRACE_CONTROL (port, (ctr ^ C1284_INVERTED) & (C1284_NSTROBE |
+						 C1284_NAUTOFD |
+						 C1284_NINIT |
+						 C1284_NSELECTIN));
 }
 
 static int
@@ -393,47 +765,91 @@ frob_control (struct parport_internal *port,
   raw_frob_control (port, mask, val);
 }
 
-static int
-wait_status (struct parport_internal *port,
-	     unsigned char mask, unsigned char val,
-	     struct timeval *timeout)
+/* Pin programs run straight against the registers, without going
+ * through the access methods for each operation. */
+static ssize_t
+pin_program (struct parport_internal *port,
+	     const struct ieee1284_pin_op *ops, size_t nops,
+	     unsigned char *out)
 {
-  /* Simple-minded polling.  TODO: Use David Paschal's method for this. */
-#if !(defined __MINGW32__ || defined _MSC_VER)
-  struct timeval deadline, now;
-  gettimeofday (&deadline, NULL);
-  deadline.tv_sec += timeout->tv_sec;
-  deadline.tv_usec += timeout->tv_usec;
-  deadline.tv_sec += deadline.tv_usec / 1000000;
-  deadline.tv_usec %= 1000000;
-#else
-  struct timeb tb;
-  int deadline, now;
-  ftime (&tb);
-  deadline = tb.time * 1000 + tb.millitm +
-             timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
-#endif
+  const unsigned char wm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  unsigned char (*in) (struct parport_internal *, unsigned long);
+  void (*out_) (struct parport_internal *, unsigned char, unsigned long);
+  const unsigned long base = port->base;
+  struct timeval tv;
+  size_t i;
+
+  in = port->fn->do_inb;
+  out_ = port->fn->do_outb;
+
+  /* The writes below go around the shadow registers. */
+  shadow_invalidate (port);
 
-  do
+  for (i = 0; i < nops; i++)
     {
-      if ((debug_display_status ((unsigned char)(read_status (port))) & mask) == val)
-        return E1284_OK;
+      const struct ieee1284_pin_op *op = &ops[i];
+      unsigned char mask;
+      int ret = E1284_OK;
 
-      delay (IO_POLL_DELAY);
-#if !(defined __MINGW32__ || defined _MSC_VER)
-      gettimeofday (&now, NULL);
-    }
-  while (now.tv_sec < deadline.tv_sec ||
-        (now.tv_sec == deadline.tv_sec &&
-	  now.tv_usec < deadline.tv_usec));
-#else
-      ftime (&tb);
-      now = tb.time * 1000 + tb.millitm;
+      switch (op->op)
+	{
+	case P1284_WRITE_DATA:
+	  out_ (port, op->val, base);
+	  break;
+
+	case P1284_FROB_CONTROL:
+	  mask = op->mask & wm;
+	  port->ctr = ((port->ctr & ~mask) ^
+		       ((op->val & wm) ^ (mask & C1284_INVERTED)));
+	  out_ (port, port->ctr, base + 2);
+	  break;
+
+	case P1284_DATA_DIR:
+	  port->ctr = (port->ctr & ~0x20) | (op->val ? 0x20 : 0);
+	  out_ (port, port->ctr, base + 2);
+	  break;
+
+	case P1284_WAIT_STATUS:
+	  tv.tv_sec = op->usec / 1000000;
+	  tv.tv_usec = op->usec % 1000000;
+	  ret = default_wait_status (port, op->mask, op->val, &tv);
+	  break;
+
+	case P1284_READ_DATA:
+	  if (port->type == DEV_PORT_CAPABLE && i + 1 < nops &&
+	      ops[i + 1].op == P1284_READ_STATUS)
+	    {
+	      /* Data then status is one read through /dev/port. */
+	      port_sample (port, out, out + 1);
+	      out[1] ^= S1284_INVERTED;
+	      out += 2;
+	      i++;
+	      break;
+	    }
+
+	  *out++ = in (port, base);
+	  break;
+
+	case P1284_READ_STATUS:
+	  *out++ = in (port, base + 1) ^ S1284_INVERTED;
+	  break;
+
+	case P1284_DELAY:
+	  udelay (op->usec);
+	  break;
+
+	default:
+	  ret = E1284_NOTIMPL;
+	}
+
+      if (ret < 0)
+	return i ? (ssize_t) i : ret;
     }
-  while (now < deadline);
-#endif
 
-  return E1284_TIMEDOUT;
+  return nops;
 }
 
 const struct parport_access_methods io_access_methods =
@@ -441,11 +857,15 @@ const struct parport_access_methods io_access_methods =
   init,
   cleanup,
 
-  NULL, /* claim */
+  claim,
   NULL, /* release */
 
   raw_inb,
   raw_outb,
+  raw_inw,
+  raw_outw,
+  raw_inl,
+  raw_outl,
 
   NULL, /* get_irq_fd */
   NULL, /* clear_irq */
@@ -456,7 +876,7 @@ const struct parport_access_methods io_access_methods =
   data_dir,
 
   read_status,
-  wait_status,
+  default_wait_status,
 
   read_control,
   write_control,
@@ -467,18 +887,19 @@ const struct parport_access_methods io_access_methods =
   default_terminate,
   default_ecp_fwd_to_rev,
   default_ecp_rev_to_fwd,
-  default_nibble_read,
-  default_compat_write,
-  default_byte_read,
-  default_epp_read_data,
-  default_epp_write_data,
+  raw_nibble_read,
+  raw_compat_write,
+  raw_byte_read,
+  raw_epp_read_data,
+  raw_epp_write_data,
   default_epp_read_addr,
   default_epp_write_addr,
-  default_ecp_read_data,
-  default_ecp_write_data,
+  raw_ecp_read_data,
+  raw_ecp_write_data,
   default_ecp_read_addr,
-  default_ecp_write_addr,
-  default_set_timeout
+  raw_ecp_write_addr,
+  default_set_timeout,
+  pin_program
 };
 
 /*
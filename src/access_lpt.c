@@ -47,6 +47,7 @@
 #include "ieee1284.h"
 #include "detect.h"
 #include "parport.h"
+#include "trace.h"
 
 
 #ifdef HAVE_CYGWIN_NT
@@ -65,7 +66,8 @@ init (struct parport *pport, int flags, int *capabilities)
   struct parport_internal *port = pport->priv;
 
   /* Note: We can only ever provide exclusive access on NT. */
-  if (flags & ~F1284_EXCL) /* silently ignore F1284_EXCL - dbjh */
+  if (flags & ~(F1284_EXCL | F1284_NOPAUSE | F1284_DIRECTIO))
+    /* silently ignore F1284_EXCL - dbjh */
     return E1284_NOTAVAIL;
 
   port->fd = (int)CreateFile(port->device, GENERIC_READ | GENERIC_WRITE,
@@ -118,7 +120,8 @@ read_status (struct parport_internal *port)
           sizeof(ret), (LPDWORD)&dummy, NULL)))
       debugprintf("read_status: DeviceIoControl failed!\n");
 
-  return debug_display_status ((unsigned char)(ret ^ S1284_INVERTED));
+  TRACE_STATUS (port, ret ^ S1284_INVERTED);
+  return (unsigned char) (ret ^ S1284_INVERTED);
 }
 
 static void
@@ -136,7 +139,10 @@ raw_frob_control (struct parport_internal *port,
           sizeof(ctr), &dummyc, sizeof(dummyc), (LPDWORD)&dummy, NULL)))
       debugprintf("frob_control: DeviceIoControl failed!\n");
   port->ctr = ctr;
-  debug_frob_control (mask, val);
+  TRACE_CONTROL (port, (ctr ^ C1284_INVERTED) & (C1284_NSTROBE |
+						 C1284_NAUTOFD |
+						 C1284_NINIT |
+						 C1284_NSELECTIN));
 }
 
 static int
@@ -185,49 +191,6 @@ frob_control (struct parport_internal *port,
   raw_frob_control (port, mask, val);
 }
 
-static int
-wait_status (struct parport_internal *port,
-	     unsigned char mask, unsigned char val,
-	     struct timeval *timeout)
-{
-  /* Simple-minded polling.  TODO: Use David Paschal's method for this. */
-#if !(defined __MINGW32__ || defined _MSC_VER)
-  struct timeval deadline, now;
-  gettimeofday (&deadline, NULL);
-  deadline.tv_sec += timeout->tv_sec;
-  deadline.tv_usec += timeout->tv_usec;
-  deadline.tv_sec += deadline.tv_usec / 1000000;
-  deadline.tv_usec %= 1000000;
-#else
-  struct timeb tb;
-  int deadline, now;
-  ftime (&tb);
-  deadline = tb.time * 1000 + tb.millitm +
-             timeout->tv_sec * 1000 + timeout->tv_usec / 1000;
-#endif
-
-  do
-    {
-      if ((debug_display_status ((unsigned char)(read_status (port))) & mask) == val)
-	return E1284_OK;
-
-      delay (IO_POLL_DELAY);
-#if !(defined __MINGW32__ || defined _MSC_VER)
-      gettimeofday (&now, NULL);
-    }
-  while (now.tv_sec < deadline.tv_sec ||
-    (now.tv_sec == deadline.tv_sec &&
-	  now.tv_usec < deadline.tv_usec));
-#else
-      ftime (&tb);
-      now = tb.time * 1000 + tb.millitm;
-    }
-  while (now < deadline);
-#endif
-
-  return E1284_TIMEDOUT;
-}
-
 const struct parport_access_methods lpt_access_methods =
 {
   init,
@@ -238,6 +201,10 @@ const struct parport_access_methods lpt_access_methods =
 
   NULL, /* raw_inb */
   NULL, /* raw_outb */
+  NULL, /* inw */
+  NULL, /* outw */
+  NULL, /* inl */
+  NULL, /* outl */
 
   NULL, /* get_irq_fd */
   NULL, /* clear_irq */
@@ -248,7 +215,7 @@ const struct parport_access_methods lpt_access_methods =
   NULL, /* data_dir */
 
   read_status,
-  wait_status,
+  default_wait_status,
 
   read_control,
   write_control,
@@ -270,7 +237,8 @@ const struct parport_access_methods lpt_access_methods =
   default_ecp_write_data,
   default_ecp_read_addr,
   default_ecp_write_addr,
-  default_set_timeout
+  default_set_timeout,
+  default_pin_program
 };
 #else
 
@@ -285,6 +253,10 @@ const struct parport_access_methods lpt_access_methods =
 
   NULL, /* inb */
   NULL, /* outb */
+  NULL, /* inw */
+  NULL, /* outw */
+  NULL, /* inl */
+  NULL, /* outl */
 
   NULL,
   NULL,
@@ -37,18 +37,60 @@
 #include "ieee1284.h"
 #include "detect.h"
 #include "parport.h"
+#include "shadow.h"
+#include "stats.h"
+#include "trace.h"
 
 #ifdef HAVE_LINUX
 
+#include <poll.h>
+
 #include "ppdev.h"
 
+/* With F1284_DIRECTIO, pin-level access goes straight to the port's
+ * registers while it is claimed, and ppdev is left with arbitration
+ * and the transfers.  That needs inb and outb. */
+#if defined HAVE_SYS_IO_H && (defined __i386__ || defined __x86_64__)
+#include <sys/io.h>
+#define DIRECT_PINS
+#endif
+
+/* What the kernel already has for this file descriptor, so that
+ * repeated transfers only cost the read or write itself. */
 struct ppdev_priv 
 {
-  struct timeval inactivity_timer;
+  struct timeval inactivity_timer;	/* Old timeout, for set_timeout */
+  struct timeval timeout;		/* Current timeout, if known */
+  int timeout_known;
+  int fd_flags;				/* F_GETFL, without O_NONBLOCK */
   int nonblock;
   int current_flags;
+  int direct;				/* Pins reached with inb/outb */
+  int ctr_known;			/* port->ctr matches the port */
+  int ctr_dirty;			/* ...but not the kernel's copy */
 };
 
+static int
+pp_ioctl (struct parport_internal *port, unsigned long request, void *arg)
+{
+  port->stats.c.syscalls++;
+  return ioctl (port->fd, request, arg);
+}
+
+static ssize_t
+pp_read (struct parport_internal *port, char *buffer, size_t len)
+{
+  port->stats.c.syscalls++;
+  return read (port->fd, buffer, len);
+}
+
+static ssize_t
+pp_write (struct parport_internal *port, const char *buffer, size_t len)
+{
+  port->stats.c.syscalls++;
+  return write (port->fd, buffer, len);
+}
+
 static void
 find_capabilities (int fd, int *c)
 {
@@ -80,20 +122,181 @@ find_capabilities (int fd, int *c)
     *c &= ~(CAP1284_BYTE | CAP1284_ECPSWE);
 }
 
+#ifdef DIRECT_PINS
+/* Direct pin access.  The kernel keeps its own copy of the control
+ * register, which it writes back when it next drives the lines and
+ * saves when the port is released, so any changes made here are
+ * handed back to it first (see hand_back).  After the kernel has had
+ * the lines, the control register is read back from the port. */
+static unsigned char
+direct_ctr (struct parport_internal *port)
+{
+  struct ppdev_priv *priv = port->access_priv;
+
+  if (!priv->ctr_known)
+    {
+      port->ctr = inb (port->base + 2) & 0x3f;
+      priv->ctr_known = 1;
+    }
+
+  return port->ctr;
+}
+
+static void
+direct_write_ctr (struct parport_internal *port, unsigned char ctr)
+{
+  struct ppdev_priv *priv = port->access_priv;
+
+  outb_p (ctr, port->base + 2);
+  port->ctr = ctr;
+  priv->ctr_dirty = 1;
+}
+
+static int
+direct_read_data (struct parport_internal *port)
+{
+  unsigned char d = inb (port->base);
+  TRACE_DATA (port, d);
+  return d;
+}
+
+static void
+direct_write_data (struct parport_internal *port, unsigned char reg)
+{
+  outb_p (reg, port->base);
+}
+
+static int
+direct_read_status (struct parport_internal *port)
+{
+  unsigned char st = (unsigned char) (inb (port->base + 1) ^ S1284_INVERTED);
+  TRACE_STATUS (port, st);
+  return st;
+}
+
+static int
+direct_read_control (struct parport_internal *port)
+{
+  const unsigned char rm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  return (direct_ctr (port) ^ C1284_INVERTED) & rm;
+}
+
+static int
+direct_data_dir (struct parport_internal *port, int reverse)
+{
+  unsigned char ctr = direct_ctr (port) & ~0x20;
+  direct_write_ctr (port, (unsigned char) (ctr | (reverse ? 0x20 : 0)));
+  return E1284_OK;
+}
+
+static void
+direct_frob_control (struct parport_internal *port,
+		     unsigned char mask, unsigned char val)
+{
+  const unsigned char wm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  unsigned char ctr = direct_ctr (port);
+
+  if (mask & 0x20)
+    {
+      printf ("use ieee1284_data_dir to change data line direction!\n");
+      direct_data_dir (port, val & 0x20);
+      ctr = port->ctr;
+    }
+
+  mask &= wm;
+  val &= wm;
+  direct_write_ctr (port, (unsigned char) ((ctr & ~mask) ^
+					   (val ^ (mask & C1284_INVERTED))));
+  TRACE_FROB (port, mask, val);
+}
+
+static void
+direct_write_control (struct parport_internal *port, unsigned char reg)
+{
+  const unsigned char wm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  if (reg & 0x20)
+    {
+      printf ("use ieee1284_data_dir to change data line direction!\n");
+      direct_data_dir (port, 1);
+    }
+
+  direct_frob_control (port, wm, reg & wm);
+}
+
+/* Only ports that ioperm lets us at can be driven directly. */
+static int
+direct_install (struct parport_internal *port)
+{
+  struct parport_access_methods *fn = port->fn;
+
+  if (!port->base || ioperm (port->base, 3, 1))
+    {
+      debugprintf ("No direct access to %#lx; pins go through ppdev\n",
+		   port->base);
+      return 0;
+    }
+
+  debugprintf ("Pins at %#lx by direct access\n", port->base);
+  ((struct ppdev_priv *) port->access_priv)->direct = 1;
+  fn->read_data = direct_read_data;
+  fn->write_data = direct_write_data;
+  fn->data_dir = direct_data_dir;
+  fn->read_status = direct_read_status;
+  fn->read_control = direct_read_control;
+  fn->write_control = direct_write_control;
+  fn->frob_control = direct_frob_control;
+  fn->wait_status = default_wait_status;
+  return 1;
+}
+#endif /* DIRECT_PINS */
+
+/* Before the kernel drives the lines, give it back any control
+ * register changes made by direct access, and forget what we know
+ * about the register, since the kernel is about to change it. */
+static void
+hand_back (struct parport_internal *port)
+{
+  struct ppdev_priv *priv = port->access_priv;
+  const unsigned char wm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+
+  if (priv->ctr_dirty)
+    {
+      unsigned char reg = port->ctr & wm;
+      int reverse = (port->ctr & 0x20) ? 1 : 0;
+      pp_ioctl (port, PPWCONTROL, &reg);
+      pp_ioctl (port, PPDATADIR, &reverse);
+      priv->ctr_dirty = 0;
+    }
+
+  priv->ctr_known = 0;
+}
+
 static int
 init (struct parport *pport, int flags, int *capabilities)
 {
   struct parport_internal *port = pport->priv;
 
-  if (flags & ~F1284_EXCL)
+  if (flags & ~(F1284_EXCL | F1284_NOPAUSE | F1284_DIRECTIO))
     return E1284_NOTAVAIL;
 
   port->access_priv = malloc (sizeof (struct ppdev_priv));
   if (!port->access_priv)
     return E1284_NOMEM;
 
-  ((struct ppdev_priv *)port->access_priv)->nonblock = 0;
-  ((struct ppdev_priv *)port->access_priv)->current_flags = 0;
+  memset (port->access_priv, 0, sizeof (struct ppdev_priv));
+  ((struct ppdev_priv *)port->access_priv)->fd_flags = -1;
   port->fd = open (port->device, O_RDWR | O_NOCTTY);
 
   /* Retry with udev/devfs naming, if available */
@@ -120,7 +323,7 @@ init (struct parport *pport, int flags, int *capabilities)
   port->current_mode = M1284_COMPAT;
   if (flags & F1284_EXCL)
     {
-      if (ioctl (port->fd, PPEXCL))
+      if (pp_ioctl (port, PPEXCL, NULL))
 	{
 	  close (port->fd);
 	  free (port->access_priv);
@@ -138,12 +341,22 @@ init (struct parport *pport, int flags, int *capabilities)
   if (capabilities)
     find_capabilities (port->fd, capabilities);
 
+#ifdef DIRECT_PINS
+  if ((flags & F1284_DIRECTIO) && direct_install (port) && capabilities)
+    *capabilities |= CAP1284_RAW;
+#endif
+
   return E1284_OK;
 }
 
 static void
 cleanup (struct parport_internal *port)
 {
+  debugprintf ("ppdev: %lu system calls\n", port->stats.c.syscalls);
+#ifdef DIRECT_PINS
+  if (((struct ppdev_priv *) port->access_priv)->direct)
+    ioperm (port->base, 3, 0);
+#endif
   free (port->access_priv);
   if (port->fd >= 0)
     close (port->fd);
@@ -153,11 +366,13 @@ static int
 claim (struct parport_internal *port)
 {
   debugprintf ("==> claim\n");
-  if (ioctl (port->fd, PPCLAIM))
+  if (pp_ioctl (port, PPCLAIM, NULL))
     {
       debugprintf ("<== E1284_SYS\n");
       return E1284_SYS;
     }
+  /* The kernel has just restored the port's state. */
+  ((struct ppdev_priv *) port->access_priv)->ctr_known = 0;
   debugprintf ("<== E1284_OK\n");
   return E1284_OK;
 }
@@ -165,7 +380,9 @@ claim (struct parport_internal *port)
 static void
 release (struct parport_internal *port)
 {
-  ioctl (port->fd, PPRELEASE);
+  /* The kernel saves its copy of the control register now. */
+  hand_back (port);
+  pp_ioctl (port, PPRELEASE, NULL);
 }
 
 static int
@@ -182,7 +399,7 @@ clear_irq (struct parport_internal *port, unsigned int *count)
 {
   int c;
 
-  if (ioctl (port->fd, PPCLRIRQ, &c))
+  if (pp_ioctl (port, PPCLRIRQ, &c))
     return E1284_SYS;
 
   if (count)
@@ -195,26 +412,29 @@ static int
 read_data (struct parport_internal *port)
 {
   unsigned char reg;
-  if (ioctl (port->fd, PPRDATA, &reg))
+  if (pp_ioctl (port, PPRDATA, &reg))
     return E1284_NOTAVAIL;
 
+  TRACE_DATA (port, reg);
   return reg;
 }
 
 static void
 write_data (struct parport_internal *port, unsigned char reg)
 {
-  ioctl (port->fd, PPWDATA, &reg);
+  pp_ioctl (port, PPWDATA, &reg);
 }
 
 static int
 read_status (struct parport_internal *port)
 {
   unsigned char reg;
-  if (ioctl (port->fd, PPRSTATUS, &reg))
+  if (pp_ioctl (port, PPRSTATUS, &reg))
     return E1284_NOTAVAIL;
 
-  return debug_display_status (reg ^ S1284_INVERTED);
+  reg ^= S1284_INVERTED;
+  TRACE_STATUS (port, reg);
+  return reg;
 }
 
 static int
@@ -225,7 +445,7 @@ read_control (struct parport_internal *port)
 			    C1284_NAUTOFD |
 			    C1284_NINIT |
 			    C1284_NSELECTIN);
-  if (ioctl (port->fd, PPRCONTROL, &reg))
+  if (pp_ioctl (port, PPRCONTROL, &reg))
     return E1284_NOTAVAIL;
 
   return (reg ^ C1284_INVERTED) & rm;
@@ -234,7 +454,7 @@ read_control (struct parport_internal *port)
 static int
 data_dir (struct parport_internal *port, int reverse)
 {
-  if (ioctl (port->fd, PPDATADIR, &reverse))
+  if (pp_ioctl (port, PPDATADIR, &reverse))
     return E1284_SYS;
   return E1284_OK;
 }
@@ -253,9 +473,9 @@ write_control (struct parport_internal *port, unsigned char reg)
     }
 
   reg &= wm;
+  TRACE_CONTROL (port, reg);
   reg ^= C1284_INVERTED;
-  ioctl (port->fd, PPWCONTROL, &reg);
-  debug_display_control (reg);
+  pp_ioctl (port, PPWCONTROL, &reg);
 }
 
 static void
@@ -274,43 +494,80 @@ frob_control (struct parport_internal *port,
   /* Deal with inversion issues. */
   ppfs.mask = mask;
   ppfs.val = val ^ (mask & C1284_INVERTED);
-  debugprintf ("frob_control: ioctl(%d, PPFCONTROL, { mask:%#02x, val:%#02x }\n",
-	   port->fd, ppfs.mask, ppfs.val);
-  ioctl (port->fd, PPFCONTROL, &ppfs);
-  debug_frob_control (mask, val);
+  pp_ioctl (port, PPFCONTROL, &ppfs);
+  TRACE_FROB (port, mask & ~0x20, val);
 }
 
+/* A wait for nAck alone can sleep in poll() until the nAck interrupt
+ * instead of re-reading the status lines.  Peripherals that answer
+ * within microseconds are caught sooner by polling, so that is tried
+ * first.  Only one edge of nAck interrupts, so the sleep is bounded
+ * and the status checked again each time round. */
+#define IRQ_POLL_FIRST_US 100
+#define IRQ_NAP_MAX_MS 10
+
 static int
 wait_status (struct parport_internal *port,
 	     unsigned char mask, unsigned char val,
 	     struct timeval *timeout)
 {
-  /* This could be smarter: if we're just waiting for nAck, and we
-   * have interrutps to work with, we can just wait for an interrupt
-   * rather than polling. */
-
-  /* Simple-minded polling.  TODO: Use David Paschal's method for this. */
-  struct timeval deadline, now;
-  gettimeofday (&deadline, NULL);
-  deadline.tv_sec += timeout->tv_sec;
-  deadline.tv_usec += timeout->tv_usec;
-  deadline.tv_sec += deadline.tv_usec / 1000000;
-  deadline.tv_usec %= 1000000;
-
-  do
+  struct timeval first;
+  struct pollfd pfd;
+  nsec_t start, deadline, now, slept = 0;
+  int count, nap, ret;
+
+  if (port->interrupt == -1 || mask != S1284_NACK)
+    return default_wait_status (port, mask, val, timeout);
+
+  stats_wait_start (port, mask, val);
+  start = monotonic_ns ();
+  deadline = timeout_deadline (timeout);
+  first.tv_sec = 0;
+  first.tv_usec = IRQ_POLL_FIRST_US;
+  if (timercmp (timeout, &first, <))
+    first = *timeout;
+  /* That is only the start of the wait, if it times out. */
+  port->stats.partial = 1;
+  ret = default_wait_status (port, mask, val, &first);
+  port->stats.partial = 0;
+  if (ret == E1284_OK)
+    return E1284_OK;
+
+  /* Clear the count before reading the status, so that a transition
+   * after the read wakes poll(). */
+  pp_ioctl (port, PPCLRIRQ, &count);
+  pfd.fd = port->fd;
+  pfd.events = POLLIN;
+  for (;;)
     {
-      unsigned char st = debug_display_status (read_status (port));
+      unsigned char st = port->fn->read_status (port);
+      port->stats.c.wait_reads++;
+      now = monotonic_ns ();
       if ((st & mask) == val)
-	return E1284_OK;
+	{
+	  stats_wait_done (port, E1284_OK, now - start, slept);
+	  return E1284_OK;
+	}
 
-      delay (IO_POLL_DELAY);
-      gettimeofday (&now, NULL);
-    }
-  while (now.tv_sec < deadline.tv_sec ||
-	 (now.tv_sec == deadline.tv_sec &&
-	  now.tv_usec < deadline.tv_usec));
+      if (now >= deadline)
+	{
+	  stats_wait_done (port, E1284_TIMEDOUT, now - start, slept);
+	  return E1284_TIMEDOUT;
+	}
 
-  return E1284_TIMEDOUT;
+      nap = (int) ((now - start) / 4000000);
+      if (nap < 1)
+	nap = 1;
+      if (nap > IRQ_NAP_MAX_MS)
+	nap = IRQ_NAP_MAX_MS;
+      if (nap > (deadline - now + 999999) / 1000000)
+	nap = (int) ((deadline - now + 999999) / 1000000);
+
+      port->stats.c.syscalls++;
+      if (poll (&pfd, 1, nap) > 0)
+	pp_ioctl (port, PPCLRIRQ, &count);
+      slept += monotonic_ns () - now;
+    }
 }
 
 static int
@@ -322,10 +579,13 @@ do_nack_handshake (struct parport_internal *port,
   fd_set rfds;
   int count;
 
-  if (ioctl (port->fd, PPCLRIRQ, &count))
+  /* The kernel writes ct_after, behind the shadow registers' back. */
+  hand_back (port);
+  shadow_invalidate (port);
+  if (pp_ioctl (port, PPCLRIRQ, &count))
     return E1284_NOTAVAIL;
 
-  if (ioctl (port->fd, PPWCTLONIRQ, &ct_after))
+  if (pp_ioctl (port, PPWCTLONIRQ, &ct_after))
     return E1284_NOTAVAIL;
 
   write_control (port, ct_before);
@@ -333,6 +593,7 @@ do_nack_handshake (struct parport_internal *port,
   FD_ZERO (&rfds);
   FD_SET (port->fd, &rfds);
 
+  port->stats.c.syscalls++;
   switch (select (port->fd + 1, &rfds, NULL, NULL, timeout))
     {
     case 0:
@@ -342,7 +603,7 @@ do_nack_handshake (struct parport_internal *port,
       return E1284_NOTAVAIL;
     }
 
-  ioctl (port->fd, PPCLRIRQ, &count);
+  pp_ioctl (port, PPCLRIRQ, &count);
   if (count != 1)
     {
       printf ("Multiple interrupts caught?\n");
@@ -425,10 +686,14 @@ set_mode (struct parport_internal *port, int mode, int flags, int addr)
   if (m < 0)
     return m;
 
+  /* The kernel is about to drive the lines itself. */
+  hand_back (port);
+  shadow_invalidate (port);
+
   m |= addr ? IEEE1284_ADDR : IEEE1284_DATA;
   if (port->current_mode != m)
     {
-      ret = translate_error_code (ioctl (port->fd, PPSETMODE, &m));
+      ret = translate_error_code (pp_ioctl (port, PPSETMODE, &m));
       if (!ret)
 	port->current_mode = m;
     }
@@ -439,7 +704,7 @@ set_mode (struct parport_internal *port, int mode, int flags, int addr)
   if (priv->current_flags != f
       && mode == M1284_EPP) /* flags are only relevant for EPP right now */
     {
-      ret = translate_error_code (ioctl (port->fd, PPSETFLAGS, &f));
+      ret = translate_error_code (pp_ioctl (port, PPSETFLAGS, &f));
       if (!ret)
 	priv->current_flags = f;
     }
@@ -451,43 +716,37 @@ static int
 do_nonblock (struct parport_internal *port, int flags)
 {
   struct ppdev_priv *priv = port->access_priv;
-  if ((flags & F1284_NONBLOCK) && !priv->nonblock)
-    {
-      /* Enable O_NONBLOCK */
-      int f = fcntl (port->fd, F_GETFL);
+  int nonblock = (flags & F1284_NONBLOCK) ? 1 : 0;
+  int f;
 
-      if (f == -1)
+  if (nonblock == priv->nonblock)
+    return 0;
+
+  if (priv->fd_flags == -1)
+    {
+      port->stats.c.syscalls++;
+      priv->fd_flags = fcntl (port->fd, F_GETFL);
+      if (priv->fd_flags == -1)
 	{
 	  debugprintf ("do_nonblock: fcntl failed on F_GETFL\n");
 	  return -1;
 	}
 
-      f |= O_NONBLOCK;
-      if (fcntl (port->fd, F_SETFL, f))
-	{
-	  debugprintf ("do_nonblock: fcntl failed on F_SETFL\n");
-	  return -1;
-	}
+      priv->fd_flags &= ~O_NONBLOCK;
     }
-  else if ((!(flags & F1284_NONBLOCK)) && priv->nonblock)
-    {
-      /* Disable O_NONBLOCK */
-      int f = fcntl (port->fd, F_GETFL);
 
-      if (f == -1)
-	{
-	  debugprintf ("do_nonblock: fcntl failed on F_GETFL\n");
-	  return -1;
-	}
+  f = priv->fd_flags;
+  if (nonblock)
+    f |= O_NONBLOCK;
 
-      f &= O_NONBLOCK;
-      if (fcntl (port->fd, F_SETFL, f))
-	{
-	  debugprintf ("do_nonblock: fcntl failed on F_SETFL\n");
-	  return -1;
-	}
+  port->stats.c.syscalls++;
+  if (fcntl (port->fd, F_SETFL, f))
+    {
+      debugprintf ("do_nonblock: fcntl failed on F_SETFL\n");
+      return -1;
     }
 
+  priv->nonblock = nonblock;
   return 0;
 }
 
@@ -497,28 +756,31 @@ negotiate (struct parport_internal *port, int mode)
   int m = which_mode (mode, 0);
   int ret;
 
-  debugprintf ("==> negotiate (to %#02x)\n", mode);
+  TRACE_ENTER (port, "ppdev", SC1284_NEGOTIATE);
+  TRACE_NOTE (port, "IEEE 1284 mode %#02lx", mode);
 
-  ret = ioctl (port->fd, PPNEGOT, &m);
+  hand_back (port);
+  shadow_invalidate (port);
+  ret = pp_ioctl (port, PPNEGOT, &m);
   if (!ret)
   {
     port->current_mode = mode;
   } else {
     if (errno == EIO)
       {
-	debugprintf ("<== E1284_NEGFAILED\n");
+	TRACE_LEAVE (port, "ppdev", SC1284_NEGOTIATE, E1284_NEGFAILED);
 	return E1284_NEGFAILED;
       }
 
     if (errno == ENXIO)
       {
-	debugprintf ("<== E1284_REJECTED\n");
+	TRACE_LEAVE (port, "ppdev", SC1284_NEGOTIATE, E1284_REJECTED);
 	return E1284_REJECTED;
       }
   }
 
   m = translate_error_code (ret);
-  debugprintf ("<== %d\n", m);
+  TRACE_LEAVE (port, "ppdev", SC1284_NEGOTIATE, m);
   return m;
 }
 
@@ -526,7 +788,9 @@ static void
 terminate (struct parport_internal *port)
 {
   int m = IEEE1284_MODE_COMPAT;
-  if (!ioctl (port->fd, PPNEGOT, &m))
+  hand_back (port);
+  shadow_invalidate (port);
+  if (!pp_ioctl (port, PPNEGOT, &m))
     port->current_mode = IEEE1284_MODE_COMPAT;
 
   /* Seems to be needed before negotiation. */
@@ -542,7 +806,7 @@ nibble_read (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_NIBBLE, 0, 0);
   if (!ret)
-    ret = translate_error_code (read (port->fd, buffer, len));
+    ret = translate_error_code (pp_read (port, buffer, len));
   return ret;
 }
 
@@ -555,7 +819,7 @@ compat_write (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_COMPAT, 0, 0);
   if (!ret)
-    ret = translate_error_code (write (port->fd, buffer, len));
+    ret = translate_error_code (pp_write (port, buffer, len));
   return ret;
 }
 
@@ -568,7 +832,7 @@ byte_read (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_BYTE, 0, 0);
   if (!ret)
-    ret = translate_error_code (read (port->fd, buffer, len));
+    ret = translate_error_code (pp_read (port, buffer, len));
   return ret;
 }
 
@@ -581,7 +845,7 @@ epp_read_data (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_EPP, flags, 0);
   if (!ret)
-    ret = translate_error_code (read (port->fd, buffer, len));
+    ret = translate_error_code (pp_read (port, buffer, len));
   return ret;
 }
 
@@ -594,7 +858,7 @@ epp_write_data (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_EPP, flags, 0);
   if (!ret)
-    ret = translate_error_code (write (port->fd, buffer, len));
+    ret = translate_error_code (pp_write (port, buffer, len));
   return ret;
 }
 
@@ -607,7 +871,7 @@ epp_read_addr (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_EPP, flags, 1);
   if (!ret)
-    ret = translate_error_code (read (port->fd, buffer, len));
+    ret = translate_error_code (pp_read (port, buffer, len));
   return ret;
 }
 
@@ -620,7 +884,7 @@ epp_write_addr (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_EPP, flags, 1);
   if (!ret)
-    ret = translate_error_code (write (port->fd, buffer, len));
+    ret = translate_error_code (pp_write (port, buffer, len));
   return ret;
 }
 
@@ -633,7 +897,7 @@ ecp_read_data (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_ECP, flags, 0);
   if (!ret)
-    ret = translate_error_code (read (port->fd, buffer, len));
+    ret = translate_error_code (pp_read (port, buffer, len));
   return ret;
 }
 
@@ -646,7 +910,7 @@ ecp_write_data (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_ECP, flags, 0);
   if (!ret)
-    ret = translate_error_code (write (port->fd, buffer, len));
+    ret = translate_error_code (pp_write (port, buffer, len));
   return ret;
 }
 
@@ -659,7 +923,7 @@ ecp_write_addr (struct parport_internal *port, int flags,
   if (!ret)
     ret = set_mode (port, M1284_ECP, flags, 1);
   if (!ret)
-    ret = translate_error_code (write (port->fd, buffer, len));
+    ret = translate_error_code (pp_write (port, buffer, len));
   return ret;
 }
 
@@ -667,8 +931,19 @@ static struct timeval *
 set_timeout (struct parport_internal *port, struct timeval *timeout)
 {
   struct ppdev_priv *priv = port->access_priv;
-  ioctl (port->fd, PPGETTIME, &priv->inactivity_timer);
-  ioctl (port->fd, PPSETTIME, timeout);
+
+  if (!priv->timeout_known && !pp_ioctl (port, PPGETTIME, &priv->timeout))
+    priv->timeout_known = 1;
+
+  priv->inactivity_timer = priv->timeout;
+  if (timeout && (!priv->timeout_known ||
+		  timeout->tv_sec != priv->timeout.tv_sec ||
+		  timeout->tv_usec != priv->timeout.tv_usec))
+    {
+      priv->timeout_known = !pp_ioctl (port, PPSETTIME, timeout);
+      priv->timeout = *timeout;
+    }
+
   return &priv->inactivity_timer;
 }
 
@@ -682,6 +957,10 @@ const struct parport_access_methods ppdev_access_methods =
 
   NULL, /* inb */
   NULL, /* outb */
+  NULL, /* inw */
+  NULL, /* outw */
+  NULL, /* inl */
+  NULL, /* outl */
 
   get_irq_fd,
   clear_irq,
@@ -715,7 +994,8 @@ const struct parport_access_methods ppdev_access_methods =
   ecp_write_data,
   default_ecp_read_addr,
   ecp_write_addr,
-  set_timeout
+  set_timeout,
+  default_pin_program
 };
 
 /*
@@ -737,6 +1017,10 @@ const struct parport_access_methods ppdev_access_methods =
 
   NULL, /* inb */
   NULL, /* outb */
+  NULL, /* inw */
+  NULL, /* outw */
+  NULL, /* inl */
+  NULL, /* outl */
 
   NULL,
   NULL,
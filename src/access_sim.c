@@ -0,0 +1,1394 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ * This file defines access to a simulated peripheral.  The pins are
+ * modelled in software, and a state machine plays the part of an
+ * IEEE 1284 peripheral supporting compatibility, nibble, byte, EPP
+ * and ECP (with RLE) modes.  The protocol engines in default.c drive
+ * it exactly as they would drive real hardware.
+ *
+ * Time is simulated: every register access costs the configured
+ * access time, and waiting for the peripheral skips straight to its
+ * next response, so a transfer takes as long as the protocol engine
+ * takes to run rather than as long as the bus would.
+ *
+ * With "ecp-fifo" set, the port also has an extended control register
+ * and FIFO, and in ECP mode it does the forward and reverse handshakes
+ * itself, as an ECP port's hardware would.  That lets ecr.c drive it.
+ * With "epp-registers" set, accessing the EPP registers runs EPP
+ * cycles, for epp.c.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _MSC_VER
+#include <sys/time.h>
+#endif
+#include <sys/types.h>
+
+#include "access.h"
+#include "conf.h"
+#include "debug.h"
+#include "default.h"
+#include "delay.h"
+#include "detect.h"
+#include "ecr.h"
+#include "epp.h"
+#include "ieee1284.h"
+#include "stats.h"
+#include "trace.h"
+
+/* What the simulated peripheral thinks is going on. */
+enum sim_phase
+{
+  SIM_COMPAT,
+  SIM_NEGOTIATION,	/* Event 2 given, waiting for Event 4 */
+  SIM_REJECTED,		/* Mode refused, waiting for termination */
+  SIM_NIBBLE,
+  SIM_BYTE,
+  SIM_ECP_SETUP,	/* Waiting for Event 30 */
+  SIM_ECP_FWD,
+  SIM_ECP_REV,
+  SIM_EPP,
+  SIM_TERMINATION	/* Event 24 given, waiting for Event 25 */
+};
+
+enum sim_epp_cycle
+{
+  SIM_EPP_IDLE,
+  SIM_EPP_DATA,
+  SIM_EPP_ADDR
+};
+
+/* What the ECP port's own handshaking is doing. */
+enum sim_hw_state
+{
+  SIM_HW_IDLE,
+  SIM_HW_STROBE,	/* Event 35 given, waiting for Event 36 */
+  SIM_HW_ACK		/* Event 44 given, waiting for Event 45 */
+};
+
+/* One PWord in the ECP FIFO. */
+struct sim_fifo_entry
+{
+  unsigned char byte[4];
+  unsigned char len;
+  unsigned char cmd;		/* from the address FIFO */
+};
+
+#define SIM_FIFO_MAX 256
+#define SIM_ECR_MODE(sim) ((sim)->ecr >> 5)
+
+/* Status lines when idle in compatibility mode. */
+#define SIM_COMPAT_IDLE (S1284_NACK | S1284_SELECT | S1284_NFAULT)
+
+static const char sim_deviceid[] =
+  "MFG:libieee1284;MDL:Simulated Peripheral;CMD:PCL;CLS:PRINTER;"
+  "DES:libieee1284 simulated peripheral;";
+
+struct sim_priv
+{
+  const struct sim_port_config *cfg;
+  double now;			/* simulated time, in ns */
+  unsigned long rng;
+
+  /* Lines driven by the host. */
+  unsigned char data;
+  unsigned char ctr;
+  int reverse;
+
+  /* The control register.  Outside ECP mode, this is ctr. */
+  unsigned char ctr_reg;
+
+  /* The ECR and FIFO, if fifo_depth is not 0. */
+  unsigned char ecr;
+  unsigned int fifo_depth;
+  unsigned int pword;
+  struct sim_fifo_entry fifo[SIM_FIFO_MAX];
+  unsigned int fifo_head;
+  unsigned int fifo_count;
+  struct sim_fifo_entry part;	/* reverse PWord being assembled */
+  enum sim_hw_state hw;
+  unsigned char hw_mask;	/* control lines the port is driving */
+  unsigned char hw_lines;
+  unsigned int hw_byte;		/* next byte of the head entry */
+  unsigned long hw_run;		/* run-length count received */
+  unsigned long hw_left;	/* expanded bytes not in the FIFO yet */
+  unsigned char hw_val;
+  int epp_timeout;
+
+  /* Lines driven by the peripheral. */
+  unsigned char status;
+  unsigned char pdata;
+
+  /* The peripheral's next response, if there is one pending. */
+  int pending;
+  double due;
+  unsigned char next_status;
+  unsigned char next_pdata;
+
+  /* Peripheral state. */
+  enum sim_phase phase;
+  unsigned char ext;		/* extensibility request byte */
+  int rle;			/* RLE negotiated */
+  int nibble;			/* which nibble is next */
+  unsigned long run;		/* ECP run presented or acknowledged */
+  int run_cmd;			/* presenting a run-length count */
+  unsigned char latch;		/* ECP forward byte */
+  int latch_cmd;
+  unsigned long fwd_run;	/* ECP forward run-length count */
+  enum sim_epp_cycle epp;
+  int epp_write;
+  unsigned char epp_addr;
+
+  /* Reverse data source: either the Device ID or a pattern. */
+  const unsigned char *devid;
+  size_t devid_len;
+  size_t devid_at;
+  unsigned long sent;
+  unsigned char devid_buf[2 + sizeof (sim_deviceid)];
+
+  /* Forward data sink. */
+  unsigned long sunk;
+  unsigned long sum;
+  FILE *sink;			/* a copy of it, or NULL */
+};
+
+static double
+sim_random (struct sim_priv *sim)
+{
+  /* xorshift32 */
+  unsigned long x = sim->rng;
+  x ^= (x << 13) & 0xffffffffUL;
+  x ^= x >> 17;
+  x ^= (x << 5) & 0xffffffffUL;
+  sim->rng = x;
+  return (x & 0xffffffffUL) / 4294967296.0;
+}
+
+static double
+sim_sample (struct sim_priv *sim, const struct sim_latency *lat)
+{
+  switch (lat->kind)
+    {
+    case SIM_LATENCY_UNIFORM:
+      if (lat->max <= lat->min)
+	break;
+      return lat->min + sim_random (sim) * (lat->max - lat->min);
+
+    case SIM_LATENCY_EXPONENTIAL:
+      return lat->min - log (1.0 - sim_random (sim)) * lat->max;
+
+    case SIM_LATENCY_FIXED:
+      break;
+    }
+
+  return lat->min;
+}
+
+static void sim_step (struct sim_priv *sim);
+static void sim_hw (struct sim_priv *sim);
+
+/* Arrange for the peripheral to drive the status and data lines to
+ * new values after some latency. */
+static void
+sim_schedule (struct sim_priv *sim, const struct sim_latency *lat,
+	      unsigned char status, unsigned char pdata)
+{
+  sim->pending = 1;
+  sim->due = sim->now + sim_sample (sim, lat);
+  sim->next_status = status;
+  sim->next_pdata = pdata;
+}
+
+static void
+sim_apply (struct sim_priv *sim)
+{
+  sim->pending = 0;
+  sim->status = sim->next_status;
+  sim->pdata = sim->next_pdata;
+}
+
+/* Let the peripheral catch up with the current time. */
+static void
+sim_settle (struct sim_priv *sim)
+{
+  while (sim->pending && sim->due <= sim->now)
+    {
+      sim_apply (sim);
+      sim_step (sim);
+    }
+}
+
+static void
+sim_access (struct sim_priv *sim)
+{
+  sim->now += sim->cfg->access_time;
+  sim_settle (sim);
+  sim_hw (sim);
+}
+
+static int
+sim_avail (struct sim_priv *sim, unsigned long ahead)
+{
+  if (sim->devid)
+    return sim->devid_at + ahead < sim->devid_len;
+
+  return (!sim->cfg->reverse_bytes ||
+	  sim->sent + ahead < sim->cfg->reverse_bytes);
+}
+
+static unsigned char
+sim_peek (struct sim_priv *sim, unsigned long ahead)
+{
+  if (sim->devid)
+    return sim->devid[sim->devid_at + ahead];
+
+  return (unsigned char) ((sim->sent + ahead) / sim->cfg->run_length);
+}
+
+static void
+sim_consume (struct sim_priv *sim, unsigned long n)
+{
+  if (sim->devid)
+    sim->devid_at += n;
+  else
+    sim->sent += n;
+}
+
+static void
+sim_sink (struct sim_priv *sim, unsigned char byte, unsigned long n)
+{
+  sim->sunk += n;
+  sim->sum += byte * n;
+  if (sim->sink)
+    while (n--)
+      putc (byte, sim->sink);
+}
+
+/* Status lines showing whether there is reverse data available. */
+static unsigned char
+sim_data_avail (struct sim_priv *sim, unsigned char status)
+{
+  status &= ~(S1284_NFAULT | S1284_PERROR);
+  if (!sim_avail (sim, 0))
+    status |= S1284_NFAULT | S1284_PERROR;
+  return status;
+}
+
+/* Event 4: decide whether to accept the requested mode. */
+static void
+sim_negotiate (struct sim_priv *sim)
+{
+  unsigned char m = sim->ext;
+  unsigned char st;
+
+  sim->devid = NULL;
+  sim->rle = 0;
+  sim->nibble = 0;
+  sim->run = 0;
+  sim->run_cmd = 0;
+  sim->epp = SIM_EPP_IDLE;
+
+  if (m & M1284_FLAG_DEVICEID)
+    {
+      sim->devid = sim->devid_buf;
+      sim->devid_at = 0;
+    }
+
+  switch (m & ~M1284_FLAG_DEVICEID)
+    {
+    case M1284_NIBBLE:
+      sim->phase = SIM_NIBBLE;
+      st = sim_data_avail (sim, S1284_NACK);
+      break;
+
+    case M1284_BYTE:
+      sim->phase = SIM_BYTE;
+      st = sim_data_avail (sim, S1284_NACK);
+      break;
+
+    case M1284_ECP:
+    case M1284_ECPRLE:
+      sim->phase = SIM_ECP_SETUP;
+      sim->rle = (m & M1284_ECPRLE) == M1284_ECPRLE;
+      st = S1284_NACK | S1284_NFAULT;
+      break;
+
+    case M1284_EPP:
+      if (sim->devid)
+	goto reject;
+
+      sim->phase = SIM_EPP;
+      st = S1284_NACK | S1284_NFAULT;
+      break;
+
+    default:
+    reject:
+      debugprintf ("sim: rejecting mode %#02x\n", m);
+      sim->devid = NULL;
+      sim->phase = SIM_REJECTED;
+      sim_schedule (sim, &sim->cfg->setup,
+		    (unsigned char) (S1284_NACK | S1284_NFAULT
+				     | (m ? 0 : S1284_SELECT)),
+		    sim->pdata);
+      return;
+    }
+
+  /* Event 5: Select (XFlag) is low for nibble mode, high otherwise.
+   * Event 6: nAck goes high. */
+  if (m)
+    st |= S1284_SELECT;
+  sim_schedule (sim, &sim->cfg->setup, st, sim->pdata);
+}
+
+/* The peripheral reacts to the levels on the control lines. */
+static void
+sim_step (struct sim_priv *sim)
+{
+  unsigned char st = sim->status;
+  int host_ack = !(sim->ctr & C1284_NAUTOFD);
+
+  if (sim->pending)
+    return;
+
+  switch (sim->phase)
+    {
+    case SIM_NIBBLE:
+      if (host_ack && (st & S1284_NACK) && sim_avail (sim, 0))
+	{
+	  /* Event 8: put the nibble on the status lines.
+	   * Event 9: nAck goes low. */
+	  unsigned char nib = sim_peek (sim, 0) >> (sim->nibble * 4);
+	  st &= ~(S1284_NFAULT | S1284_SELECT | S1284_PERROR | S1284_BUSY
+		  | S1284_NACK);
+	  if (nib & 1)
+	    st |= S1284_NFAULT;
+	  if (nib & 2)
+	    st |= S1284_SELECT;
+	  if (nib & 4)
+	    st |= S1284_PERROR;
+	  if (nib & 8)
+	    st |= S1284_BUSY;
+	  sim_schedule (sim, &sim->cfg->latency, st, sim->pdata);
+	}
+      else if (!host_ack && !(st & S1284_NACK))
+	{
+	  /* Event 11: nAck goes high. */
+	  st |= S1284_NACK;
+	  if (sim->nibble)
+	    {
+	      sim_consume (sim, 1);
+	      st = sim_data_avail (sim, st);
+	    }
+
+	  sim->nibble = !sim->nibble;
+	  sim_schedule (sim, &sim->cfg->latency, st, sim->pdata);
+	}
+      break;
+
+    case SIM_BYTE:
+      if (host_ack && (st & S1284_NACK) && sim_avail (sim, 0))
+	/* Event 9: data on the data lines, nAck goes low. */
+	sim_schedule (sim, &sim->cfg->latency,
+		      (unsigned char) (st & ~S1284_NACK), sim_peek (sim, 0));
+      else if (!host_ack && !(st & S1284_NACK))
+	{
+	  /* Event 11: nAck goes high. */
+	  sim_consume (sim, 1);
+	  sim_schedule (sim, &sim->cfg->latency,
+			sim_data_avail (sim, (unsigned char) (st
+							      | S1284_NACK)),
+			sim->pdata);
+	}
+      break;
+
+    case SIM_ECP_REV:
+      if (host_ack && (st & S1284_NACK) && sim_avail (sim, 0))
+	{
+	  unsigned char byte = sim_peek (sim, 0);
+	  unsigned long n = 1;
+
+	  if (sim->rle && !sim->run)
+	    while (n < 128 && sim_avail (sim, n) && sim_peek (sim, n) == byte)
+	      n++;
+
+	  /* Event 42: Busy is low for a command, high for data.
+	   * Event 43: nAck goes low. */
+	  st &= ~(S1284_NACK | S1284_BUSY);
+	  if (n > 1)
+	    {
+	      sim->run_cmd = 1;
+	      sim->run = n;
+	      byte = (unsigned char) (n - 1);
+	    }
+	  else
+	    st |= S1284_BUSY;
+
+	  sim_schedule (sim, &sim->cfg->latency, st, byte);
+	}
+      else if (!host_ack && !(st & S1284_NACK))
+	{
+	  /* Event 45: nAck goes high. */
+	  if (sim->run_cmd)
+	    sim->run_cmd = 0;
+	  else
+	    {
+	      sim_consume (sim, sim->run ? sim->run : 1);
+	      sim->run = 0;
+	    }
+
+	  sim_schedule (sim, &sim->cfg->latency,
+			(unsigned char) (st | S1284_NACK), sim->pdata);
+	}
+      break;
+
+    default:
+      break;
+    }
+}
+
+/* The peripheral reacts to edges on the control lines. */
+static void
+sim_control (struct sim_priv *sim, unsigned char old, unsigned char new)
+{
+  unsigned char fell = old & ~new;
+  unsigned char rose = ~old & new;
+  unsigned char st;
+
+  /* Responses the host hasn't waited for happen now. */
+  if (sim->pending)
+    sim_apply (sim);
+  st = sim->status;
+
+  /* Event 22: nSelectIn low requests termination.  In EPP mode it
+   * is nAStrb, and a reset terminates instead. */
+  if ((fell & C1284_NSELECTIN) && sim->phase != SIM_COMPAT
+      && sim->phase != SIM_TERMINATION && sim->phase != SIM_EPP)
+    {
+      /* Event 23/24: nAck goes low. */
+      sim->phase = SIM_TERMINATION;
+      sim->epp = SIM_EPP_IDLE;
+      sim_schedule (sim, &sim->cfg->setup,
+		    (unsigned char) (st & ~S1284_NACK),
+		    sim->pdata);
+      return;
+    }
+
+  switch (sim->phase)
+    {
+    case SIM_COMPAT:
+      if ((new & C1284_NSELECTIN) && !(new & C1284_NAUTOFD)
+	  && (rose & C1284_NSELECTIN || fell & C1284_NAUTOFD))
+	{
+	  /* Event 1 seen.  Event 2: PError, Select and nFault high,
+	   * nAck low. */
+	  sim->phase = SIM_NEGOTIATION;
+	  sim->ext = sim->data;
+	  sim_schedule (sim, &sim->cfg->setup,
+			S1284_PERROR | S1284_SELECT | S1284_NFAULT,
+			sim->pdata);
+	}
+      else if (fell & C1284_NSTROBE)
+	{
+	  /* Latch the data and go busy until it's dealt with. */
+	  sim_sink (sim, sim->data, 1);
+	  sim->status = st | S1284_BUSY;
+	  sim_schedule (sim, &sim->cfg->latency,
+			(unsigned char) (st & ~S1284_BUSY), sim->pdata);
+	}
+      break;
+
+    case SIM_NEGOTIATION:
+      /* Event 3: the extensibility request is strobed in. */
+      if (fell & C1284_NSTROBE)
+	sim->ext = sim->data;
+
+      /* Event 4: nStrobe and nAutoFd high. */
+      if ((rose & C1284_NSTROBE) && (new & C1284_NAUTOFD))
+	sim_negotiate (sim);
+      break;
+
+    case SIM_ECP_SETUP:
+      if (fell & C1284_NAUTOFD)
+	{
+	  /* Event 31: PError goes high. */
+	  sim->phase = SIM_ECP_FWD;
+	  sim->fwd_run = 0;
+	  sim_schedule (sim, &sim->cfg->setup,
+			(unsigned char) ((st | S1284_PERROR) & ~S1284_BUSY),
+			sim->pdata);
+	}
+      break;
+
+    case SIM_ECP_FWD:
+      if ((fell & C1284_NINIT) && !(new & C1284_NAUTOFD))
+	{
+	  /* Event 39 seen.  Event 40: PError goes low. */
+	  sim->phase = SIM_ECP_REV;
+	  sim->run = 0;
+	  sim->run_cmd = 0;
+	  sim_schedule (sim, &sim->cfg->setup,
+			(unsigned char) (st & ~S1284_PERROR), sim->pdata);
+	}
+      else if (fell & C1284_NSTROBE)
+	{
+	  /* Event 35 seen.  Event 36: Busy goes high. */
+	  sim->latch = sim->data;
+	  sim->latch_cmd = !(new & C1284_NAUTOFD);
+	  sim_schedule (sim, &sim->cfg->latency,
+			(unsigned char) (st | S1284_BUSY), sim->pdata);
+	}
+      else if (rose & C1284_NSTROBE)
+	{
+	  /* Event 37 seen.  Deal with the byte, then Busy goes low. */
+	  if (!sim->latch_cmd)
+	    {
+	      sim_sink (sim, sim->latch, sim->fwd_run ? sim->fwd_run : 1);
+	      sim->fwd_run = 0;
+	    }
+	  else if (!(sim->latch & 0x80))
+	    sim->fwd_run = sim->latch + 1;
+
+	  sim_schedule (sim, &sim->cfg->latency,
+			(unsigned char) (st & ~S1284_BUSY), sim->pdata);
+	}
+      break;
+
+    case SIM_ECP_REV:
+      if (rose & C1284_NINIT)
+	{
+	  /* Event 47 seen.  Anything presented but not acknowledged
+	   * will be sent again.  Event 49: PError goes high. */
+	  sim->phase = SIM_ECP_FWD;
+	  sim->run = 0;
+	  sim->run_cmd = 0;
+	  sim->fwd_run = 0;
+	  sim_schedule (sim, &sim->cfg->setup,
+			(unsigned char) ((st | S1284_PERROR | S1284_NACK)
+					 & ~S1284_BUSY), sim->pdata);
+	}
+      break;
+
+    case SIM_EPP:
+      if (fell & C1284_NINIT)
+	{
+	  /* Reset. */
+	  sim->phase = SIM_COMPAT;
+	  sim->epp = SIM_EPP_IDLE;
+	  sim->status = SIM_COMPAT_IDLE;
+	  break;
+	}
+
+      if (sim->epp == SIM_EPP_IDLE
+	  && (fell & (C1284_NAUTOFD | C1284_NSELECTIN)))
+	{
+	  /* Event 58: nWait (Busy) goes high. */
+	  unsigned char pdata = sim->pdata;
+	  sim->epp = (fell & C1284_NAUTOFD) ? SIM_EPP_DATA : SIM_EPP_ADDR;
+	  sim->epp_write = !(new & C1284_NSTROBE);
+	  if (!sim->epp_write)
+	    {
+	      if (sim->epp == SIM_EPP_ADDR)
+		pdata = sim->epp_addr;
+	      else if (sim_avail (sim, 0))
+		{
+		  pdata = sim_peek (sim, 0);
+		  sim_consume (sim, 1);
+		}
+	    }
+
+	  sim_schedule (sim, &sim->cfg->latency,
+			(unsigned char) (st | S1284_BUSY), pdata);
+	}
+      else if ((sim->epp == SIM_EPP_DATA && (rose & C1284_NAUTOFD))
+	       || (sim->epp == SIM_EPP_ADDR && (rose & C1284_NSELECTIN)))
+	{
+	  /* End of cycle.  Event 60: nWait (Busy) goes low. */
+	  if (sim->epp_write)
+	    {
+	      if (sim->epp == SIM_EPP_DATA)
+		sim_sink (sim, sim->data, 1);
+	      else
+		sim->epp_addr = sim->data;
+	    }
+
+	  sim->epp = SIM_EPP_IDLE;
+	  sim_schedule (sim, &sim->cfg->latency,
+			(unsigned char) (st & ~S1284_BUSY), sim->pdata);
+	}
+      break;
+
+    case SIM_TERMINATION:
+      if (fell & C1284_NAUTOFD)
+	{
+	  /* Event 25 seen.  Events 27/28: back to compatibility mode,
+	   * nAck goes high. */
+	  sim->phase = SIM_COMPAT;
+	  sim->devid = NULL;
+	  sim_schedule (sim, &sim->cfg->setup, SIM_COMPAT_IDLE, sim->pdata);
+	}
+      break;
+
+    default:
+      break;
+    }
+}
+
+/* Put the control lines where the control register, or for the
+ * lines the port is driving itself, its handshaking says. */
+static void
+sim_drive (struct sim_priv *sim)
+{
+  unsigned char old = sim->ctr;
+  unsigned char ctr = ((sim->ctr_reg & ~sim->hw_mask)
+		       | (sim->hw_lines & sim->hw_mask));
+
+  sim->ctr = ctr;
+  if (old != ctr)
+    {
+      sim_control (sim, old, ctr);
+      sim_step (sim);
+    }
+}
+
+static void
+sim_set_control (struct sim_priv *sim, unsigned char ctr)
+{
+  sim_access (sim);
+  sim->ctr_reg = ctr;
+  sim_drive (sim);
+}
+
+static struct sim_fifo_entry *
+sim_fifo_tail (struct sim_priv *sim)
+{
+  return &sim->fifo[(sim->fifo_head + sim->fifo_count) % SIM_FIFO_MAX];
+}
+
+static void
+sim_fifo_push (struct sim_priv *sim, const struct sim_fifo_entry *e)
+{
+  if (sim->fifo_count < sim->fifo_depth)
+    {
+      *sim_fifo_tail (sim) = *e;
+      sim->fifo_count++;
+    }
+}
+
+static struct sim_fifo_entry
+sim_fifo_pop (struct sim_priv *sim)
+{
+  struct sim_fifo_entry e;
+
+  if (!sim->fifo_count)
+    {
+      memset (&e, 0xff, sizeof e);
+      return e;
+    }
+
+  e = sim->fifo[sim->fifo_head];
+  sim->fifo_head = (sim->fifo_head + 1) % SIM_FIFO_MAX;
+  sim->fifo_count--;
+  return e;
+}
+
+static void
+sim_fifo_reset (struct sim_priv *sim)
+{
+  sim->fifo_head = sim->fifo_count = 0;
+  sim->part.len = 0;
+  sim->hw = SIM_HW_IDLE;
+  sim->hw_byte = 0;
+  sim->hw_run = sim->hw_left = 0;
+}
+
+/* A reverse byte goes into the FIFO a PWord at a time. */
+static void
+sim_fifo_rev (struct sim_priv *sim, unsigned char byte)
+{
+  sim->part.byte[sim->part.len++] = byte;
+  if (sim->part.len == sim->pword)
+    {
+      sim->part.cmd = 0;
+      sim_fifo_push (sim, &sim->part);
+      sim->part.len = 0;
+    }
+}
+
+/* The ECP port's handshaking, when the ECR is in ECP mode. */
+static void
+sim_hw (struct sim_priv *sim)
+{
+  for (;;)
+    {
+      unsigned char st = sim->status;
+      const struct sim_fifo_entry *e;
+
+      if (SIM_ECR_MODE (sim) != ECR_ECP || sim->pending)
+	return;
+
+      if (!sim->reverse && sim->hw == SIM_HW_IDLE)
+	{
+	  if (!sim->fifo_count || (st & S1284_BUSY))
+	    return;
+
+	  /* Event 34: data on the data lines, and nAutoFd low for a
+	   * command.  Event 35: nStrobe low. */
+	  e = &sim->fifo[sim->fifo_head];
+	  sim->data = e->byte[sim->hw_byte];
+	  sim->hw_lines = e->cmd ? 0 : C1284_NAUTOFD;
+	  sim->hw = SIM_HW_STROBE;
+	}
+      else if (!sim->reverse)
+	{
+	  if (!(st & S1284_BUSY))
+	    return;
+
+	  /* Event 37: nStrobe high. */
+	  e = &sim->fifo[sim->fifo_head];
+	  sim->hw_lines |= C1284_NSTROBE;
+	  if (++sim->hw_byte >= e->len)
+	    {
+	      sim_fifo_pop (sim);
+	      sim->hw_byte = 0;
+	    }
+
+	  sim->hw = SIM_HW_IDLE;
+	}
+      else if (sim->hw == SIM_HW_IDLE)
+	{
+	  if ((st & S1284_NACK) || sim->fifo_count == sim->fifo_depth)
+	    return;
+
+	  /* Event 43 seen.  Busy low means a command: a run-length
+	   * count, or a channel address which we drop. */
+	  if (!(st & S1284_BUSY))
+	    {
+	      if (!(sim->pdata & 0x80))
+		sim->hw_run = sim->pdata + 1;
+	    }
+	  else
+	    {
+	      sim->hw_val = sim->pdata;
+	      sim->hw_left = sim->hw_run ? sim->hw_run : 1;
+	      sim->hw_run = 0;
+	    }
+
+	  /* Event 44: HostAck (nAutoFd) high. */
+	  sim->hw_lines = C1284_NSTROBE | C1284_NAUTOFD;
+	  sim->hw = SIM_HW_ACK;
+	}
+      else
+	{
+	  while (sim->hw_left && sim->fifo_count < sim->fifo_depth)
+	    {
+	      sim_fifo_rev (sim, sim->hw_val);
+	      sim->hw_left--;
+	    }
+
+	  if (sim->hw_left || !(st & S1284_NACK))
+	    return;
+
+	  /* Event 45 seen.  Event 46: HostAck low. */
+	  sim->hw_lines = C1284_NSTROBE;
+	  sim->hw = SIM_HW_IDLE;
+	}
+
+      sim_drive (sim);
+      sim_settle (sim);
+    }
+}
+
+static unsigned char
+sim_ecr (struct sim_priv *sim)
+{
+  unsigned char ecr = sim->ecr;
+  unsigned int mode = SIM_ECR_MODE (sim);
+  unsigned int threshold = sim->fifo_depth / 2;
+
+  if (!threshold)
+    threshold = 1;
+
+  /* serviceIntr is set, when it's armed, once there are at least
+   * threshold free (forward) or full (reverse) entries. */
+  if (!(ecr & ECR_SERVICEINTR)
+      && (mode == ECR_PPF || mode == ECR_ECP || mode == ECR_TST)
+      && (sim->reverse
+	  ? sim->fifo_count >= threshold
+	  : sim->fifo_depth - sim->fifo_count >= threshold))
+    sim->ecr = ecr |= ECR_SERVICEINTR;
+
+  if (!sim->fifo_count)
+    ecr |= ECR_F_EMPTY;
+  if (sim->fifo_count == sim->fifo_depth)
+    ecr |= ECR_F_FULL;
+
+  return ecr;
+}
+
+static void
+sim_set_ecr (struct sim_priv *sim, unsigned char val)
+{
+  unsigned int old = SIM_ECR_MODE (sim);
+
+  sim->ecr = val & ~(ECR_F_FULL | ECR_F_EMPTY);
+  if (SIM_ECR_MODE (sim) == old)
+    return;
+
+  if (SIM_ECR_MODE (sim) == ECR_SPP || SIM_ECR_MODE (sim) == ECR_PS2)
+    sim_fifo_reset (sim);
+
+  sim->hw_mask = 0;
+  if (SIM_ECR_MODE (sim) == ECR_ECP)
+    {
+      sim->hw = SIM_HW_IDLE;
+      sim->hw_mask = C1284_NSTROBE | C1284_NAUTOFD;
+      sim->hw_lines = sim->ctr_reg & sim->hw_mask;
+    }
+
+  sim_drive (sim);
+}
+
+/* Whether the EPP registers run EPP cycles. */
+static int
+sim_epp_mode (struct sim_priv *sim)
+{
+  return (sim->cfg->epp_registers
+	  && (!sim->fifo_depth || SIM_ECR_MODE (sim) == ECR_EPP));
+}
+
+/* Wait up to 10us for nWait (Busy) to reach the given level, or set
+ * the timeout bit. */
+static int
+sim_epp_wait (struct sim_priv *sim, unsigned char busy)
+{
+  double deadline = sim->now + 10000;
+
+  while ((sim->status & S1284_BUSY) != busy)
+    {
+      if (!sim->pending || sim->due > deadline)
+	{
+	  sim->now = deadline;
+	  sim->epp_timeout = 1;
+	  return 0;
+	}
+
+      sim->now = sim->due;
+      sim_settle (sim);
+    }
+
+  return 1;
+}
+
+/* An EPP cycle, run by the port.  STROBE is nDStrb (nAutoFd) for a
+ * data cycle, or nAStrb (nSelectIn) for an address cycle. */
+static unsigned char
+sim_epp_cycle (struct sim_priv *sim, unsigned char strobe, int write,
+	       unsigned char val)
+{
+  unsigned char byte = 0xff;
+
+  sim_access (sim);
+  if (write)
+    sim->data = val;
+
+  /* Event 62: nWrite low for a write, then nDStrb or nAStrb low. */
+  sim->hw_mask = C1284_NSTROBE | C1284_NAUTOFD | C1284_NSELECTIN;
+  sim->hw_lines = sim->hw_mask & ~strobe;
+  if (write)
+    sim->hw_lines &= ~C1284_NSTROBE;
+  sim_drive (sim);
+
+  /* Event 58: nWait high. */
+  if (sim_epp_wait (sim, S1284_BUSY))
+    {
+      if (!write)
+	byte = sim->pdata;
+
+      /* Event 63: the strobe goes high.  Event 60: nWait low. */
+      sim->hw_lines |= strobe;
+      sim_drive (sim);
+      sim_epp_wait (sim, 0);
+    }
+
+  sim->hw_mask = 0;
+  sim_drive (sim);
+  return byte;
+}
+
+/* Register access, for ecr.c. */
+static unsigned char
+sim_inb (struct parport_internal *port, unsigned long addr)
+{
+  struct sim_priv *sim = port->access_priv;
+  const unsigned char rm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  unsigned int mode = SIM_ECR_MODE (sim);
+  struct sim_fifo_entry e;
+
+  sim_access (sim);
+  if (addr == port->base)
+    return sim->reverse ? sim->pdata : sim->data;
+  if (addr == port->base + 1)
+    /* Bit 0 is the EPP timeout bit, which is stuck high outside EPP
+     * mode. */
+    return (sim->status ^ S1284_INVERTED) | (!sim_epp_mode (sim)
+					     || sim->epp_timeout);
+  if (addr == port->base + 2)
+    return ((unsigned char) ((sim->ctr_reg ^ C1284_INVERTED) & rm)
+	    | (sim->reverse ? 0x20 : 0));
+  if (addr == port->base + 3 && sim_epp_mode (sim))
+    return sim_epp_cycle (sim, C1284_NSELECTIN, 0, 0);
+  if (addr >= port->base + 4 && addr < port->base + 8 && sim_epp_mode (sim))
+    return sim_epp_cycle (sim, C1284_NAUTOFD, 0, 0);
+  if (!sim->fifo_depth)
+    return 0xff;
+
+  if (addr == ECR_ECR (port))
+    {
+      /* Software polling the ECR is waiting for the port.  Skip to
+       * the peripheral's next response. */
+      if (mode == ECR_ECP && sim->pending && sim->due > sim->now)
+	{
+	  sim->now = sim->due;
+	  sim_settle (sim);
+	  sim_hw (sim);
+	}
+
+      return sim_ecr (sim);
+    }
+
+  if (addr == ECR_CNFGA (port))
+    {
+      if (mode == ECR_CNF)
+	/* Implementation ID, and no byte in the transmitter. */
+	return 0x04 | ((sim->pword == 1 ? 1 : sim->pword == 2 ? 0 : 2) << 4);
+
+      e = sim_fifo_pop (sim);
+      return e.byte[0];
+    }
+
+  if (addr == ECR_CNFGB (port) && mode == ECR_CNF)
+    return 0;
+
+  return 0xff;
+}
+
+static void
+sim_fifo_write (struct parport_internal *port, const unsigned char *bytes,
+		unsigned char len)
+{
+  struct sim_priv *sim = port->access_priv;
+  unsigned int mode = SIM_ECR_MODE (sim);
+  struct sim_fifo_entry e;
+
+  sim_access (sim);
+  if (mode != ECR_PPF && mode != ECR_ECP && mode != ECR_TST)
+    return;
+
+  memcpy (e.byte, bytes, len);
+  e.len = len;
+  e.cmd = 0;
+  sim_fifo_push (sim, &e);
+  sim_hw (sim);
+}
+
+static void
+sim_outb (struct parport_internal *port, unsigned char val,
+	  unsigned long addr)
+{
+  struct sim_priv *sim = port->access_priv;
+  const unsigned char wm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  struct sim_fifo_entry e;
+
+  if (addr == port->base && SIM_ECR_MODE (sim) == ECR_ECP)
+    {
+      /* The address FIFO. */
+      sim_access (sim);
+      e.byte[0] = val;
+      e.len = 1;
+      e.cmd = 1;
+      sim_fifo_push (sim, &e);
+      sim_hw (sim);
+    }
+  else if (addr == port->base)
+    {
+      sim_access (sim);
+      sim->data = val;
+    }
+  else if (addr == port->base + 1)
+    {
+      /* This chip clears the EPP timeout bit when 1 is written. */
+      sim_access (sim);
+      if (val & 1)
+	sim->epp_timeout = 0;
+    }
+  else if (addr == port->base + 2)
+    {
+      sim->reverse = (val & 0x20) ? 1 : 0;
+      sim_set_control (sim, (unsigned char) ((val ^ C1284_INVERTED) & wm));
+    }
+  else if (addr == port->base + 3 && sim_epp_mode (sim))
+    sim_epp_cycle (sim, C1284_NSELECTIN, 1, val);
+  else if (addr >= port->base + 4 && addr < port->base + 8
+	   && sim_epp_mode (sim))
+    sim_epp_cycle (sim, C1284_NAUTOFD, 1, val);
+  else if (sim->fifo_depth && addr == ECR_ECR (port))
+    {
+      sim_access (sim);
+      sim_set_ecr (sim, val);
+      sim_hw (sim);
+    }
+  else if (sim->fifo_depth && addr == ECR_DFIFO (port))
+    sim_fifo_write (port, &val, 1);
+  else
+    sim_access (sim);
+}
+
+/* Wide access to the EPP data register runs a cycle for each byte;
+ * to the FIFO, it fills one entry. */
+static unsigned short
+sim_inw (struct parport_internal *port, unsigned long addr)
+{
+  return (unsigned short) (sim_inb (port, addr)
+			   | sim_inb (port, addr + 1) << 8);
+}
+
+static void
+sim_outw (struct parport_internal *port, unsigned short val,
+	  unsigned long addr)
+{
+  unsigned char bytes[2];
+
+  bytes[0] = (unsigned char) val;
+  bytes[1] = (unsigned char) (val >> 8);
+  if (addr == ECR_DFIFO (port))
+    sim_fifo_write (port, bytes, 2);
+  else
+    {
+      sim_outb (port, bytes[0], addr);
+      sim_outb (port, bytes[1], addr + 1);
+    }
+}
+
+static unsigned int
+sim_inl (struct parport_internal *port, unsigned long addr)
+{
+  return sim_inw (port, addr) | (unsigned int) sim_inw (port, addr + 2) << 16;
+}
+
+static void
+sim_outl (struct parport_internal *port, unsigned int val,
+	  unsigned long addr)
+{
+  unsigned char bytes[4];
+  int i;
+
+  for (i = 0; i < 4; i++)
+    bytes[i] = (unsigned char) (val >> (8 * i));
+  if (addr == ECR_DFIFO (port))
+    sim_fifo_write (port, bytes, 4);
+  else
+    for (i = 0; i < 4; i++)
+      sim_outb (port, bytes[i], addr + i);
+}
+
+static int
+init (struct parport *pport, int flags, int *capabilities)
+{
+  struct parport_internal *port = pport->priv;
+  const struct sim_port_config *cfg = find_sim_port_config (pport->name);
+  struct sim_priv *sim;
+  size_t len = sizeof (sim_deviceid) - 1;
+
+  if (!cfg)
+    return E1284_INIT;
+
+  if (flags & ~(F1284_EXCL | F1284_NOPAUSE | F1284_DIRECTIO))
+    return E1284_NOTAVAIL;
+
+  sim = malloc (sizeof *sim);
+  if (!sim)
+    return E1284_NOMEM;
+
+  memset (sim, 0, sizeof *sim);
+  sim->cfg = cfg;
+  sim->rng = cfg->seed & 0xffffffffUL;
+  if (!sim->rng)
+    sim->rng = 1;
+
+  sim->ctr = C1284_NSTROBE | C1284_NAUTOFD | C1284_NINIT;
+  sim->ctr_reg = sim->ctr;
+  sim->ecr = ECR_MODE (ECR_SPP) | ECR_NERRINTREN | ECR_SERVICEINTR;
+  sim->fifo_depth = cfg->ecp_fifo;
+  sim->pword = cfg->pword;
+  sim->status = SIM_COMPAT_IDLE;
+  sim->phase = SIM_COMPAT;
+  sim->devid_len = 2 + len;
+  sim->devid_buf[0] = (unsigned char) (sim->devid_len >> 8);
+  sim->devid_buf[1] = (unsigned char) (sim->devid_len & 0xff);
+  memcpy (sim->devid_buf + 2, sim_deviceid, len);
+
+  if (cfg->sink)
+    {
+      sim->sink = fopen (cfg->sink, "wb");
+      if (!sim->sink)
+	debugprintf ("Can't write %s\n", cfg->sink);
+    }
+
+  port->access_priv = sim;
+  port->current_mode = M1284_COMPAT;
+  port->current_phase = PH1284_FWD_IDLE;
+
+  if (capabilities)
+    *capabilities |= CAP1284_RAW | CAP1284_EPPSWE;
+
+  if (sim->fifo_depth)
+    {
+      if (!port->base_hi)
+	port->base_hi = port->base + 0x400;
+      if (ecr_install (port) && capabilities)
+	*capabilities |= CAP1284_ECP | CAP1284_ECPRLE;
+    }
+
+  if (epp_install (port) && capabilities)
+    *capabilities |= CAP1284_EPP;
+
+  return E1284_OK;
+}
+
+static void
+cleanup (struct parport_internal *port)
+{
+  struct sim_priv *sim = port->access_priv;
+
+  debugprintf ("Simulated peripheral accepted %lu bytes (sum %#lx), "
+	       "sent %lu, after %.0fns\n",
+	       sim->sunk, sim->sum, sim->sent, sim->now);
+  ecr_cleanup (port);
+  if (sim->sink)
+    fclose (sim->sink);
+  free (sim);
+  port->access_priv = NULL;
+}
+
+static int
+read_data (struct parport_internal *port)
+{
+  struct sim_priv *sim = port->access_priv;
+  unsigned char d;
+  sim_access (sim);
+  d = sim->reverse ? sim->pdata : sim->data;
+  TRACE_DATA (port, d);
+  return d;
+}
+
+static void
+write_data (struct parport_internal *port, unsigned char reg)
+{
+  struct sim_priv *sim = port->access_priv;
+  sim_access (sim);
+  sim->data = reg;
+}
+
+/* Wait, in simulated time, for the lines selected by get to have the
+ * wanted value. */
+static int
+sim_wait (struct parport_internal *port,
+	  int (*get) (struct parport_internal *port),
+	  unsigned char mask, unsigned char val,
+	  struct timeval *timeout)
+{
+  struct sim_priv *sim = port->access_priv;
+  double start = sim->now;
+  double deadline = start + (timeout->tv_sec * 1000000.0
+			     + timeout->tv_usec) * 1000;
+
+  stats_wait_start (port, mask, val);
+  for (;;)
+    {
+      port->stats.c.wait_reads++;
+      if ((get (port) & mask) == val)
+	{
+	  stats_wait_done (port, E1284_OK, (nsec_t) (sim->now - start), 0);
+	  return E1284_OK;
+	}
+
+      if (sim->now >= deadline)
+	break;
+
+      if (sim->pending && sim->due < deadline)
+	sim->now = sim->due;
+      else
+	sim->now = deadline;
+    }
+
+  stats_wait_done (port, E1284_TIMEDOUT, (nsec_t) (sim->now - start), 0);
+  return E1284_TIMEDOUT;
+}
+
+static int
+wait_data (struct parport_internal *port, unsigned char mask,
+	   unsigned char val, struct timeval *timeout)
+{
+  return sim_wait (port, read_data, mask, val, timeout);
+}
+
+static int
+data_dir (struct parport_internal *port, int reverse)
+{
+  struct sim_priv *sim = port->access_priv;
+  sim_access (sim);
+  sim->reverse = reverse;
+  return E1284_OK;
+}
+
+static int
+read_status (struct parport_internal *port)
+{
+  struct sim_priv *sim = port->access_priv;
+  sim_access (sim);
+  TRACE_STATUS (port, sim->status);
+  return sim->status;
+}
+
+static int
+wait_status (struct parport_internal *port,
+	     unsigned char mask, unsigned char val,
+	     struct timeval *timeout)
+{
+  return sim_wait (port, read_status, mask, val, timeout);
+}
+
+static int
+read_control (struct parport_internal *port)
+{
+  struct sim_priv *sim = port->access_priv;
+  const unsigned char rm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  return sim->ctr_reg & rm;
+}
+
+static void
+write_control (struct parport_internal *port, unsigned char reg)
+{
+  struct sim_priv *sim = port->access_priv;
+  const unsigned char wm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  if (reg & 0x20)
+    {
+      printf ("use ieee1284_data_dir to change data line direction!\n");
+      data_dir (port, 1);
+    }
+
+  sim_set_control (sim, (unsigned char) (reg & wm));
+  TRACE_CONTROL (port, reg & wm);
+}
+
+static void
+frob_control (struct parport_internal *port,
+	      unsigned char mask,
+	      unsigned char val)
+{
+  struct sim_priv *sim = port->access_priv;
+  const unsigned char wm = (C1284_NSTROBE |
+			    C1284_NAUTOFD |
+			    C1284_NINIT |
+			    C1284_NSELECTIN);
+  if (mask & 0x20)
+    {
+      printf ("use ieee1284_data_dir to change data line direction!\n");
+      data_dir (port, val & 0x20);
+    }
+
+  mask &= wm;
+  val &= wm;
+  sim_set_control (sim, (unsigned char) ((sim->ctr_reg & ~mask) ^ val));
+  TRACE_FROB (port, mask, val);
+}
+
+const struct parport_access_methods sim_access_methods =
+{
+  init,
+  cleanup,
+
+  NULL, /* claim */
+  NULL, /* release */
+
+  sim_inb,
+  sim_outb,
+  sim_inw,
+  sim_outw,
+  sim_inl,
+  sim_outl,
+
+  NULL, /* get_irq_fd */
+  NULL, /* clear_irq */
+
+  read_data,
+  write_data,
+  wait_data,
+  data_dir,
+
+  read_status,
+  wait_status,
+
+  read_control,
+  write_control,
+  frob_control,
+
+  default_do_nack_handshake,
+  default_negotiate,
+  default_terminate,
+  default_ecp_fwd_to_rev,
+  default_ecp_rev_to_fwd,
+  default_nibble_read,
+  default_compat_write,
+  default_byte_read,
+  default_epp_read_data,
+  default_epp_write_data,
+  default_epp_read_addr,
+  default_epp_write_addr,
+  default_ecp_read_data,
+  default_ecp_write_data,
+  default_ecp_read_addr,
+  default_ecp_write_addr,
+  default_set_timeout,
+  default_pin_program
+};
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,428 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * Asynchronous transfers.  The first submission on a port starts a
+ * worker thread for it, which takes the queued transfers in turn and
+ * makes them with the ordinary blocking functions, so one thread can
+ * keep many ports busy.  Because there is one worker and one queue,
+ * transfers complete in the order they were submitted; a cancelled
+ * transfer still completes in its place, with E1284_CANCELLED.
+ *
+ * A completion goes to its callback, called on the worker thread, or
+ * is kept for ieee1284_reap.  Kept completions are counted on an
+ * eventfd (or a pipe), so that the caller can poll for them.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#include <stdint.h>
+#include <sys/eventfd.h>
+#endif
+#endif
+
+#include "async.h"
+#include "debug.h"
+#include "detect.h"
+#include "ieee1284.h"
+
+ssize_t
+async_transfer (struct parport *port, int call, int flags, void *buffer,
+		size_t len)
+{
+  char *buf = buffer;
+
+  switch (call)
+    {
+    case SC1284_NIBBLE_READ:
+      return ieee1284_nibble_read (port, flags, buf, len);
+    case SC1284_COMPAT_WRITE:
+      return ieee1284_compat_write (port, flags, buf, len);
+    case SC1284_BYTE_READ:
+      return ieee1284_byte_read (port, flags, buf, len);
+    case SC1284_EPP_READ_DATA:
+      return ieee1284_epp_read_data (port, flags, buf, len);
+    case SC1284_EPP_WRITE_DATA:
+      return ieee1284_epp_write_data (port, flags, buf, len);
+    case SC1284_EPP_READ_ADDR:
+      return ieee1284_epp_read_addr (port, flags, buf, len);
+    case SC1284_EPP_WRITE_ADDR:
+      return ieee1284_epp_write_addr (port, flags, buf, len);
+    case SC1284_ECP_READ_DATA:
+      return ieee1284_ecp_read_data (port, flags, buf, len);
+    case SC1284_ECP_WRITE_DATA:
+      return ieee1284_ecp_write_data (port, flags, buf, len);
+    case SC1284_ECP_READ_ADDR:
+      return ieee1284_ecp_read_addr (port, flags, buf, len);
+    case SC1284_ECP_WRITE_ADDR:
+      return ieee1284_ecp_write_addr (port, flags, buf, len);
+    }
+
+  return E1284_NOTIMPL;
+}
+
+#ifdef HAVE_PTHREAD_H
+
+struct async_request
+{
+  struct async_request *next;
+  struct ieee1284_completion c;
+  int flags;
+  size_t len;
+  ieee1284_callback callback;
+  int cancelled;
+};
+
+struct async_state
+{
+  struct parport *port;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t work;		/* Signalled when a transfer is queued */
+  pthread_cond_t done;		/* Signalled when a completion is kept */
+
+  struct async_request *queue, **queue_tail;
+  struct async_request *kept, **kept_tail;
+  unsigned int to_reap;		/* Queued or kept, with no callback */
+  int next_id;
+  int quit;
+
+  /* The same eventfd twice, or the ends of a pipe. */
+  int fd_read, fd_write;
+};
+
+static void
+notify (struct async_state *a)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+  uint64_t one = 1;
+#else
+  char one = 1;
+#endif
+  while (write (a->fd_write, &one, sizeof one) < 0 && errno == EINTR)
+    ;
+}
+
+static void
+consume (struct async_state *a)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+  uint64_t one;
+#else
+  char one;
+#endif
+  while (read (a->fd_read, &one, sizeof one) < 0 && errno == EINTR)
+    ;
+}
+
+static void *
+worker (void *arg)
+{
+  struct async_state *a = arg;
+  struct async_request *r;
+  int cancelled;
+
+  pthread_mutex_lock (&a->lock);
+  for (;;)
+    {
+      while (!a->queue && !a->quit)
+	pthread_cond_wait (&a->work, &a->lock);
+
+      r = a->queue;
+      if (!r)
+	break;
+
+      a->queue = r->next;
+      if (!a->queue)
+	a->queue_tail = &a->queue;
+      cancelled = r->cancelled;
+      pthread_mutex_unlock (&a->lock);
+
+      r->c.result = (cancelled ? E1284_CANCELLED :
+		     async_transfer (a->port, r->c.call, r->flags,
+				     r->c.buffer, r->len));
+
+      if (r->callback)
+	{
+	  r->callback (a->port, &r->c);
+	  free (r);
+	  pthread_mutex_lock (&a->lock);
+	  continue;
+	}
+
+      r->next = NULL;
+      pthread_mutex_lock (&a->lock);
+      *a->kept_tail = r;
+      a->kept_tail = &r->next;
+      notify (a);
+      pthread_cond_broadcast (&a->done);
+    }
+  pthread_mutex_unlock (&a->lock);
+  return NULL;
+}
+
+static void
+free_state (struct async_state *a)
+{
+  struct async_request *r;
+
+  while ((r = a->kept) != NULL)
+    {
+      a->kept = r->next;
+      free (r);
+    }
+
+  close (a->fd_read);
+  if (a->fd_write != a->fd_read)
+    close (a->fd_write);
+  pthread_cond_destroy (&a->done);
+  pthread_cond_destroy (&a->work);
+  pthread_mutex_destroy (&a->lock);
+  free (a);
+}
+
+/* The port's state, starting the worker if it isn't running. */
+static struct async_state *
+start (struct parport *port)
+{
+  struct parport_internal *priv = port->priv;
+  struct async_state *a = priv->async;
+#ifndef HAVE_SYS_EVENTFD_H
+  int fds[2];
+#endif
+
+  if (a)
+    return a;
+
+  a = malloc (sizeof *a);
+  if (!a)
+    return NULL;
+
+  memset (a, 0, sizeof *a);
+  a->port = port;
+  a->queue_tail = &a->queue;
+  a->kept_tail = &a->kept;
+  a->next_id = 1;
+
+#ifdef HAVE_SYS_EVENTFD_H
+  a->fd_read = a->fd_write = eventfd (0, EFD_NONBLOCK | EFD_SEMAPHORE);
+  if (a->fd_read < 0)
+#else
+  if (pipe (fds))
+#endif
+    {
+      debugprintf ("async: no completion fd: %s\n", strerror (errno));
+      free (a);
+      return NULL;
+    }
+#ifndef HAVE_SYS_EVENTFD_H
+  a->fd_read = fds[0];
+  a->fd_write = fds[1];
+  fcntl (a->fd_read, F_SETFL, O_NONBLOCK);
+  fcntl (a->fd_write, F_SETFL, O_NONBLOCK);
+#endif
+
+  pthread_mutex_init (&a->lock, NULL);
+  pthread_cond_init (&a->work, NULL);
+  pthread_cond_init (&a->done, NULL);
+
+  if (pthread_create (&a->thread, NULL, worker, a))
+    {
+      debugprintf ("async: can't start the worker for %s\n", priv->name);
+      free_state (a);
+      return NULL;
+    }
+
+  debugprintf ("async: worker started for %s\n", priv->name);
+  priv->async = a;
+  return a;
+}
+
+int
+async_submit (struct parport *port, int call, int flags, void *buffer,
+	      size_t len, ieee1284_callback callback, void *data)
+{
+  struct async_state *a = start (port);
+  struct async_request *r;
+  int id;
+
+  if (!a)
+    return E1284_NOMEM;
+
+  r = malloc (sizeof *r);
+  if (!r)
+    return E1284_NOMEM;
+
+  memset (r, 0, sizeof *r);
+  r->c.call = call;
+  r->c.buffer = buffer;
+  r->c.data = data;
+  r->flags = flags;
+  r->len = len;
+  r->callback = callback;
+
+  pthread_mutex_lock (&a->lock);
+  id = r->c.id = a->next_id++;
+  if (a->next_id <= 0)
+    a->next_id = 1;
+  if (!callback)
+    a->to_reap++;
+  *a->queue_tail = r;
+  a->queue_tail = &r->next;
+  pthread_cond_signal (&a->work);
+  pthread_mutex_unlock (&a->lock);
+
+  return id;
+}
+
+int
+async_cancel (struct parport_internal *port, int id)
+{
+  struct async_state *a = port->async;
+  struct async_request *r;
+  int ret = E1284_NOTAVAIL;
+
+  if (!a)
+    return ret;
+
+  pthread_mutex_lock (&a->lock);
+  for (r = a->queue; r; r = r->next)
+    if (r->c.id == id && !r->cancelled)
+      {
+	r->cancelled = 1;
+	ret = E1284_OK;
+	break;
+      }
+  pthread_mutex_unlock (&a->lock);
+
+  return ret;
+}
+
+int
+async_get_fd (struct parport *port)
+{
+  struct async_state *a = start (port);
+  return a ? a->fd_read : E1284_NOMEM;
+}
+
+int
+async_reap (struct parport_internal *port, int flags,
+	    struct ieee1284_completion *completion)
+{
+  struct async_state *a = port->async;
+  struct async_request *r;
+
+  if (!a)
+    return E1284_NOTAVAIL;
+
+  pthread_mutex_lock (&a->lock);
+  while (!a->kept)
+    {
+      if (!a->to_reap || (flags & F1284_NONBLOCK))
+	{
+	  pthread_mutex_unlock (&a->lock);
+	  return a->to_reap ? E1284_TIMEDOUT : E1284_NOTAVAIL;
+	}
+      pthread_cond_wait (&a->done, &a->lock);
+    }
+
+  r = a->kept;
+  a->kept = r->next;
+  if (!a->kept)
+    a->kept_tail = &a->kept;
+  a->to_reap--;
+  consume (a);
+  pthread_mutex_unlock (&a->lock);
+
+  *completion = r->c;
+  free (r);
+  return E1284_OK;
+}
+
+void
+async_cleanup (struct parport_internal *port)
+{
+  struct async_state *a = port->async;
+  struct async_request *r;
+
+  if (!a)
+    return;
+
+  pthread_mutex_lock (&a->lock);
+  for (r = a->queue; r; r = r->next)
+    r->cancelled = 1;
+  a->quit = 1;
+  pthread_cond_signal (&a->work);
+  pthread_mutex_unlock (&a->lock);
+
+  pthread_join (a->thread, NULL);
+  free_state (a);
+  port->async = NULL;
+}
+
+#else /* !HAVE_PTHREAD_H */
+
+int
+async_submit (struct parport *port, int call, int flags, void *buffer,
+	      size_t len, ieee1284_callback callback, void *data)
+{
+  return E1284_NOTAVAIL;
+}
+
+int
+async_cancel (struct parport_internal *port, int id)
+{
+  return E1284_NOTAVAIL;
+}
+
+int
+async_get_fd (struct parport *port)
+{
+  return E1284_NOTAVAIL;
+}
+
+int
+async_reap (struct parport_internal *port, int flags,
+	    struct ieee1284_completion *completion)
+{
+  return E1284_NOTAVAIL;
+}
+
+void
+async_cleanup (struct parport_internal *port)
+{
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,51 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _ASYNC_H_
+#define _ASYNC_H_
+
+#include "detect.h"
+
+/* Make a transfer, CALL being its SC1284_* number, with the
+ * ordinary blocking function for it. */
+extern ssize_t async_transfer (struct parport *port, int call, int flags,
+			       void *buffer, size_t len);
+
+/* Queue a transfer, CALL being its SC1284_* number, for the port's
+ * worker, starting the worker if need be.  Returns the id. */
+extern int async_submit (struct parport *port, int call, int flags,
+			 void *buffer, size_t len,
+			 ieee1284_callback callback, void *data);
+
+extern int async_cancel (struct parport_internal *port, int id);
+extern int async_get_fd (struct parport *port);
+extern int async_reap (struct parport_internal *port, int flags,
+		       struct ieee1284_completion *completion);
+
+/* Cancel what is queued, wait for the worker to finish and stop it. */
+extern void async_cleanup (struct parport_internal *port);
+
+#endif /* _ASYNC_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
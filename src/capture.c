@@ -0,0 +1,291 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Waveform capture.  While a capture is running, every change the
+ * trace points see on a port's data, status and control lines, and
+ * in the direction of the data lines, is kept with its time.  When
+ * it stops, the changes are written out as a Value Change Dump (IEEE
+ * 1364), which waveform viewers such as GTKWave can show.
+ *
+ * Times are from the monotonic clock, so on simulated ports they
+ * show how long the library took rather than simulated time.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "capture.h"
+#include "conf.h"
+#include "debug.h"
+#include "delay.h"
+#include "detect.h"
+#include "ieee1284.h"
+#include "shadow.h"
+#include "trace.h"
+
+#define ENVAR "LIBIEEE1284_CAPTURE"
+
+struct capture_sample
+{
+  nsec_t time;			/* Since the capture started */
+  unsigned char point;
+  unsigned char value;
+};
+
+struct capture
+{
+  nsec_t start;
+  size_t size;
+  size_t used;
+  unsigned long dropped;	/* Changes after the buffer filled */
+  char *file;			/* Where capture_cleanup writes it */
+  struct capture_sample s[1];
+};
+
+/* The signals in the dump, and their one-character identifiers. */
+static const struct
+{
+  int point;
+  unsigned char bit;
+  const char *name;
+} signals[] = {
+  { TP_STATUS, S1284_NFAULT, "nFault" },
+  { TP_STATUS, S1284_SELECT, "Select" },
+  { TP_STATUS, S1284_PERROR, "PError" },
+  { TP_STATUS, S1284_NACK, "nAck" },
+  { TP_STATUS, S1284_BUSY, "Busy" },
+  { TP_CONTROL, C1284_NSTROBE, "nStrobe" },
+  { TP_CONTROL, C1284_NAUTOFD, "nAutoFd" },
+  { TP_CONTROL, C1284_NINIT, "nInit" },
+  { TP_CONTROL, C1284_NSELECTIN, "nSelectIn" },
+  { TP_DIR, 1, "reverse" }
+};
+#define NSIGNALS (sizeof signals / sizeof signals[0])
+#define DATA_ID '!'
+#define SIGNAL_ID(i) ((char) ('"' + (i)))
+
+int
+capture_start (struct parport_internal *port, size_t samples)
+{
+#ifdef DISABLE_TRACE
+  return E1284_NOTAVAIL;
+#else
+  struct capture *cap;
+  int ct;
+
+  if (port->trace.capture)
+    return E1284_INVALIDPORT;
+
+  if (!samples)
+    samples = CAPTURE_DEFAULT_SAMPLES;
+
+  if (samples - 1 > ((size_t) -1 - sizeof *cap) / sizeof cap->s[0])
+    return E1284_NOMEM;
+
+  cap = malloc (sizeof *cap + (samples - 1) * sizeof cap->s[0]);
+  if (!cap)
+    return E1284_NOMEM;
+
+  memset (cap, 0, sizeof *cap);
+  cap->size = samples;
+  cap->start = monotonic_ns ();
+  port->trace.capture = cap;
+  trace_update (port);
+
+  /* Start from what the lines are now, as far as we can tell. */
+  trace_forget (port);
+  if (port->claimed)
+    {
+      port->fn->read_status (port);
+      ct = port->fn->read_control (port);
+      if (ct >= 0)
+	TRACE_CONTROL (port, ct);
+      if (port->shadow.valid & SHADOW_DATA)
+	TRACE_DATA (port, port->shadow.data);
+      if (port->shadow.valid & SHADOW_DIR)
+	TRACE_DIR (port, port->shadow.reverse);
+    }
+
+  return E1284_OK;
+#endif
+}
+
+void
+capture_sample (struct parport_internal *port, nsec_t time, int point,
+		unsigned char value)
+{
+  struct capture *cap = port->trace.capture;
+  struct capture_sample *s;
+
+  if (cap->used == cap->size)
+    {
+      cap->dropped++;
+      return;
+    }
+
+  s = &cap->s[cap->used++];
+  s->time = time - cap->start;
+  s->point = (unsigned char) point;
+  s->value = value;
+}
+
+static void
+vcd_change (FILE *f, int point, int value)
+{
+  unsigned int i;
+
+  if (point == TP_DATA)
+    {
+      fputc ('b', f);
+      for (i = 0; i < 8; i++)
+	fputc (value < 0 ? 'x' : (value & (0x80 >> i)) ? '1' : '0', f);
+      fprintf (f, " %c\n", DATA_ID);
+      return;
+    }
+
+  for (i = 0; i < NSIGNALS; i++)
+    if (signals[i].point == point)
+      fprintf (f, "%c%c\n",
+	       value < 0 ? 'x' : (value & signals[i].bit) ? '1' : '0',
+	       SIGNAL_ID (i));
+}
+
+static int
+vcd_write (const struct capture *cap, const char *filename)
+{
+  FILE *f = fopen (filename, "w");
+  time_t now = time (NULL);
+  struct tm tm;
+  char date[64];
+  nsec_t t = -1;
+  unsigned int i;
+  size_t n;
+
+  if (!f)
+    {
+      debugprintf ("Can't write %s\n", filename);
+      return E1284_SYS;
+    }
+
+  if (!localtime_r (&now, &tm)
+      || !strftime (date, sizeof date, "%a %b %e %H:%M:%S %Y", &tm))
+    strcpy (date, "unknown");
+  fprintf (f, "$date\n\t%s\n$end\n", date);
+  fprintf (f, "$version\n\tlibieee1284 %s\n$end\n", VERSION);
+  if (cap->dropped)
+    fprintf (f, "$comment\n\t%lu changes after %lu were not kept\n$end\n",
+	     cap->dropped, (unsigned long) cap->size);
+  fprintf (f, "$timescale 1ns $end\n$scope module parport $end\n");
+  fprintf (f, "$var wire 8 %c data $end\n", DATA_ID);
+  for (i = 0; i < NSIGNALS; i++)
+    fprintf (f, "$var wire 1 %c %s $end\n", SIGNAL_ID (i), signals[i].name);
+  fprintf (f, "$upscope $end\n$enddefinitions $end\n");
+
+  /* Nothing is known until it is first seen. */
+  fprintf (f, "#0\n$dumpvars\n");
+  vcd_change (f, TP_DATA, -1);
+  vcd_change (f, TP_STATUS, -1);
+  vcd_change (f, TP_CONTROL, -1);
+  vcd_change (f, TP_DIR, -1);
+  fprintf (f, "$end\n");
+
+  for (n = 0; n < cap->used; n++)
+    {
+      const struct capture_sample *s = &cap->s[n];
+      if (s->time != t)
+	{
+	  t = s->time;
+	  fprintf (f, "#%ld\n", (long) t);
+	}
+      vcd_change (f, s->point, s->value);
+    }
+
+  if (fclose (f))
+    return E1284_SYS;
+
+  debugprintf ("Wrote %lu changes to %s\n", (unsigned long) cap->used,
+	       filename);
+  return E1284_OK;
+}
+
+int
+capture_stop (struct parport_internal *port, const char *filename)
+{
+  struct capture *cap = port->trace.capture;
+  int ret = E1284_OK;
+
+  if (!cap)
+    return E1284_NOTAVAIL;
+
+  port->trace.capture = NULL;
+  trace_update (port);
+
+  if (filename)
+    ret = vcd_write (cap, filename);
+
+  free (cap->file);
+  free (cap);
+  return ret;
+}
+
+void
+capture_install (struct parport_internal *port, const char *name)
+{
+  const char *prefix = conf_getenv (ENVAR);
+  char *file;
+
+  port->trace.capture = NULL;
+  if (!prefix)
+    return;
+
+  file = malloc (strlen (prefix) + strlen (name) + 5);
+  if (!file)
+    return;
+
+  sprintf (file, "%s%s.vcd", prefix, name);
+  if (capture_start (port, 0) != E1284_OK)
+    {
+      free (file);
+      return;
+    }
+
+  port->trace.capture->file = file;
+  debugprintf ("Capturing %s to %s\n", name, file);
+}
+
+void
+capture_cleanup (struct parport_internal *port)
+{
+  struct capture *cap = port->trace.capture;
+
+  if (cap)
+    capture_stop (port, cap->file);
+}
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
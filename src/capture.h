@@ -0,0 +1,55 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include "delay.h"
+#include "detect.h"
+
+/* Samples kept when no number is given. */
+#define CAPTURE_DEFAULT_SAMPLES (1 << 18)
+
+/* Start recording every change on the port's lines, up to SAMPLES
+ * of them. */
+extern int capture_start (struct parport_internal *port, size_t samples);
+
+/* Stop recording, and write what was recorded to FILENAME as a Value
+ * Change Dump unless FILENAME is NULL. */
+extern int capture_stop (struct parport_internal *port,
+			 const char *filename);
+
+/* Called by trace_point for each change.  POINT is TP_STATUS,
+ * TP_CONTROL, TP_DATA or TP_DIR. */
+extern void capture_sample (struct parport_internal *port, nsec_t time,
+			    int point, unsigned char value);
+
+/* Start a capture of the newly opened port NAME if LIBIEEE1284_CAPTURE
+ * is set, to be written out by capture_cleanup. */
+extern void capture_install (struct parport_internal *port,
+			     const char *name);
+extern void capture_cleanup (struct parport_internal *port);
+
+#endif /* _CAPTURE_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -21,13 +21,22 @@
 # include "config.h"
 #endif /* HAVE_CONFIG_H */
 
+#ifdef HAVE_SECURE_GETENV
+#define _GNU_SOURCE
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
 
 #include "conf.h"
 #include "debug.h"
 
+#define CONFENV "LIBIEEE1284_CONF"
+
 struct config_variables conf;
 
 static const char *const ieee1284conf = "ieee1284.conf";
@@ -35,13 +44,19 @@ static const size_t max_line_len = 1000;
 static const char *ifs = " \t\n";
 static const char *tokenchar = "{}=";
 
+/* Where get_token is in a configuration file. */
+struct tokenizer
+{
+  FILE *f;
+  char *current_line;
+  size_t current_line_len;
+  size_t at;
+};
+
 /* Get the next token.  Caller frees returned zero-terminated string. */
 static char *
-get_token (FILE *f)
+get_token (struct tokenizer *t)
 {
-  static char *current_line = NULL;
-  static size_t current_line_len = 0;
-  static size_t at = 0;
   size_t end, i;
   char *this_token;
 
@@ -49,52 +64,52 @@ get_token (FILE *f)
     {
       int quotes = 0;
 
-      if (at == current_line_len)
+      if (t->at == t->current_line_len)
 	{
-	  if (current_line)
-	    free (current_line);
+	  if (t->current_line)
+	    free (t->current_line);
 
-	  current_line = NULL;
-	  current_line_len = 0;
-	  at = 0;
+	  t->current_line = NULL;
+	  t->current_line_len = 0;
+	  t->at = 0;
 	}
 
-      if (!current_line)
+      if (!t->current_line)
 	{
-	  current_line = malloc (sizeof (char) * max_line_len);
-	  if (!current_line)
+	  t->current_line = malloc (sizeof (char) * max_line_len);
+	  if (!t->current_line)
 	    return NULL;
 
 	  /* Ideally we'd use getline here, but that isn't available
 	   * everywhere. In fact, *ideally* we'd use wordexp for this
 	   * whole function, but that isn't widely available either. */
-	  if (!fgets (current_line, max_line_len, f))
+	  if (!fgets (t->current_line, max_line_len, t->f))
 	    {
-	      free (current_line);
-	      current_line = NULL;
-	      current_line_len = 0;
-	      at = 0;
+	      free (t->current_line);
+	      t->current_line = NULL;
+	      t->current_line_len = 0;
+	      t->at = 0;
 	      return NULL;
 	    }
 
-	  current_line_len = strlen (current_line);
-	  at = 0;
+	  t->current_line_len = strlen (t->current_line);
+	  t->at = 0;
 	}
 
       /* Skip whitespace. */
-      at += strspn (current_line + at, ifs);
+      t->at += strspn (t->current_line + t->at, ifs);
 
-      if (current_line[at] == '#')
+      if (t->current_line[t->at] == '#')
 	{
 	  /* Ignore the rest of the line. */
-	  at = current_line_len;
+	  t->at = t->current_line_len;
 	  continue;
 	}
 
       /* Find the end of the token. */
-      for (end = at; end < current_line_len; end++)
+      for (end = t->at; end < t->current_line_len; end++)
 	{
-	  char ch = current_line[end];
+	  char ch = t->current_line[end];
 
 	  if (ch == '\\' && quotes != 1)
 	    {
@@ -131,31 +146,31 @@ get_token (FILE *f)
 
 	  if (!quotes && strchr (tokenchar, ch))
 	    {
-	      if (end == at)
+	      if (end == t->at)
 		end++;
 
 	      break;
 	    }
 	}
 
-      if (at == end)
+      if (t->at == end)
 	/* Next line. */
 	continue;
 
       /* Copy this token. */
-      this_token = malloc (sizeof (char) * (end - at + 1)); /* worst case */
+      this_token = malloc (sizeof (char) * (end - t->at + 1)); /* worst case */
       if (!this_token)
 	return NULL;
 
       quotes = 0;
-      for (i = 0; at < end; at++)
+      for (i = 0; t->at < end; t->at++)
 	{
-	  char ch = current_line[at];
+	  char ch = t->current_line[t->at];
 
 	  if (ch == '\\' && quotes != 1)
 	    {
-	      if (at < end - 1)
-		this_token[i++] = current_line[++at];
+	      if (t->at < end - 1)
+		this_token[i++] = t->current_line[++t->at];
 
 	      continue;
 	    }
@@ -201,11 +216,11 @@ get_token (FILE *f)
 }
 
 static char *
-disallow (FILE *f)
+disallow (struct tokenizer *t)
 {
   char *token = NULL;
 
-  token = get_token (f);
+  token = get_token (t);
   if (!token || strcmp (token, "method"))
     {
       debugprintf ("'disallow' requires 'method'\n");
@@ -213,7 +228,7 @@ disallow (FILE *f)
     }
 
   free (token);
-  token = get_token (f);
+  token = get_token (t);
   if (!token || strcmp (token, "ppdev"))
     {
       debugprintf ("'disallow method' requires a method name (e.g. ppdev)\n");
@@ -223,39 +238,373 @@ disallow (FILE *f)
   debugprintf ("* Disallowing method: ppdev\n");
   conf.disallow_ppdev = 1;
   free (token);
-  return get_token (f);
+  return get_token (t);
+}
+
+static char *
+io_pause (struct tokenizer *t)
+{
+  char *token = get_token (t);
+
+  if (token && (!strcmp (token, "on") || !strcmp (token, "off")))
+    {
+      conf.no_io_pause = !strcmp (token, "off");
+      debugprintf ("* Pause after register writes: %s\n", token);
+      free (token);
+      return get_token (t);
+    }
+
+  debugprintf ("'io-pause' requires 'on' or 'off'\n");
+  return token;
+}
+
+/* Read a non-negative number.  Returns zero on success, otherwise
+ * the offending token (if any) is left in *token for the caller. */
+static int
+get_number (struct tokenizer *t, double *val, char **token)
+{
+  char *end;
+
+  *token = get_token (t);
+  if (!*token)
+    return 1;
+
+  *val = strtod (*token, &end);
+  if (end == *token || *end || *val < 0)
+    {
+      debugprintf ("Expected a number, got '%s'\n", *token);
+      return 1;
+    }
+
+  free (*token);
+  *token = NULL;
+  return 0;
+}
+
+/* latency distribution: "fixed T", "uniform MIN MAX" or
+ * "exponential MIN MEAN", with times in microseconds. */
+static char *
+sim_latency (struct tokenizer *t, struct sim_latency *lat)
+{
+  enum sim_latency_kind kind;
+  char *token = get_token (t);
+  double min, max = 0;
+
+  if (!token)
+    return NULL;
+
+  if (!strcmp (token, "fixed"))
+    kind = SIM_LATENCY_FIXED;
+  else if (!strcmp (token, "uniform"))
+    kind = SIM_LATENCY_UNIFORM;
+  else if (!strcmp (token, "exponential"))
+    kind = SIM_LATENCY_EXPONENTIAL;
+  else
+    {
+      debugprintf ("Unknown latency distribution: %s\n", token);
+      return token;
+    }
+
+  free (token);
+  if (get_number (t, &min, &token))
+    return token;
+  if (kind != SIM_LATENCY_FIXED && get_number (t, &max, &token))
+    return token;
+
+  lat->kind = kind;
+  lat->min = (unsigned long) (min * 1000);
+  lat->max = (unsigned long) (max * 1000);
+  return get_token (t);
+}
+
+static char *
+sim_value (struct tokenizer *t, unsigned long *val, double scale)
+{
+  char *token;
+  double v;
+
+  if (get_number (t, &v, &token))
+    return token;
+
+  *val = (unsigned long) (v * scale);
+  return get_token (t);
+}
+
+/* simulate port NAME [{ settings }] */
+static char *
+simulate (struct tokenizer *t)
+{
+  struct sim_port_config *sim;
+  char *token = NULL;
+
+  token = get_token (t);
+  if (!token || strcmp (token, "port"))
+    {
+      debugprintf ("'simulate' requires 'port'\n");
+      return token;
+    }
+
+  free (token);
+  token = get_token (t);
+  if (!token || !strcmp (token, "{") || !strcmp (token, "}"))
+    {
+      debugprintf ("'simulate port' requires a port name\n");
+      return token;
+    }
+
+  sim = malloc (sizeof *sim);
+  if (!sim)
+    {
+      free (token);
+      return NULL;
+    }
+
+  sim->name = token;
+  sim->latency.kind = SIM_LATENCY_FIXED;
+  sim->latency.min = 1000;
+  sim->latency.max = 0;
+  sim->setup.kind = SIM_LATENCY_FIXED;
+  sim->setup.min = 5000;
+  sim->setup.max = 0;
+  sim->access_time = 1000;
+  sim->run_length = 1;
+  sim->reverse_bytes = 0;
+  sim->seed = 1;
+  sim->ecp_fifo = 0;
+  sim->pword = 1;
+  sim->epp_registers = 0;
+  sim->sink = NULL;
+  sim->base = 0;
+  sim->ecr_base = 0;
+  sim->next = conf.sim_ports;
+  conf.sim_ports = sim;
+  debugprintf ("* Simulating port: %s\n", sim->name);
+
+  token = get_token (t);
+  if (!token || strcmp (token, "{"))
+    return token;
+
+  free (token);
+  token = get_token (t);
+  while (token && strcmp (token, "}"))
+    {
+      char *next_token;
+      if (!strcmp (token, "latency"))
+	next_token = sim_latency (t, &sim->latency);
+      else if (!strcmp (token, "setup"))
+	next_token = sim_latency (t, &sim->setup);
+      else if (!strcmp (token, "access-time"))
+	next_token = sim_value (t, &sim->access_time, 1000);
+      else if (!strcmp (token, "run-length"))
+	next_token = sim_value (t, &sim->run_length, 1);
+      else if (!strcmp (token, "reverse-bytes"))
+	next_token = sim_value (t, &sim->reverse_bytes, 1);
+      else if (!strcmp (token, "seed"))
+	next_token = sim_value (t, &sim->seed, 1);
+      else if (!strcmp (token, "ecp-fifo"))
+	next_token = sim_value (t, &sim->ecp_fifo, 1);
+      else if (!strcmp (token, "pword"))
+	next_token = sim_value (t, &sim->pword, 1);
+      else if (!strcmp (token, "epp-registers"))
+	next_token = sim_value (t, &sim->epp_registers, 1);
+      else if (!strcmp (token, "base"))
+	next_token = sim_value (t, &sim->base, 1);
+      else if (!strcmp (token, "ecr-base"))
+	next_token = sim_value (t, &sim->ecr_base, 1);
+      else if (!strcmp (token, "sink"))
+	{
+	  free (sim->sink);
+	  sim->sink = get_token (t);
+	  next_token = sim->sink ? get_token (t) : NULL;
+	}
+      else
+	{
+	  debugprintf ("Skipping unknown simulation setting: %s\n", token);
+	  next_token = get_token (t);
+	}
+
+      free (token);
+      token = next_token;
+    }
+
+  if (!token)
+    {
+      debugprintf ("Missing '}' for simulated port %s\n", sim->name);
+      return NULL;
+    }
+
+  if (!sim->run_length)
+    sim->run_length = 1;
+  if (sim->ecp_fifo > 256)
+    sim->ecp_fifo = 256;
+  if (sim->pword != 2 && sim->pword != 4)
+    sim->pword = 1;
+
+  free (token);
+  return get_token (t);
+}
+
+char *
+conf_getenv (const char *name)
+{
+#if defined(HAVE_SECURE_GETENV)
+  return secure_getenv (name);
+#elif !defined(_MSC_VER)
+  if (getuid () != geteuid () || getgid () != getegid ())
+    return NULL;
+  return getenv (name);
+#else
+  return getenv (name);
+#endif
+}
+
+const struct sim_port_config *
+find_sim_port_config (const char *name)
+{
+  const struct sim_port_config *sim;
+  for (sim = conf.sim_ports; sim; sim = sim->next)
+    if (!strcmp (sim->name, name))
+      return sim;
+
+  return NULL;
+}
+
+/* realtime port NAME [{ settings }] */
+static char *
+realtime (struct tokenizer *t)
+{
+  struct rt_port_config *rt;
+  char *token = NULL;
+
+  token = get_token (t);
+  if (!token || strcmp (token, "port"))
+    {
+      debugprintf ("'realtime' requires 'port'\n");
+      return token;
+    }
+
+  free (token);
+  token = get_token (t);
+  if (!token || !strcmp (token, "{") || !strcmp (token, "}"))
+    {
+      debugprintf ("'realtime port' requires a port name\n");
+      return token;
+    }
+
+  rt = malloc (sizeof *rt);
+  if (!rt)
+    {
+      free (token);
+      return NULL;
+    }
+
+  rt->name = token;
+  rt->priority = 1;
+  rt->cpu = -1;
+  rt->next = conf.rt_ports;
+  conf.rt_ports = rt;
+  debugprintf ("* Real time port: %s\n", rt->name);
+
+  token = get_token (t);
+  if (!token || strcmp (token, "{"))
+    return token;
+
+  free (token);
+  token = get_token (t);
+  while (token && strcmp (token, "}"))
+    {
+      unsigned long val;
+      char *next_token;
+      if (!strcmp (token, "priority"))
+	{
+	  val = (unsigned long) rt->priority;
+	  next_token = sim_value (t, &val, 1);
+	  rt->priority = (int) val;
+	}
+      else if (!strcmp (token, "cpu"))
+	{
+	  val = (unsigned long) rt->cpu;
+	  next_token = sim_value (t, &val, 1);
+	  rt->cpu = (int) val;
+	}
+      else
+	{
+	  debugprintf ("Skipping unknown real time setting: %s\n", token);
+	  next_token = get_token (t);
+	}
+
+      free (token);
+      token = next_token;
+    }
+
+  if (!token)
+    {
+      debugprintf ("Missing '}' for real time port %s\n", rt->name);
+      return NULL;
+    }
+
+  free (token);
+  return get_token (t);
+}
+
+const struct rt_port_config *
+find_rt_port_config (const char *name)
+{
+  const struct rt_port_config *rt;
+  for (rt = conf.rt_ports; rt; rt = rt->next)
+    if (!strcmp (rt->name, name))
+      return rt;
+
+  return NULL;
 }
 
 static int
 try_read_config_file (const char *path)
 {
-  FILE *f = fopen (path, "r");
+  struct tokenizer t;
   char *token;
 
-  if (!f)
+  t.f = fopen (path, "r");
+  if (!t.f)
     return 1;
 
+  t.current_line = NULL;
+  t.current_line_len = t.at = 0;
+
   debugprintf ("Reading configuration from %s:\n", path);
 
-  token = get_token (f);
+  token = get_token (&t);
   while (token)
     {
       char *next_token;
       if (!strcmp (token, "disallow"))
 	{
-	  next_token = disallow (f);
+	  next_token = disallow (&t);
+	}
+      else if (!strcmp (token, "io-pause"))
+	{
+	  next_token = io_pause (&t);
+	}
+      else if (!strcmp (token, "simulate"))
+	{
+	  next_token = simulate (&t);
+	}
+      else if (!strcmp (token, "realtime"))
+	{
+	  next_token = realtime (&t);
 	}
       else
 	{
 	  debugprintf ("Skipping unknown word: %s\n", token);
-	  next_token = get_token (f);
+	  next_token = get_token (&t);
 	}
 
       free (token);
       token = next_token;
     }
 
-  fclose (f);
+  free (t.current_line);
+  fclose (t.f);
   debugprintf ("End of configuration\n");
   return 0;
 }
@@ -271,6 +620,19 @@ read_config_file (void)
     return;
 
   conf.disallow_ppdev = 0;
+  conf.no_io_pause = 0;
+  conf.sim_ports = NULL;
+  conf.rt_ports = NULL;
+  config_read = 1;
+
+  /* The environment may point us at a different file, for instance
+   * one describing simulated ports on a machine with no hardware. */
+  path = conf_getenv (CONFENV);
+  if (path)
+    {
+      try_read_config_file (path);
+      return;
+    }
 
   rclen = strlen (ieee1284conf);
   path = malloc (1 + 5 + rclen);
@@ -279,9 +641,7 @@ read_config_file (void)
 
   memcpy (path, "/etc/", 5);
   memcpy (path + 5, ieee1284conf, rclen + 1);
-  if (try_read_config_file (path))
-    config_read = 1;
-
+  try_read_config_file (path);
   free (path);
   return;
 }
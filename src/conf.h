@@ -22,11 +22,68 @@
 
 void read_config_file (void);
 
+/* Response latency distributions for simulated peripherals.  All
+ * times are in nanoseconds of simulated time. */
+enum sim_latency_kind
+{
+  SIM_LATENCY_FIXED,		/* always min */
+  SIM_LATENCY_UNIFORM,		/* uniform between min and max */
+  SIM_LATENCY_EXPONENTIAL	/* min plus exponential with mean max */
+};
+
+struct sim_latency
+{
+  enum sim_latency_kind kind;
+  unsigned long min;
+  unsigned long max;
+};
+
+/* A simulated port, from a "simulate port" configuration block. */
+struct sim_port_config
+{
+  char *name;
+  struct sim_latency latency;	/* handshake responses */
+  struct sim_latency setup;	/* negotiation, termination, turnaround */
+  unsigned long access_time;	/* cost of each register access */
+  unsigned long run_length;	/* length of runs in reverse data */
+  unsigned long reverse_bytes;	/* reverse data available, 0 = endless */
+  unsigned long seed;
+  unsigned long ecp_fifo;	/* ECP FIFO depth in PWords, 0 = no ECR */
+  unsigned long pword;		/* bytes per ECP FIFO entry */
+  unsigned long epp_registers;	/* EPP cycles run by the port */
+  char *sink;			/* file for the forward data, or NULL */
+  unsigned long base;		/* register addresses */
+  unsigned long ecr_base;	/* 0 = base + 0x400 */
+  struct sim_port_config *next;
+};
+
+/* A port to run in real time while claimed, from a "realtime port"
+ * configuration block. */
+struct rt_port_config
+{
+  char *name;
+  int priority;			/* SCHED_FIFO priority */
+  int cpu;			/* CPU to run on, or -1 for any */
+  struct rt_port_config *next;
+};
+
 extern struct config_variables
 {
   int disallow_ppdev;
+  int no_io_pause;
+  struct sim_port_config *sim_ports;
+  struct rt_port_config *rt_ports;
 } conf;
 
+/* getenv, for variables naming files: in a setuid or setgid
+ * process, or one that gained capabilities on exec, these are
+ * ignored, since whoever set them could have the library write
+ * anywhere. */
+extern char *conf_getenv (const char *name);
+
+extern const struct sim_port_config *find_sim_port_config (const char *name);
+extern const struct rt_port_config *find_rt_port_config (const char *name);
+
 #endif /* _CONF_H_ */
 
 /*
@@ -35,115 +35,62 @@
 #include "debug.h"
 #include "detect.h"
 #include "ieee1284.h"
+#include "thread.h"
 
 #define ENVAR "LIBIEEE1284_DEBUG"
-static int debugging_enabled = -1;
+static int debugging_enabled;
+static thread_once_t debug_once = THREAD_ONCE_INIT;
 
-static unsigned char soft_ctr = 0xff;
-
-static const char *
-timeofday (void)
+const char *
+debug_timeofday (char *buf)
 {
-  static char str[100];
-  struct timeval tod;
+  buf[0] = '\0';
 #if !(defined __MINGW32__ || defined _MSC_VER)
-  if (gettimeofday (&tod, NULL))
-    {
-      str[0] = '\0';
-    }
-  else
-#endif
-    {
-      struct tm *tm = localtime (&tod.tv_sec);
-      char *p = str + strftime (str, 50, "%H:%M:%S.", tm);
-      sprintf (p, "%06ld", tod.tv_usec);
-    }
-  return str;
-}
-
-unsigned char
-debug_display_status (unsigned char st)
-{
-  static unsigned char last_status = 0xff;
-
-  if (!debugging_enabled)
-    goto out;
-
-  if (last_status == st)
-    goto out;
-
-  last_status = st;
-  debugprintf ("%s STATUS: %cnFault %cSelect %cPError %cnAck %cBusy\n",
-	   timeofday (),
-	   st & S1284_NFAULT ? ' ' : '!',
-	   st & S1284_SELECT ? ' ' : '!',
-	   st & S1284_PERROR ? ' ' : '!',
-	   st & S1284_NACK ? ' ' : '!',
-	   st & S1284_BUSY ? ' ' : '!');
+  {
+    struct timeval tod;
+    struct tm tm;
 
- out:
-  return st;
+    if (!gettimeofday (&tod, NULL) && localtime_r (&tod.tv_sec, &tm))
+      {
+	char *p = buf + strftime (buf, DEBUG_TIMEOFDAY_MAX, "%H:%M:%S.", &tm);
+	sprintf (p, "%06ld", (long) tod.tv_usec);
+      }
+  }
+#endif
+  return buf;
 }
 
-unsigned char
-debug_display_control (unsigned char ct)
+static void
+debug_init (void)
 {
-  if (!debugging_enabled)
-    goto out;
+  int dummy;
+  (void) dummy; /* warning remover for MinGW and VC++ */
 
-  if (soft_ctr == ct)
-    goto out;
+  if (!getenv (ENVAR))
+    return;
 
-  soft_ctr = ct;
-  debugprintf ("%s CONTROL: %cnStrobe %cnAutoFd %cnInit %cnSelectIn\n",
-	   timeofday (),
-	   ct & C1284_NSTROBE ? ' ' : '!',
-	   ct & C1284_NAUTOFD ? ' ' : '!',
-	   ct & C1284_NINIT ? ' ' : '!',
-	   ct & C1284_NSELECTIN ? ' ' : '!');
+#if !(defined __MINGW32__ || defined _MSC_VER)
+  /* Is stderr open? */
+  if (fcntl (fileno (stderr), F_GETFL, &dummy) == -1 && errno == EBADF)
+    return;
+#endif
 
- out:
-  return ct;
+  debugging_enabled = 1;
 }
 
-void
-debug_frob_control (unsigned char mask, unsigned char val)
+int
+debug_enabled (void)
 {
-  if (debugging_enabled)
-    {
-      unsigned char new_ctr = (soft_ctr & ~mask) ^ val;
-      debug_display_control (new_ctr);
-    }
+  thread_once (&debug_once, debug_init);
+  return debugging_enabled;
 }
 
 void
 debugprintf (const char *fmt, ...)
 {
-  if (!debugging_enabled)
+  if (!debug_enabled ())
     return;
 
-  if (debugging_enabled == -1) {
-    int dummy;
-    (void) dummy; /* warning remover for MinGW and VC++ */
-
-    if (!getenv (ENVAR))
-      {
-	debugging_enabled = 0;
-	return;
-      }
-
-#if !(defined __MINGW32__ || defined _MSC_VER)
-    /* Is stderr open? */
-    if (fcntl (fileno (stderr), F_GETFL, &dummy) == -1 && errno == EBADF)
-      {
-	debugging_enabled = 0;
-	return;
-      }
-#endif
-
-    debugging_enabled = 1;
-  }
-  
   {
     va_list ap;
     va_start (ap, fmt);
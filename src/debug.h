@@ -30,9 +30,12 @@
 
 struct parport_internal;
 extern void debugprintf (const char *fmt, ...) FORMAT ((__printf__, 1, 2));
-extern unsigned char debug_display_status (unsigned char st);
-extern unsigned char debug_display_control (unsigned char ct);
-extern void debug_frob_control (unsigned char mask, unsigned char val);
+extern int debug_enabled (void);
+
+/* Write the time of day into BUF, which must have room for
+ * DEBUG_TIMEOFDAY_MAX bytes, and return it. */
+#define DEBUG_TIMEOFDAY_MAX 32
+extern const char *debug_timeofday (char *buf);
 
 #endif /* _DEBUG_H_ */
 
@@ -22,6 +22,9 @@
 extern int default_wait_data (struct parport_internal *port,
 			      unsigned char mask, unsigned char val,
 			      struct timeval *timeout);
+extern int default_wait_status (struct parport_internal *port,
+				unsigned char mask, unsigned char val,
+				struct timeval *timeout);
 extern int default_do_nack_handshake (struct parport_internal *port,
 				      unsigned char ct_before,
 				      unsigned char ct_after,
@@ -56,6 +59,9 @@ extern ssize_t default_ecp_read_addr (struct parport_internal *port,
 extern ssize_t default_ecp_write_addr (struct parport_internal *port,
 				       int flags, const char *buffer,
 				       size_t len);
+extern ssize_t default_pin_program (struct parport_internal *port,
+				    const struct ieee1284_pin_op *ops,
+				    size_t nops, unsigned char *out);
 extern struct timeval *default_set_timeout (struct parport_internal *port,
 					    struct timeval *timeout);
 
@@ -17,6 +17,8 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include "config.h"
+
 #ifndef _MSC_VER
 #include <sys/time.h>
 #endif
@@ -26,38 +28,167 @@
 #if defined __MINGW32__ || defined _MSC_VER
 #include <sys/timeb.h>
 #endif
+#include <stdlib.h>
+#include <time.h>
+#if !(defined __MINGW32__ || defined _MSC_VER)
+#include <sched.h>
+#endif
 
+#include "debug.h"
 #include "delay.h"
+#include "thread.h"
 
-void udelay(unsigned long usec)
+#define CALIBRATION_READS 100
+#define CALIBRATION_SLEEPS 5
+
+#if defined CLOCK_MONOTONIC && !(defined __MINGW32__ || defined _MSC_VER)
+#define HAVE_MONOTONIC
+static clockid_t clock_id = CLOCK_MONOTONIC;
+#endif
+
+/* How much longer than requested a short sleep takes, and the delay
+ * above which it is worth sleeping at all.  These are conservative
+ * until delay_calibrate measures them. */
+static nsec_t sleep_slack = 100000;
+static nsec_t spin_limit = 100000 + SPIN_THRESHOLD_NS;
+
+nsec_t monotonic_ns(void)
 {
-#if !(defined __MINGW32__ || defined _MSC_VER)
-	struct timeval now, deadline;
-	
-	gettimeofday(&deadline, NULL);
-	deadline.tv_usec += usec;
-	deadline.tv_sec += deadline.tv_usec / 1000000;
-	deadline.tv_usec %= 1000000;
-	
-	do {
-		gettimeofday(&now, NULL);
-	} while ((now.tv_sec < deadline.tv_sec) || 
-		(now.tv_sec == deadline.tv_sec &&
-		now.tv_usec < deadline.tv_usec));
-#else
+#if defined __MINGW32__ || defined _MSC_VER
 	/* MinGW has no gettimeofday(). ftime() seems to be the best alternative as I
 	 * don't know of any standard Windows function with microsecond accuracy. I
 	 * should have a look at the Cygwin source code... - dbjh */
 	struct timeb tb;
-	long int now, deadline;
-	
+
 	ftime(&tb);
-	deadline = tb.time * 1000 + tb.millitm + usec / 1000;
+	return (nsec_t) tb.time * 1000000000 + (nsec_t) tb.millitm * 1000000;
+#elif defined HAVE_MONOTONIC
+	struct timespec ts;
+
+	clock_gettime(clock_id, &ts);
+	return (nsec_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (nsec_t) tv.tv_sec * 1000000000 + (nsec_t) tv.tv_usec * 1000;
+#endif
+}
+
+nsec_t timeout_deadline(const struct timeval *timeout)
+{
+	return monotonic_ns() + (nsec_t) timeout->tv_sec * 1000000000 +
+		(nsec_t) timeout->tv_usec * 1000;
+}
+
+void nsleep(nsec_t ns)
+{
+#if defined __MINGW32__ || defined _MSC_VER
+	nsec_t deadline = monotonic_ns() + ns;
+
+	while (monotonic_ns() < deadline)
+		;
+#else
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000;
+	ts.tv_nsec = ns % 1000000000;
+	nanosleep(&ts, NULL);
+#endif
+}
+
+void udelay(unsigned long usec)
+{
+	nsec_t now = monotonic_ns();
+	nsec_t deadline = now + (nsec_t) usec * 1000;
+
+	/* Sleep through the bulk of a long delay, waking early enough
+	 * to absorb the scheduler's lateness, then spin the rest. */
+	if (deadline - now > spin_limit)
+		nsleep(deadline - now - sleep_slack);
+
+	while (monotonic_ns() < deadline)
+		;
+}
+
+void usleep_poll(unsigned long usec)
+{
+	nsleep((nsec_t) usec * 1000);
+}
 
-	do {
-		ftime(&tb);
-		now = tb.time * 1000 + tb.millitm;
-	} while (now < deadline);
+void cpu_yield(void)
+{
+#if !(defined __MINGW32__ || defined _MSC_VER)
+	sched_yield();
 #endif
 }
 
+static int compare_nsec(const void *a, const void *b)
+{
+	nsec_t x = *(const nsec_t *) a, y = *(const nsec_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+#ifdef HAVE_MONOTONIC
+/* Time reads of clock ID with that clock, leaving clock_id alone:
+ * other threads may be using it. */
+static nsec_t clock_cost(clockid_t id)
+{
+	struct timespec start, ts;
+	int i;
+
+	clock_gettime(id, &start);
+	for (i = 0; i < CALIBRATION_READS; i++)
+		clock_gettime(id, &ts);
+	return ((nsec_t) (ts.tv_sec - start.tv_sec) * 1000000000 +
+		ts.tv_nsec - start.tv_nsec) / CALIBRATION_READS;
+}
+#endif
+
+static thread_once_t calibrate_once = THREAD_ONCE_INIT;
+
+static void calibrate(void)
+{
+	nsec_t slack[CALIBRATION_SLEEPS];
+	nsec_t cost = 0;
+	int i;
+
+#ifdef HAVE_MONOTONIC
+	cost = clock_cost(CLOCK_MONOTONIC);
+#ifdef CLOCK_MONOTONIC_RAW
+	{
+		/* The raw clock isn't slewed by NTP, but is only worth
+		 * having if reading it doesn't need a system call.  No
+		 * port is open yet, so nothing is timing with the
+		 * clock being changed. */
+		struct timespec ts;
+		if (!clock_gettime(CLOCK_MONOTONIC_RAW, &ts)) {
+			nsec_t raw = clock_cost(CLOCK_MONOTONIC_RAW);
+			if (raw <= 2 * cost) {
+				cost = raw;
+				clock_id = CLOCK_MONOTONIC_RAW;
+			}
+		}
+	}
+#endif
+#endif
+
+	for (i = 0; i < CALIBRATION_SLEEPS; i++) {
+		nsec_t start = monotonic_ns();
+		nsleep(1000);
+		slack[i] = monotonic_ns() - start - 1000;
+	}
+	qsort(slack, CALIBRATION_SLEEPS, sizeof (nsec_t), compare_nsec);
+	sleep_slack = slack[CALIBRATION_SLEEPS / 2];
+	if (sleep_slack < 0)
+		sleep_slack = 0;
+	spin_limit = sleep_slack + SPIN_THRESHOLD_NS;
+
+	debugprintf("Timing: clock read %ld ns, sleep slack %ld ns\n",
+		    (long) cost, (long) sleep_slack);
+}
+
+void delay_calibrate(void)
+{
+	thread_once(&calibrate_once, calibrate);
+}
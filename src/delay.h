@@ -20,6 +20,9 @@
 #ifndef _DELAY_H_
 #define _DELAY_H_
 
+/* Delays shorter than this are always busy-waited. */
+#define SPIN_THRESHOLD_NS 10000
+
 enum Delays {
   IO_POLL_DELAY = 0,
   TIMEVAL_SIGNAL_TIMEOUT = 1,
@@ -34,8 +37,32 @@ static const long delay_table[] = {
 #define lookup_delay(which, tv) ((tv)->tv_sec = 0, \
 	(tv)->tv_usec = delay_table[which])
 
+/* Nanoseconds on a monotonic clock. */
+#ifdef _MSC_VER
+typedef __int64 nsec_t;
+#else
+typedef long long nsec_t;
+#endif
+
+struct timeval;
+
+nsec_t monotonic_ns(void);
+nsec_t timeout_deadline(const struct timeval *timeout);
+#define deadline_passed(deadline) (monotonic_ns() >= (deadline))
+
+/* Busy-wait short delays; sleep for most of longer ones. */
 void udelay(unsigned long usec);
 
+/* Give up the CPU for about usec microseconds. */
+void usleep_poll(unsigned long usec);
+void nsleep(nsec_t ns);
+
+/* Let another runnable thread have the CPU. */
+void cpu_yield(void);
+
+/* Measure the clock and the scheduler.  Called from ieee1284_open. */
+void delay_calibrate(void);
+
 #endif /* _DELAY_H_ */
 
 /*
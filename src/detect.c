@@ -35,6 +35,7 @@
 #include <unistd.h>
 #endif
 
+#include "conf.h"
 #include "debug.h"
 #include "detect.h"
 
@@ -256,6 +257,8 @@ detect_environment (int forbidden)
     check_dev_port ();
   if (!FORBIDDEN (LPT_CAPABLE))
     check_lpt ();
+  if (!FORBIDDEN (SIM_CAPABLE) && conf.sim_ports)
+    capabilities |= SIM_CAPABLE;
 
   /* Find out what kind of /proc structure we have. */
   if (!dev_node_parport) /* Don't load lp if we'll use ppdev (claim will fail if F1284_EXCL). */
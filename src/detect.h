@@ -24,10 +24,14 @@
 #ifndef _DETECT_H_
 #define _DETECT_H_
 
+#include "delay.h"
 #include "ieee1284.h"
 
 struct parport;
 struct parport_internal;
+struct rt_state;
+struct async_state;
+struct ready_state;
 
 struct parport_access_methods
 {
@@ -41,6 +45,15 @@ struct parport_access_methods
   void (*do_outb) (struct parport_internal *port, unsigned char val,
 		unsigned long addr);
 
+  /* Wider access, for FIFOs and EPP.  These may be NULL. */
+  unsigned short (*do_inw) (struct parport_internal *port,
+			    unsigned long addr);
+  void (*do_outw) (struct parport_internal *port, unsigned short val,
+		   unsigned long addr);
+  unsigned int (*do_inl) (struct parport_internal *port, unsigned long addr);
+  void (*do_outl) (struct parport_internal *port, unsigned int val,
+		   unsigned long addr);
+
   int (*get_irq_fd) (struct parport_internal *port);
   int (*clear_irq) (struct parport_internal *port, unsigned int *count);
 
@@ -96,6 +109,9 @@ struct parport_access_methods
 			     const char *buffer, size_t len);
   struct timeval *(*set_timeout) (struct parport_internal *port,
 				  struct timeval *timeout);
+  ssize_t (*pin_program) (struct parport_internal *port,
+			  const struct ieee1284_pin_op *ops, size_t nops,
+			  unsigned char *out);
 };
 
 enum ieee1284_phase {
@@ -113,8 +129,90 @@ enum ieee1284_phase {
   PH1284_ECP_DIR_UNKNOWN,
 };
 
+/* How quickly the peripheral usually responds, for the poll engine. */
+struct poll_profile
+{
+  long typical;			/* Moving average response time, in ns */
+  unsigned long responses;
+  unsigned long timeouts;
+};
+
+/* The last values written to the data and control lines, so that
+ * writes which change nothing can be skipped.  See shadow.c. */
+struct shadow_regs
+{
+  int valid;			/* SHADOW_DATA, SHADOW_CTR, SHADOW_DIR */
+  unsigned char data;
+  unsigned char ctr;
+  int reverse;
+  unsigned long skipped;
+
+  /* The port's own methods, underneath. */
+  void (*write_data) (struct parport_internal *port, unsigned char st);
+  int (*data_dir) (struct parport_internal *port, int reverse);
+  void (*write_control) (struct parport_internal *port, unsigned char ct);
+  void (*frob_control) (struct parport_internal *port,
+			unsigned char mask, unsigned char val);
+};
+
+/* Counters for ieee1284_get_stats.  See stats.c. */
+struct port_stats
+{
+  struct ieee1284_stats c;	/* All but the times, as reported */
+  nsec_t poll_ns;		/* Time spent waiting, awake */
+  nsec_t sleep_ns;		/* Time spent waiting, asleep */
+  int event;			/* Event the next wait is for, or -1 */
+  int partial;			/* A timeout isn't the end of the wait */
+  struct ieee1284_latency *latency[IEEE1284_EVENTS + 1]; /* -1 is last */
+
+  /* The port's own methods, underneath. */
+  int (*negotiate) (struct parport_internal *port, int mode);
+  void (*terminate) (struct parport_internal *port);
+  int (*ecp_fwd_to_rev) (struct parport_internal *port);
+  int (*ecp_rev_to_fwd) (struct parport_internal *port);
+};
+
+/* Trace points.  See trace.c. */
+struct trace_ring;
+struct capture;
+struct trace_state
+{
+  int on;			/* Whether trace points record anything */
+  struct trace_ring *ring;	/* or NULL */
+  struct capture *capture;	/* or NULL; see capture.c */
+
+  /* The lines as last recorded, or -1 if not known. */
+  int status;
+  int control;
+  int data;
+  int reverse;
+};
+
+/* The extended control register and FIFO of an ECP port, where
+ * there is one.  See ecr.c. */
+struct ecr_state
+{
+  unsigned int fifo_depth;	/* in PWords, or 0 if there is no ECR */
+  unsigned int pword;		/* bytes per FIFO entry */
+  unsigned int write_threshold;	/* free entries when serviceIntr is set */
+  unsigned int read_threshold;	/* full entries when serviceIntr is set */
+
+  /* Bytes read from the FIFO beyond what the caller asked for. */
+  unsigned char *spill;
+  size_t spill_size;
+  size_t spilled;
+  size_t spill_at;
+};
+
+/* Hardware the io backend still has to look for at the first
+ * claim. */
+#define HW_PROBE_PENDING	(1<<0)
+#define HW_PROBE_EPP		(1<<1)
+#define HW_PROBE_NOPAUSE	(1<<2)	/* F1284_NOPAUSE self-test */
+
 struct parport_internal
 {
+  const char *name;		/* The port's name, for the probes */
   int type;
   char *device;
   char *udevice;
@@ -124,6 +222,7 @@ struct parport_internal
   int fd;
   int opened;
   int claimed;
+  int hw_probe;			/* HW_PROBE_* flags, for access_io.c */
   unsigned char ctr;
 
   /* IEEE 1284 stuff */
@@ -135,6 +234,15 @@ struct parport_internal
   /* Reference count */
   int ref;
 
+  struct poll_profile poll;
+  struct shadow_regs shadow;
+  struct ecr_state ecr;
+  struct port_stats stats;
+  struct trace_state trace;
+  struct rt_state *rt;		/* See rt.c, or NULL */
+  struct async_state *async;	/* See async.c, or NULL */
+  struct ready_state *ready;	/* See ready.c, or NULL */
+
   struct parport_access_methods *fn;
   void *access_priv; /* For the access methods to use. */
 };
@@ -146,6 +254,7 @@ struct parport_internal
 #define DEV_LP_CAPABLE			(1<<4)
 #define DEV_PORT_CAPABLE		(1<<5)
 #define LPT_CAPABLE			(1<<6)
+#define SIM_CAPABLE			(1<<7)
 extern int capabilities;
 
 extern int detect_environment (int forbidden);
@@ -0,0 +1,604 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Hardware-assisted ECP, for ports with an extended control register.
+ * In ECP mode the port does the handshaking itself: we keep its FIFO
+ * topped up going forward, and drain it going in reverse, which is
+ * also where the hardware expands run-length encoded data.  Everything
+ * else (negotiation, termination, bus reversal) is done in PS2 mode
+ * by the software engines, so the ECR is left in PS2 mode between
+ * transfers.
+ *
+ * Probing follows the Linux parport_pc driver.  All register access
+ * goes through do_inb and do_outb, so the simulator can stand in for
+ * real hardware.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifndef _MSC_VER
+#include <sys/time.h>
+#endif
+#include <sys/types.h>
+
+#include "access.h"
+#include "debug.h"
+#include "delay.h"
+#include "detect.h"
+#include "ecr.h"
+#include "ieee1284.h"
+#include "shadow.h"
+#include "stats.h"
+#include "trace.h"
+
+/* How long to spin on the ECR before sleeping between reads. */
+#define ECR_SPIN_NS 20000
+#define ECR_NAP_MIN_NS 10000
+#define ECR_NAP_MAX_NS 1000000
+
+/* ECP mode with serviceIntr armed. */
+#define ECR_ARMED (ECR_MODE (ECR_ECP) | ECR_NERRINTREN)
+
+static unsigned char
+ecr_read (struct parport_internal *port)
+{
+  return port->fn->do_inb (port, ECR_ECR (port));
+}
+
+static void
+ecr_write (struct parport_internal *port, unsigned char ecr)
+{
+  port->fn->do_outb (port, ecr, ECR_ECR (port));
+}
+
+/* Poll the ECR until (ECR & mask) == val.  Returns the ECR, or -1 if
+ * the deadline passes first. */
+static int
+ecr_wait (struct parport_internal *port, unsigned char mask,
+	  unsigned char val, nsec_t deadline)
+{
+  nsec_t start = monotonic_ns ();
+
+  for (;;)
+    {
+      unsigned char ecr = ecr_read (port);
+      nsec_t now, nap;
+
+      if ((ecr & mask) == val)
+	return ecr;
+
+      now = monotonic_ns ();
+      if (now >= deadline)
+	return -1;
+
+      if (now - start < ECR_SPIN_NS)
+	continue;
+
+      nap = (now - start) / 4;
+      if (nap < ECR_NAP_MIN_NS)
+	nap = ECR_NAP_MIN_NS;
+      if (nap > ECR_NAP_MAX_NS)
+	nap = ECR_NAP_MAX_NS;
+      if (nap > deadline - now)
+	nap = deadline - now;
+      nsleep (nap);
+    }
+}
+
+static nsec_t
+signal_deadline (void)
+{
+  struct timeval tv;
+  lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+  return timeout_deadline (&tv);
+}
+
+/* Write up to ENTRIES FIFO entries from BUF, a PWord at a time where
+ * the backend can.  Returns the number of bytes written. */
+static size_t
+fifo_put (struct parport_internal *port, unsigned long fifo,
+	  unsigned int pword, const unsigned char *buf, size_t len,
+	  size_t entries)
+{
+  size_t done = 0;
+
+  while (entries-- && done < len)
+    {
+      const unsigned char *p = buf + done;
+      if (pword == 4 && len - done >= 4)
+	{
+	  port->fn->do_outl (port, (unsigned int) p[0] | (unsigned int) p[1] << 8
+			| (unsigned int) p[2] << 16
+			| (unsigned int) p[3] << 24, fifo);
+	  done += 4;
+	}
+      else if (pword == 2 && len - done >= 2)
+	{
+	  port->fn->do_outw (port, (unsigned short) (p[0] | p[1] << 8), fifo);
+	  done += 2;
+	}
+      else
+	{
+	  port->fn->do_outb (port, *p, fifo);
+	  done++;
+	}
+    }
+
+  return done;
+}
+
+/* Read up to LEN bytes from the FIFO into BUF, or into the spill
+ * buffer once BUF is full.  Reverse transfers always use byte
+ * access.  Returns the number of bytes stored in BUF. */
+static size_t
+fifo_get (struct parport_internal *port, unsigned char *buf, size_t len,
+	  size_t entries)
+{
+  struct ecr_state *ecr = &port->ecr;
+  size_t done = 0;
+
+  while (entries--)
+    {
+      unsigned char byte = port->fn->do_inb (port, ECR_DFIFO (port));
+      if (done < len)
+	buf[done++] = byte;
+      else if (ecr->spilled < ecr->spill_size)
+	ecr->spill[ecr->spilled++] = byte;
+    }
+
+  return done;
+}
+
+/* How many bytes were left behind in a stalled forward FIFO.  This
+ * resets the FIFO. */
+static size_t
+fifo_residue (struct parport_internal *port)
+{
+  const struct ecr_state *ecr = &port->ecr;
+  unsigned int residue;
+  unsigned char cnfga;
+
+  /* Count the free entries by filling them. */
+  for (residue = ecr->fifo_depth; residue; residue--)
+    {
+      if (ecr_read (port) & ECR_F_FULL)
+	break;
+      port->fn->do_outb (port, 0, ECR_DFIFO (port));
+    }
+
+  ecr_write (port, ECR_IDLE);
+  ecr_write (port, ECR_MODE (ECR_CNF) | ECR_NERRINTREN | ECR_SERVICEINTR);
+  cnfga = port->fn->do_inb (port, ECR_CNFGA (port));
+  ecr_write (port, ECR_IDLE);
+
+  TRACE_NOTE (port, "%lu PWords left in FIFO", residue);
+  residue *= ecr->pword;
+  if (!(cnfga & (1<<2)))
+    /* One more on its way to the peripheral. */
+    residue++;
+
+  return residue;
+}
+
+static ssize_t
+ecr_ecp_write (struct parport_internal *port, unsigned long fifo,
+	       unsigned int pword, const char *buffer, size_t len)
+{
+  const struct ecr_state *ecr = &port->ecr;
+  const unsigned char *buf = (const unsigned char *) buffer;
+  size_t left = len;
+  nsec_t deadline;
+  struct timeval tv;
+  int r;
+
+  if (port->current_phase != PH1284_FWD_IDLE)
+    if (port->fn->ecp_rev_to_fwd (port))
+      return 0;
+
+  port->current_phase = PH1284_FWD_DATA;
+
+  /* The FIFO drives nStrobe and nAutoFd while it runs.  Leave them
+   * high for when it stops. */
+  port->fn->frob_control (port, C1284_NSTROBE | C1284_NAUTOFD | C1284_NINIT,
+			  C1284_NSTROBE | C1284_NAUTOFD | C1284_NINIT);
+  ecr_write (port, ECR_ARMED);
+
+  deadline = signal_deadline ();
+  while (left)
+    {
+      size_t entries, n;
+
+      r = ecr_read (port);
+      if (r & ECR_F_FULL)
+	{
+	  r = ecr_wait (port, ECR_F_FULL, 0, deadline);
+	  if (r < 0)
+	    {
+	      TRACE_NOTE (port, "ECP FIFO write timed out", 0);
+	      break;
+	    }
+	}
+
+      if (r & ECR_F_EMPTY)
+	/* Fill it. */
+	entries = ecr->fifo_depth;
+      else if ((r & ECR_SERVICEINTR) && ecr->write_threshold)
+	{
+	  /* At least this much room.  Rearm for next time. */
+	  entries = ecr->write_threshold;
+	  ecr_write (port, ECR_ARMED);
+	}
+      else
+	entries = 1;
+
+      n = fifo_put (port, fifo, pword, buf, left, entries);
+      buf += n;
+      left -= n;
+      deadline = signal_deadline ();
+    }
+
+  /* Let the FIFO drain, and the peripheral take the last byte. */
+  if (ecr_wait (port, ECR_F_EMPTY, ECR_F_EMPTY, deadline) < 0)
+    {
+      TRACE_NOTE (port, "ECP FIFO didn't empty", 0);
+      left += fifo_residue (port);
+    }
+  else
+    {
+      lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+      if (port->fn->wait_status (port, S1284_BUSY, 0, &tv) && left < len)
+	left++;
+    }
+
+  ecr_write (port, ECR_IDLE);
+  port->current_phase = PH1284_FWD_IDLE;
+
+  /* The FIFO has been driving the data lines. */
+  shadow_invalidate (port);
+
+  return len - left;
+}
+
+static ssize_t
+ecr_ecp_write_data (struct parport_internal *port, int flags,
+		    const char *buffer, size_t len)
+{
+  ssize_t ret;
+
+  TRACE_ENTER (port, "ecr", SC1284_ECP_WRITE_DATA);
+  ret = ecr_ecp_write (port, ECR_DFIFO (port), port->ecr.pword, buffer, len);
+  TRACE_LEAVE (port, "ecr", SC1284_ECP_WRITE_DATA, ret);
+  return ret;
+}
+
+static ssize_t
+ecr_ecp_write_addr (struct parport_internal *port, int flags,
+		    const char *buffer, size_t len)
+{
+  ssize_t ret;
+
+  TRACE_ENTER (port, "ecr", SC1284_ECP_WRITE_ADDR);
+  ret = ecr_ecp_write (port, ECR_AFIFO (port), 1, buffer, len);
+  TRACE_LEAVE (port, "ecr", SC1284_ECP_WRITE_ADDR, ret);
+  return ret;
+}
+
+/* Stop a reverse transfer by turning the bus around, keeping any
+ * data that was already on its way.  That includes the rest of a run
+ * the port is still expanding into the FIFO. */
+static void
+ecr_stop_reverse (struct parport_internal *port)
+{
+  struct timeval tv;
+  unsigned int i;
+  int ret;
+
+  /* Event 47: nInit high.  The peripheral finishes the byte it is
+   * sending, if any. */
+  port->fn->frob_control (port, C1284_NINIT, C1284_NINIT);
+
+  /* Event 49: PError goes high. */
+  lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+  stats_event (port, 49);
+  ret = port->fn->wait_status (port, S1284_PERROR, S1284_PERROR, &tv);
+
+  for (i = 0; i < port->ecr.spill_size; i++)
+    {
+      if (ecr_read (port) & ECR_F_EMPTY)
+	break;
+      fifo_get (port, NULL, 0, 1);
+    }
+
+  ecr_write (port, ECR_IDLE);
+  port->fn->frob_control (port, C1284_NAUTOFD, C1284_NAUTOFD);
+
+  if (ret)
+    {
+      TRACE_NOTE (port, "ECP direction: failed to switch forward", 0);
+      port->current_phase = PH1284_ECP_DIR_UNKNOWN;
+    }
+  else
+    {
+      port->fn->data_dir (port, 0);
+      port->current_phase = PH1284_FWD_IDLE;
+    }
+}
+
+static ssize_t
+ecr_ecp_read_data (struct parport_internal *port, int flags,
+		   char *buffer, size_t len)
+{
+  struct ecr_state *ecr = &port->ecr;
+  unsigned char *buf = (unsigned char *) buffer;
+  size_t count;
+  nsec_t deadline;
+  int r;
+
+  TRACE_ENTER (port, "ecr", SC1284_ECP_READ_DATA);
+
+  /* Data from last time first. */
+  count = ecr->spilled - ecr->spill_at;
+  if (count > len)
+    count = len;
+  memcpy (buf, ecr->spill + ecr->spill_at, count);
+  ecr->spill_at += count;
+  if (ecr->spill_at == ecr->spilled)
+    ecr->spill_at = ecr->spilled = 0;
+
+  if (count == len)
+    {
+      TRACE_LEAVE (port, "ecr", SC1284_ECP_READ_DATA, count);
+      return count;
+    }
+
+  if (port->current_phase != PH1284_REV_IDLE)
+    if (port->fn->ecp_fwd_to_rev (port))
+      {
+	TRACE_LEAVE (port, "ecr", SC1284_ECP_READ_DATA, count);
+	return count;
+      }
+
+  port->current_phase = PH1284_REV_DATA;
+  ecr_write (port, ECR_ARMED);
+
+  deadline = signal_deadline ();
+  while (count < len)
+    {
+      size_t entries;
+
+      r = ecr_read (port);
+      if (r & ECR_F_EMPTY)
+	{
+	  r = ecr_wait (port, ECR_F_EMPTY, 0, deadline);
+	  if (r < 0)
+	    {
+	      TRACE_NOTE (port, "ECP FIFO read timed out", 0);
+	      break;
+	    }
+	}
+
+      if (r & ECR_F_FULL)
+	entries = ecr->fifo_depth;
+      else if ((r & ECR_SERVICEINTR) && ecr->read_threshold)
+	{
+	  entries = ecr->read_threshold;
+	  ecr_write (port, ECR_ARMED);
+	}
+      else
+	entries = 1;
+
+      if (entries > len - count)
+	entries = len - count;
+
+      count += fifo_get (port, buf + count, len - count, entries);
+      deadline = signal_deadline ();
+    }
+
+  ecr_stop_reverse (port);
+
+  TRACE_NOTE (port, "%ld bytes spilled", ecr->spilled);
+  TRACE_LEAVE (port, "ecr", SC1284_ECP_READ_DATA, count);
+  return count;
+}
+
+/* Is there an ECR?  This is parport_ECR_present from Linux.  Each
+ * register written is put back if the answer is no; ECR is where the
+ * ECR, if any, was to begin with. */
+static int
+ecr_present (struct parport_internal *port, unsigned char ecr)
+{
+  const unsigned long control = port->base + 2;
+  unsigned char r = ecr, ctr = port->fn->do_inb (port, control);
+
+  if ((r & 0x3) == (ctr & 0x3))
+    {
+      /* It might be the control register again. */
+      unsigned char ctr2;
+      port->fn->do_outb (port, (unsigned char) (ctr ^ 0x2), control);
+      ctr2 = port->fn->do_inb (port, control);
+      r = ecr_read (port);
+      port->fn->do_outb (port, ctr, control);
+      if ((r & 0x2) == (ctr2 & 0x2))
+	return 0;
+    }
+
+  if ((r & 0x3) != ECR_F_EMPTY)
+    return 0;
+
+  ecr_write (port, 0x34);
+  if (ecr_read (port) != 0x35)
+    {
+      ecr_write (port, ecr);
+      return 0;
+    }
+
+  return 1;
+}
+
+/* Measure the FIFO, as parport_pc's parport_ECP_supported does. */
+static int
+ecr_probe (struct parport_internal *port)
+{
+  struct ecr_state *ecr = &port->ecr;
+  const unsigned long control = port->base + 2;
+  unsigned char ctr, cnfga, saved;
+  unsigned int i;
+
+  if (!port->base_hi)
+    return E1284_NOTAVAIL;
+
+  saved = ecr_read (port);
+  if (!ecr_present (port, saved))
+    return E1284_NOTAVAIL;
+
+  ctr = port->fn->do_inb (port, control);
+  ecr_write (port, ECR_MODE (ECR_SPP));
+  ecr_write (port, ECR_MODE (ECR_TST));
+  for (i = 0; i < 1024 && !(ecr_read (port) & ECR_F_FULL); i++)
+    port->fn->do_outb (port, 0xaa, ECR_DFIFO (port));
+
+  if (i == 1024 || !i)
+    {
+      /* Leaving test mode empties the FIFO. */
+      ecr_write (port, ECR_MODE (ECR_SPP));
+      ecr_write (port, saved);
+      port->fn->do_outb (port, ctr, control);
+      return E1284_NOTAVAIL;
+    }
+
+  ecr->fifo_depth = i;
+
+  /* writeIntrThreshold: empty the full FIFO until serviceIntr is
+   * set. */
+  ecr_write (port, ECR_MODE (ECR_TST) | ECR_SERVICEINTR);
+  ecr_write (port, ECR_MODE (ECR_TST));
+  for (i = 1; i <= ecr->fifo_depth; i++)
+    {
+      port->fn->do_inb (port, ECR_DFIFO (port));
+      udelay (50);
+      if (ecr_read (port) & ECR_SERVICEINTR)
+	break;
+    }
+
+  ecr->write_threshold = i <= ecr->fifo_depth ? i : 0;
+
+  /* readIntrThreshold: fill the empty FIFO in reverse until
+   * serviceIntr is set. */
+  ecr_write (port, ECR_MODE (ECR_PS2));
+  port->fn->do_outb (port, (unsigned char) (ctr | 0x20), control);
+  ecr_write (port, ECR_MODE (ECR_TST));
+  ecr_write (port, ECR_MODE (ECR_TST) | ECR_SERVICEINTR);
+  ecr_write (port, ECR_MODE (ECR_TST));
+  for (i = 1; i <= ecr->fifo_depth; i++)
+    {
+      port->fn->do_outb (port, 0xaa, ECR_DFIFO (port));
+      if (ecr_read (port) & ECR_SERVICEINTR)
+	break;
+    }
+
+  ecr->read_threshold = i <= ecr->fifo_depth ? i : 0;
+  ecr_write (port, ECR_MODE (ECR_PS2));
+  port->fn->do_outb (port, ctr, control);
+
+  ecr_write (port, ECR_MODE (ECR_CNF) | ECR_NERRINTREN | ECR_SERVICEINTR);
+  cnfga = port->fn->do_inb (port, ECR_CNFGA (port));
+  switch ((cnfga >> 4) & 0x7)
+    {
+    case 0:
+      ecr->pword = 2;
+      break;
+    case 2:
+      ecr->pword = 4;
+      break;
+    default:
+      debugprintf ("Unknown ECP implementation ID, assuming 8-bit\n");
+      /* Fall through */
+    case 1:
+      ecr->pword = 1;
+      break;
+    }
+
+  ecr_write (port, ECR_IDLE);
+
+  debugprintf ("ECP FIFO: %u PWords of %u bytes, thresholds %u/%u\n",
+	       ecr->fifo_depth, ecr->pword, ecr->write_threshold,
+	       ecr->read_threshold);
+  return E1284_OK;
+}
+
+int
+ecr_install (struct parport_internal *port)
+{
+  struct ecr_state *ecr = &port->ecr;
+
+  if (ecr_probe (port))
+    {
+      ecr->fifo_depth = 0;
+      return 0;
+    }
+
+  if ((ecr->pword == 2 && !port->fn->do_outw) ||
+      (ecr->pword == 4 && !port->fn->do_outl))
+    {
+      debugprintf ("No %u-byte access for the ECP FIFO\n", ecr->pword);
+      ecr->fifo_depth = 0;
+      return 0;
+    }
+
+  /* A FIFO's worth, and the longest run-length encoded run. */
+  ecr->spill_size = ecr->fifo_depth + 128;
+  ecr->spill = malloc (ecr->spill_size);
+  if (!ecr->spill)
+    {
+      ecr->fifo_depth = 0;
+      return 0;
+    }
+
+  ecr->spilled = ecr->spill_at = 0;
+
+  /* The peripheral can stop in the middle of a PWord, and there's no
+   * telling how much of the last one is real, so only read through
+   * 8-bit FIFOs. */
+  if (ecr->pword == 1)
+    port->fn->ecp_read_data = ecr_ecp_read_data;
+  port->fn->ecp_write_data = ecr_ecp_write_data;
+  port->fn->ecp_write_addr = ecr_ecp_write_addr;
+  return 1;
+}
+
+void
+ecr_cleanup (struct parport_internal *port)
+{
+  struct ecr_state *ecr = &port->ecr;
+
+  if (ecr->spill)
+    free (ecr->spill);
+
+  ecr->spill = NULL;
+  ecr->spilled = ecr->spill_at = 0;
+}
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
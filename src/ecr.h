@@ -0,0 +1,66 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _ECR_H_
+#define _ECR_H_
+
+#include "detect.h"
+
+/* Registers above the base address of an ECP port.  In ECP mode
+ * the data register at base is the address FIFO. */
+#define ECR_AFIFO(port)		((port)->base)
+#define ECR_DFIFO(port)		((port)->base_hi)
+#define ECR_CNFGA(port)		((port)->base_hi)
+#define ECR_CNFGB(port)		((port)->base_hi + 1)
+#define ECR_ECR(port)		((port)->base_hi + 2)
+
+/* ECR modes, in bits 7:5. */
+#define ECR_SPP		0
+#define ECR_PS2		1
+#define ECR_PPF		2
+#define ECR_ECP		3
+#define ECR_EPP		4
+#define ECR_TST		6
+#define ECR_CNF		7
+#define ECR_MODE(m)	((unsigned char) ((m) << 5))
+
+#define ECR_NERRINTREN	(1<<4)
+#define ECR_DMAEN	(1<<3)
+#define ECR_SERVICEINTR	(1<<2)
+#define ECR_F_FULL	(1<<1)
+#define ECR_F_EMPTY	(1<<0)
+
+/* Where the ECR is left between transfers: PS2 mode, with
+ * serviceIntr disarmed. */
+#define ECR_IDLE	(ECR_MODE (ECR_PS2) | ECR_NERRINTREN | ECR_SERVICEINTR)
+
+/* Look for an ECR at port->base_hi.  If there is one, leave it in
+ * PS2 mode and use its FIFO for the ECP transfer methods.  Returns
+ * non-zero if it did. */
+extern int ecr_install (struct parport_internal *port);
+
+extern void ecr_cleanup (struct parport_internal *port);
+
+#endif /* _ECR_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,749 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2000-2001 Hewlett-Packard Company
+ * Integrated into libieee1284:
+ * Copyright (C) 2001-2003  Tim Waugh <twaugh@redhat.com>
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * The software protocol engines, as a template.  This file is
+ * included once for each set of pin operations the engines are to be
+ * built with: default.c builds them on the access methods, and
+ * access_io.c builds copies that go straight to the port registers,
+ * so that each byte costs no indirect calls.
+ *
+ * Before including it, define:
+ *
+ *   ENGINE(name)          the name of each engine function
+ *   ENGINE_TAG            a string naming this copy, for debugging
+ *   ENGINE_SCOPE          the storage class of the engines
+ *   ENGINE_READ_DATA(port)
+ *   ENGINE_WRITE_DATA(port, val)
+ *   ENGINE_READ_STATUS(port)
+ *   ENGINE_WRITE_CONTROL(port, ct)
+ *   ENGINE_FROB_CONTROL(port, mask, val)
+ *   ENGINE_DATA_DIR(port, reverse)
+ *   ENGINE_WAIT_STATUS(port, mask, val, timeout)
+ *
+ * which mean the same as the access methods of those names.
+ * ENGINE (poll_lines) is available for ENGINE_WAIT_STATUS to use.
+ * The including file must also include stats.h and trace.h.
+ * Termination and ECP bus reversal still go through the access
+ * methods, since they happen at most once per transfer.
+ */
+
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+/* The poll engine.  Spin while the peripheral is likely to answer
+ * soon, then yield, then sleep for progressively longer.  How long
+ * to spin, and how long to nap at first, come from the port's record
+ * of how quickly the peripheral usually responds. */
+#define POLL_SPIN_MIN_NS 2000
+#define POLL_SPIN_MAX_NS 50000
+#define POLL_YIELD_NS 20000
+#define POLL_NAP_MIN_NS 10000
+#define POLL_NAP_MAX_NS 1000000
+
+/* A gap this long between two reads of the lines, when we didn't
+ * sleep in between, means the thread lost the CPU. */
+#define POLL_STALL_NS 50000
+
+static void
+poll_learn (struct poll_profile *profile, nsec_t response)
+{
+  if (profile->responses++)
+    profile->typical += (long) ((response - profile->typical) / 8);
+  else
+    profile->typical = (long) response;
+}
+
+#endif /* _ENGINE_H_ */
+
+static int
+ENGINE (poll_lines) (struct parport_internal *port, int status,
+		     unsigned char mask, unsigned char val,
+		     struct timeval *timeout)
+{
+  struct poll_profile *profile = &port->poll;
+  nsec_t start = monotonic_ns ();
+  nsec_t deadline = timeout_deadline (timeout);
+  nsec_t spin = POLL_SPIN_MIN_NS, nap_min = POLL_NAP_MIN_NS;
+  nsec_t now, nap, last = start, slept = 0;
+  int napped = 0;
+
+  stats_wait_start (port, mask, val);
+
+  if (profile->responses)
+    {
+      if (2 * profile->typical <= POLL_SPIN_MAX_NS)
+	{
+	  if (2 * profile->typical > spin)
+	    spin = 2 * profile->typical;
+	}
+      else if (profile->typical / 4 > nap_min)
+	nap_min = profile->typical / 4;
+    }
+
+  for (;;)
+    {
+      unsigned char lines;
+      if (status)
+	lines = ENGINE_READ_STATUS (port);
+      else
+	lines = ENGINE_READ_DATA (port);
+
+      now = monotonic_ns ();
+      port->stats.c.wait_reads++;
+      if (!napped && now - last > POLL_STALL_NS)
+	port->stats.c.stalls++;
+      last = now;
+      napped = 0;
+
+      if ((lines & mask) == val)
+	{
+	  poll_learn (profile, now - start);
+	  stats_wait_done (port, E1284_OK, now - start, slept);
+	  return E1284_OK;
+	}
+
+      if (now >= deadline)
+	break;
+
+      if (now - start < spin)
+	continue;
+
+      if (now - start < spin + POLL_YIELD_NS)
+	{
+	  cpu_yield ();
+	  continue;
+	}
+
+      /* Sleeping for a quarter of the time waited so far keeps the
+       * lateness to a quarter of the response time. */
+      nap = (now - start) / 4;
+      if (nap < nap_min)
+	nap = nap_min;
+      if (nap > POLL_NAP_MAX_NS)
+	nap = POLL_NAP_MAX_NS;
+      if (nap > deadline - now)
+	nap = deadline - now;
+      nsleep (nap);
+      napped = 1;
+      slept += monotonic_ns () - now;
+    }
+
+  profile->timeouts++;
+  stats_wait_done (port, E1284_TIMEDOUT, now - start, slept);
+  return E1284_TIMEDOUT;
+}
+
+ENGINE_SCOPE ssize_t
+ENGINE (nibble_read) (struct parport_internal *port, int flags,
+		      char *buffer, size_t len)
+{
+  size_t count = 0;
+  int datain;
+  int low, high;
+  struct timeval tv;
+
+  TRACE_ENTER (port, ENGINE_TAG, SC1284_NIBBLE_READ);
+
+  /* start of reading data from the scanner */
+  while (count < len)
+    {
+      /* More data? */
+      if ((count & 1) == 0 &&
+	  (ENGINE_READ_STATUS (port) & S1284_NFAULT))
+	{
+	  TRACE_NOTE (port, "No more data", 0);
+	  ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, 0);
+	  break;
+	}
+
+      ENGINE_WRITE_CONTROL (port,
+			    C1284_NSTROBE | C1284_NINIT | C1284_NSELECTIN);
+
+      lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+      stats_event (port, 9);
+      if (ENGINE_WAIT_STATUS (port, S1284_NACK, 0, &tv) 
+	  != E1284_OK)
+	goto error;
+
+      low = ENGINE_READ_STATUS (port) >> 3;
+      low = (low & 0x07) + ((low & 0x10) >> 1);
+
+      ENGINE_WRITE_CONTROL (port, C1284_NSTROBE | C1284_NINIT | C1284_NSELECTIN
+			    | C1284_NAUTOFD);
+
+      lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+      stats_event (port, 11);
+      if (ENGINE_WAIT_STATUS (port, S1284_NACK, S1284_NACK, &tv) 
+	  != E1284_OK)
+	goto error;
+
+      ENGINE_WRITE_CONTROL (port,
+			    C1284_NSTROBE | C1284_NINIT | C1284_NSELECTIN);
+
+      lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+      stats_event (port, 9);
+      if (ENGINE_WAIT_STATUS (port, S1284_NACK, 0, &tv) 
+	  != E1284_OK)
+	goto error;
+
+      high = ENGINE_READ_STATUS (port) >> 3;
+      high = (high & 0x07) | ((high & 0x10) >> 1);
+
+      ENGINE_WRITE_CONTROL (port, C1284_NSTROBE | C1284_NINIT | C1284_NSELECTIN
+			    | C1284_NAUTOFD);
+
+      lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+      stats_event (port, 11);
+      if (ENGINE_WAIT_STATUS (port, S1284_NACK, S1284_NACK, &tv) 
+	  != E1284_OK)
+	goto error;
+
+      datain = (high << 4) + low;
+
+      buffer[count] = datain & 0xff;
+      count++;
+    }
+
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_NIBBLE_READ, count);
+  return count;
+
+ error:
+  port->fn->terminate (port);
+  TRACE_NOTE (port, "Terminated on error", 0);
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_NIBBLE_READ, count);
+  return count;
+}
+
+ENGINE_SCOPE ssize_t
+ENGINE (compat_write) (struct parport_internal *port, int flags,
+		       const char *buffer, size_t len)
+{
+  size_t count = 0;
+  struct timeval tv;
+
+  TRACE_ENTER (port, ENGINE_TAG, SC1284_COMPAT_WRITE);
+
+  while (count < len)
+    {		
+      lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+      if (ENGINE_WAIT_STATUS (port, S1284_BUSY, 0, &tv) != E1284_OK)
+	goto error;
+
+      /* Tsetup: 750ns min. */
+      delay (TIMEVAL_STROBE_DELAY);
+
+      /* Get the data byte ready */
+      ENGINE_WRITE_DATA (port, buffer[count]);
+
+      /* Pulse nStrobe low */
+      ENGINE_WRITE_CONTROL (port, C1284_NINIT | C1284_NAUTOFD);
+
+      /* Tstrobe: 750ns - 500us */
+      delay (TIMEVAL_STROBE_DELAY);
+
+      /* And raise it */
+      ENGINE_WRITE_CONTROL (port,
+			    C1284_NINIT | C1284_NAUTOFD | C1284_NSTROBE);
+
+      /* Thold: 750ns min. */
+      delay (TIMEVAL_STROBE_DELAY);
+
+      count++;
+    }
+
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_COMPAT_WRITE, len);
+  return len;
+
+ error:
+  port->fn->terminate (port);
+  TRACE_NOTE (port, "Terminated on error", 0);
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_COMPAT_WRITE, count);
+  return count;  
+}
+
+ENGINE_SCOPE ssize_t
+ENGINE (byte_read) (struct parport_internal *port, int flags,
+		    char *buffer, size_t len)
+{
+
+  unsigned char *buf = buffer;
+  size_t count = 0;
+  struct timeval tv;
+
+  /* FIXME: Untested as yet, copied from ieee1284_op.c,
+   * inverted appropriate signals  */
+
+  TRACE_ENTER (port, ENGINE_TAG, SC1284_BYTE_READ);
+
+  for (count = 0; count < len; count++) {
+    unsigned char byte;
+
+    /* Data available? */
+    if (ENGINE_READ_STATUS (port) & S1284_PERROR) {
+      /* Go to reverse idle phase. */
+      ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, C1284_NAUTOFD);
+      break;
+    }
+
+    /* Event 14: Place data bus in high impedance state. */
+    ENGINE_DATA_DIR (port, 1);
+
+    /* Event 7: Set nAutoFd low. */
+    ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, 0);
+
+    /* Event 9: nAck goes low. */
+    lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+    stats_event (port, 9);
+    if (ENGINE_WAIT_STATUS (port, S1284_NACK, 0, &tv)) {
+      /* Timeout -- no more data? */
+      ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, C1284_NAUTOFD);
+      break;
+    }
+
+    byte = ENGINE_READ_DATA (port);
+    *buf++ = byte;
+
+    /* Event 10: Set nAutoFd high */
+    ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, C1284_NAUTOFD);
+
+    /* Event 11: nAck goes high. */
+    lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+    stats_event (port, 11);
+    if (ENGINE_WAIT_STATUS (port, S1284_NACK, S1284_NACK, &tv)) {
+      /* Timeout -- no more data? */
+      break;
+    }
+
+    /* Event 16: Set nStrobe low. */
+    ENGINE_FROB_CONTROL (port, C1284_NSTROBE, 0);
+    udelay (5);
+
+    /* Event 17: Set nStrobe high. */
+    ENGINE_FROB_CONTROL (port, C1284_NSTROBE, C1284_NSTROBE);
+  }
+
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_BYTE_READ, count);
+
+  return count;
+
+}
+
+ENGINE_SCOPE ssize_t
+ENGINE (epp_read_data) (struct parport_internal *port, int flags,
+			char *buffer, size_t len)
+{
+  unsigned char *buf = buffer;
+  ssize_t count = 0;
+  struct timeval tv;
+
+  /* FIXME: Untested as yet, copied from ieee1284_op.c, 
+   * inverted appropriate signals  */
+
+  TRACE_ENTER (port, ENGINE_TAG, SC1284_EPP_READ_DATA);
+
+  /* set EPP idle state (just to make sure) with strobe high */
+  ENGINE_FROB_CONTROL (port, C1284_NSTROBE | C1284_NAUTOFD | 
+		       C1284_NSELECTIN | C1284_NINIT,
+		       C1284_NSTROBE | C1284_NINIT);
+  ENGINE_DATA_DIR (port, 1);
+
+  for (; len > 0; len--, buf++) {
+    /* Event 67: set nAutoFd (nDStrb) low */
+    ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, 0);
+    /* Event 58: wait for Busy to go high */
+    lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+    stats_event (port, 58);
+    if (ENGINE_WAIT_STATUS (port, S1284_BUSY, S1284_BUSY, &tv)) {
+      break;
+    }
+
+    *buf = ENGINE_READ_DATA (port);
+
+    /* Event 63: set nAutoFd (nDStrb) high */
+    ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, C1284_NAUTOFD);
+
+    /* Event 60: wait for Busy to go low */
+    lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+    stats_event (port, 60);
+    if (ENGINE_WAIT_STATUS (port, S1284_BUSY, 0, &tv)) {
+      break;
+    }
+
+    count++;
+  }
+  ENGINE_DATA_DIR (port, 0);
+
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_EPP_READ_DATA, count);
+  return count;
+}
+
+static int
+ENGINE (poll_port) (struct parport_internal *port, unsigned char mask,
+		    unsigned char result, int usec)
+{
+  nsec_t start = monotonic_ns ();
+  int count = usec / 5 + 2;
+  int i;
+
+  stats_wait_start (port, mask, result);
+  for (i = 0; i < count; i++)
+    {
+      unsigned char status = ENGINE_READ_STATUS (port);
+
+      port->stats.c.wait_reads++;
+      if ((status & mask) == result)
+	{
+	  stats_wait_done (port, E1284_OK, monotonic_ns () - start, 0);
+	  return E1284_OK;
+	}
+
+      if (i >= 2)
+	udelay (5);
+    }
+
+  stats_wait_done (port, E1284_TIMEDOUT, monotonic_ns () - start, 0);
+  return E1284_TIMEDOUT;
+}
+
+ENGINE_SCOPE ssize_t
+ENGINE (epp_write_data) (struct parport_internal *port, int flags,
+			 const char *buffer, size_t len)
+{
+  ssize_t ret = 0;
+
+  TRACE_ENTER (port, ENGINE_TAG, SC1284_EPP_WRITE_DATA);
+
+  /* Set EPP idle state (just to make sure).  Also set nStrobe low. */
+  ENGINE_FROB_CONTROL (port,
+		       C1284_NSTROBE | C1284_NAUTOFD
+		       | C1284_NSELECTIN | C1284_NINIT,
+		       C1284_NAUTOFD | C1284_NSELECTIN | C1284_NINIT);
+
+  ENGINE_DATA_DIR (port, 0);
+
+  for (; len > 0; len--, buffer++)
+    {
+      /* Event 62: Write data and set nAutoFd low */
+      ENGINE_WRITE_DATA (port, *buffer);
+      ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, 0);
+
+      /* Event 58: wait for busy (nWait) to go high */
+      stats_event (port, 58);
+      if (ENGINE (poll_port) (port, S1284_BUSY, S1284_BUSY, 10) != E1284_OK)
+	break;
+
+      /* Event 63: set nAutoFd (nDStrb) high */
+      ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, C1284_NAUTOFD);
+
+      /* Event 60: wait for busy (nWait) to go low */
+      stats_event (port, 60);
+      if (ENGINE (poll_port) (port, S1284_BUSY, 0, 5) != E1284_OK)
+	break;
+
+      ret++;
+    }
+
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_EPP_WRITE_DATA, ret);
+  return ret;
+}
+
+ENGINE_SCOPE ssize_t
+ENGINE (ecp_read_data) (struct parport_internal *port, int flags,
+			char *buffer, size_t len)
+{
+  /* FIXME: RLE Not tested yet because it's not reported as being available
+   * by the upper layers */
+
+  unsigned char *buf = buffer;
+  size_t rle_count = 0; /* shut gcc up */
+  int rle = 0;
+  size_t count = 0;
+  struct timeval tv;
+
+  TRACE_ENTER (port, ENGINE_TAG, SC1284_ECP_READ_DATA);
+
+  if (port->current_phase != PH1284_REV_IDLE)
+    if (port->fn->ecp_fwd_to_rev (port))
+      {
+	TRACE_LEAVE (port, ENGINE_TAG, SC1284_ECP_READ_DATA, 0);
+	return 0;
+      }
+    
+  port->current_phase = PH1284_REV_DATA;
+
+  /* Event 46: Set HostAck (nAutoFd) low to start accepting data. */
+  ENGINE_FROB_CONTROL (port, C1284_NAUTOFD | C1284_NSTROBE | C1284_NINIT, 
+		       C1284_NSTROBE);
+
+  while (count < len) {
+    unsigned char byte;
+    int command; 
+
+    /* Event 43: Peripheral sets nAck low. It can take as long as it wants.. */
+    /* FIXME: Should we impose some sensible limit here? */
+    lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+    do
+      stats_event (port, 43);
+    while (ENGINE_WAIT_STATUS (port, S1284_NACK, 0, &tv));
+
+    /* Is this a command? */
+    if (rle)
+      /* The last byte was a run-length count, so this can't be as well. */
+      command = 0;
+    else
+      /* note: test reversed from kernel because BUSY pin is inverted */
+      command = (ENGINE_READ_STATUS (port) & S1284_BUSY) ? 0 : 1;
+
+
+    /* Read the data. */
+    byte = ENGINE_READ_DATA (port);
+
+    /* If this is a channel command, rather than an RLE
+     * command or a normal data byte, don't accept it. */
+    if (command) {
+      if (byte & 0x80) {
+	TRACE_NOTE (port, "Stopping short at channel command (%02lx)", byte);
+	port->current_phase = PH1284_REV_IDLE;
+	TRACE_LEAVE (port, ENGINE_TAG, SC1284_ECP_READ_DATA, count);
+	return count;
+      }
+      else if (!(flags & F1284_RLE))
+	TRACE_NOTE (port, "Device illegally using RLE; accepting anyway", 0);
+
+      rle_count = byte + 1;
+
+      /* Are we allowed to read that many bytes? */
+      if (rle_count > (len - count)) {
+	TRACE_NOTE (port, "Leaving %ld RLE bytes for next time", rle_count);
+	break;
+      }
+
+      rle = 1;
+    }
+
+    /* Event 44: Set HostAck high, acknowledging handshake. */
+    ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, C1284_NAUTOFD);
+
+    /* Event 45: The peripheral has 35ms to set nAck high. */
+    lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+    stats_event (port, 45);
+    if (ENGINE_WAIT_STATUS (port, S1284_NACK, S1284_NACK, &tv)) {
+      /* It's gone wrong.  Return what data we have to the caller. */
+      if (command)
+	TRACE_NOTE (port, "Command ignored (%02lx)", byte);
+
+      break;
+    }
+
+    /* Event 46: Set HostAck low and accept the data. */
+    ENGINE_FROB_CONTROL (port, C1284_NAUTOFD, 0);
+
+    /* If we just read a run-length count, fetch the data. */
+    if (command)
+      continue;
+    /* If this is the byte after a run-length count, decompress. */
+    if (rle) {
+      rle = 0;
+      memset (buf, byte, rle_count);
+      buf += rle_count;
+      count += rle_count;
+      TRACE_NOTE (port, "Decompressed to %ld bytes", rle_count);
+    } else {
+      /* Normal data byte. */
+      *buf = byte;
+      buf++, count++;
+    }
+  }
+
+  port->current_phase = PH1284_REV_IDLE;
+
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_ECP_READ_DATA, count);
+
+  return count;
+}
+
+
+ENGINE_SCOPE ssize_t
+ENGINE (ecp_write_data) (struct parport_internal *port, int flags,
+			 const char *buffer, size_t len)
+{
+
+  const unsigned char *buf = buffer;
+  size_t written;
+  int retry;
+  struct timeval tv;
+
+  TRACE_ENTER (port, ENGINE_TAG, SC1284_ECP_WRITE_DATA);
+
+  if (port->current_phase != PH1284_FWD_IDLE)
+    if (port->fn->ecp_rev_to_fwd (port))
+      {
+	TRACE_LEAVE (port, ENGINE_TAG, SC1284_ECP_WRITE_DATA, 0);
+	return 0;
+      }
+
+  port->current_phase = PH1284_FWD_DATA;
+
+  /* HostAck high (data, not command) */
+  ENGINE_FROB_CONTROL (port, C1284_NAUTOFD | C1284_NINIT, 
+		       C1284_NAUTOFD | C1284_NINIT);
+
+  for (written = 0; written < len; written++, buf++) {
+    unsigned char byte;
+
+    byte = *buf;
+try_again:
+    ENGINE_WRITE_DATA (port, byte);
+    /* Event 35: Set NSTROBE low */
+    ENGINE_FROB_CONTROL (port, C1284_NSTROBE, 0);
+    udelay (5);
+    lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+    for (retry = 0; retry < 100; retry++) {
+      /* Event 36: peripheral sets BUSY high */
+      stats_event (port, 36);
+      if (!ENGINE_WAIT_STATUS (port, S1284_BUSY, S1284_BUSY, &tv))
+	goto success;
+    }
+
+    /* Time for Host Transfer Recovery (page 41 of IEEE1284) */
+    TRACE_NOTE (port, "ECP transfer stalled!", 0);
+
+    ENGINE_FROB_CONTROL (port, C1284_NINIT, C1284_NINIT);
+    udelay (50);
+    if (ENGINE_READ_STATUS (port) & S1284_PERROR) {
+      /* It's buggered. */
+      ENGINE_FROB_CONTROL (port, C1284_NINIT, 0);
+      break;
+    }
+
+    ENGINE_FROB_CONTROL (port, C1284_NINIT, 0);
+    udelay (50);
+    if (!(ENGINE_READ_STATUS (port) & S1284_PERROR))
+      break;
+
+    TRACE_NOTE (port, "Host transfer recovered", 0);
+
+    /* FIXME: Check for timeout here ? */
+    goto try_again;
+success:
+    /* Event 37: HostClk (nStrobe) high */
+    ENGINE_FROB_CONTROL (port, C1284_NSTROBE, C1284_NSTROBE);
+    udelay (5);
+    lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+    if (ENGINE_WAIT_STATUS (port, S1284_BUSY, 0, &tv))
+      /* Peripheral hasn't accepted the data. */
+      break;
+  }
+
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_ECP_WRITE_DATA, written);
+
+  port->current_phase = PH1284_FWD_IDLE;
+
+  return written;
+
+}
+
+ENGINE_SCOPE ssize_t
+ENGINE (ecp_write_addr) (struct parport_internal *port, int flags,
+			 const char *buffer, size_t len)
+{
+  const unsigned char *buf = buffer;
+  size_t written;
+  int retry;
+  struct timeval tv;
+
+  TRACE_ENTER (port, ENGINE_TAG, SC1284_ECP_WRITE_ADDR);
+
+  if (port->current_phase != PH1284_FWD_IDLE)
+    if (port->fn->ecp_rev_to_fwd (port))
+      {
+	TRACE_LEAVE (port, ENGINE_TAG, SC1284_ECP_WRITE_ADDR, 0);
+	return 0;
+      }
+  port->current_phase = PH1284_FWD_DATA;
+
+  /* HostAck (nAutoFd) low (command mode) */
+  ENGINE_FROB_CONTROL (port, C1284_NAUTOFD | C1284_NINIT, 
+		       C1284_NINIT);
+
+  for (written = 0; written < len; written++, buf++)
+    {
+      unsigned char byte;
+      byte = *buf;
+
+      /* FIXME: should we do RLE here? */
+    try_again:
+      ENGINE_WRITE_DATA (port, byte);
+      /* Event 35: Set NSTROBE low */
+      ENGINE_FROB_CONTROL (port, C1284_NSTROBE, 0);
+      udelay (5);
+      lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+      for (retry = 0; retry < 100; retry++)
+	{
+	  /* Event 36: peripheral sets BUSY high */
+	  stats_event (port, 36);
+	  if (!ENGINE_WAIT_STATUS (port, S1284_BUSY, S1284_BUSY, &tv))
+	    goto success;
+	}
+
+      /* Time for Host Transfer Recovery (page 41 of IEEE1284) */
+      TRACE_NOTE (port, "ECP address transfer stalled!", 0);
+
+      ENGINE_FROB_CONTROL (port, C1284_NINIT, C1284_NINIT);
+      udelay (50);
+      if (ENGINE_READ_STATUS (port) & S1284_PERROR)
+	{      
+	  /* It's buggered. */
+	  ENGINE_FROB_CONTROL (port, C1284_NINIT, 0);
+	  break;
+	}
+
+      ENGINE_FROB_CONTROL (port, C1284_NINIT, 0);
+      udelay (50);
+      if (!(ENGINE_READ_STATUS (port) & S1284_PERROR))
+	break;
+
+      TRACE_NOTE (port, "Host address transfer recovered", 0);
+
+      /* FIXME: Check for timeout here ? */
+      goto try_again;
+    success:
+      /* Event 37: HostClk (nStrobe) high */
+      ENGINE_FROB_CONTROL (port, C1284_NSTROBE, C1284_NSTROBE);
+      udelay (5);
+      lookup_delay (TIMEVAL_SIGNAL_TIMEOUT, &tv);
+      if (ENGINE_WAIT_STATUS (port, S1284_BUSY, 0, &tv))
+	/* Peripheral hasn't accepted the data. */
+	break;
+    }
+
+  TRACE_LEAVE (port, ENGINE_TAG, SC1284_ECP_WRITE_ADDR, written);
+  port->current_phase = PH1284_FWD_IDLE;
+  return written;
+}
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
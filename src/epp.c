@@ -0,0 +1,305 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Hardware-assisted EPP, for ports with EPP registers.  Reading or
+ * writing the address register at base+3, or the data register at
+ * base+4, makes the port run a complete EPP cycle by itself.  With
+ * F1284_FASTEPP, wider accesses to the data register run two or four
+ * cycles at once, and the timeout bit is only checked at the end.
+ *
+ * Probing follows the Linux parport_pc driver.
+ */
+
+#include "config.h"
+
+#ifndef _MSC_VER
+#include <sys/time.h>
+#endif
+#include <sys/types.h>
+
+#include "access.h"
+#include "debug.h"
+#include "detect.h"
+#include "ecr.h"
+#include "epp.h"
+#include "ieee1284.h"
+#include "shadow.h"
+#include "trace.h"
+
+#define EPP_STATUS(port) ((port)->base + 1)
+
+/* Clear the EPP timeout bit.  Some chips clear it when it's read,
+ * some when a 1 is written to it, and some when a 0 is.  Returns
+ * non-zero if it is clear. */
+static int
+epp_clear_timeout (struct parport_internal *port)
+{
+  unsigned char r;
+
+  if (!(port->fn->do_inb (port, EPP_STATUS (port)) & EPP_TIMEOUT))
+    return 1;
+
+  port->fn->do_inb (port, EPP_STATUS (port));
+  r = port->fn->do_inb (port, EPP_STATUS (port));
+  port->fn->do_outb (port, (unsigned char) (r | EPP_TIMEOUT),
+		     EPP_STATUS (port));
+  port->fn->do_outb (port, (unsigned char) (r & ~EPP_TIMEOUT),
+		     EPP_STATUS (port));
+  r = port->fn->do_inb (port, EPP_STATUS (port));
+  return !(r & EPP_TIMEOUT);
+}
+
+static int
+epp_timed_out (struct parport_internal *port)
+{
+  if (!(port->fn->do_inb (port, EPP_STATUS (port)) & EPP_TIMEOUT))
+    return 0;
+
+  TRACE_NOTE (port, "EPP timeout", 0);
+  epp_clear_timeout (port);
+  return 1;
+}
+
+static void
+epp_begin (struct parport_internal *port, int reverse)
+{
+  if (port->ecr.fifo_depth)
+    port->fn->do_outb (port, ECR_MODE (ECR_EPP) | ECR_NERRINTREN
+		       | ECR_SERVICEINTR, ECR_ECR (port));
+
+  /* The port drives nWrite, nDStrb and nAStrb.  Leave them, and
+   * nInit, inactive. */
+  port->fn->frob_control (port, (C1284_NSTROBE | C1284_NAUTOFD
+				 | C1284_NSELECTIN | C1284_NINIT),
+			  (C1284_NSTROBE | C1284_NAUTOFD
+			   | C1284_NSELECTIN | C1284_NINIT));
+  port->fn->data_dir (port, reverse);
+  epp_clear_timeout (port);
+}
+
+static void
+epp_end (struct parport_internal *port)
+{
+  port->fn->data_dir (port, 0);
+  if (port->ecr.fifo_depth)
+    port->fn->do_outb (port, ECR_IDLE, ECR_ECR (port));
+}
+
+static ssize_t
+epp_read (struct parport_internal *port, unsigned long reg, int flags,
+	  char *buffer, size_t len)
+{
+  const struct parport_access_methods *fn = port->fn;
+  unsigned char *buf = (unsigned char *) buffer;
+  size_t got = 0;
+  ssize_t ret;
+
+  epp_begin (port, 1);
+
+  if ((flags & F1284_FASTEPP) && len > 1)
+    {
+      if (reg == EPP_DATA (port) && fn->do_inl)
+	for (; len - got >= 4; got += 4)
+	  {
+	    unsigned int w = fn->do_inl (port, reg);
+	    buf[got] = (unsigned char) w;
+	    buf[got + 1] = (unsigned char) (w >> 8);
+	    buf[got + 2] = (unsigned char) (w >> 16);
+	    buf[got + 3] = (unsigned char) (w >> 24);
+	  }
+
+      if (reg == EPP_DATA (port) && fn->do_inw)
+	for (; len - got >= 2; got += 2)
+	  {
+	    unsigned short w = fn->do_inw (port, reg);
+	    buf[got] = (unsigned char) w;
+	    buf[got + 1] = (unsigned char) (w >> 8);
+	  }
+
+      for (; got < len; got++)
+	buf[got] = fn->do_inb (port, reg);
+
+      /* There's no telling how much got through. */
+      ret = epp_timed_out (port) ? E1284_TIMEDOUT : (ssize_t) got;
+    }
+  else
+    {
+      for (; got < len; got++)
+	{
+	  buf[got] = fn->do_inb (port, reg);
+	  if (epp_timed_out (port))
+	    break;
+	}
+
+      ret = got;
+    }
+
+  epp_end (port);
+  return ret;
+}
+
+static ssize_t
+epp_write (struct parport_internal *port, unsigned long reg, int flags,
+	   const char *buffer, size_t len)
+{
+  const struct parport_access_methods *fn = port->fn;
+  const unsigned char *buf = (const unsigned char *) buffer;
+  size_t sent = 0;
+  ssize_t ret;
+
+  epp_begin (port, 0);
+
+  if ((flags & F1284_FASTEPP) && len > 1)
+    {
+      if (reg == EPP_DATA (port) && fn->do_outl)
+	for (; len - sent >= 4; sent += 4)
+	  fn->do_outl (port, ((unsigned int) buf[sent]
+			      | (unsigned int) buf[sent + 1] << 8
+			      | (unsigned int) buf[sent + 2] << 16
+			      | (unsigned int) buf[sent + 3] << 24), reg);
+
+      if (reg == EPP_DATA (port) && fn->do_outw)
+	for (; len - sent >= 2; sent += 2)
+	  fn->do_outw (port, (unsigned short) (buf[sent]
+					       | buf[sent + 1] << 8), reg);
+
+      for (; sent < len; sent++)
+	fn->do_outb (port, buf[sent], reg);
+
+      ret = epp_timed_out (port) ? E1284_TIMEDOUT : (ssize_t) sent;
+    }
+  else
+    {
+      for (; sent < len; sent++)
+	{
+	  fn->do_outb (port, buf[sent], reg);
+	  if (epp_timed_out (port))
+	    break;
+	}
+
+      ret = sent;
+    }
+
+  epp_end (port);
+
+  /* The port has been driving the data lines. */
+  shadow_invalidate (port);
+  return ret;
+}
+
+static ssize_t
+epp_read_data (struct parport_internal *port, int flags,
+	       char *buffer, size_t len)
+{
+  ssize_t ret;
+
+  TRACE_ENTER (port, "epp", SC1284_EPP_READ_DATA);
+  ret = epp_read (port, EPP_DATA (port), flags, buffer, len);
+  TRACE_LEAVE (port, "epp", SC1284_EPP_READ_DATA, ret);
+  return ret;
+}
+
+static ssize_t
+epp_write_data (struct parport_internal *port, int flags,
+		const char *buffer, size_t len)
+{
+  ssize_t ret;
+
+  TRACE_ENTER (port, "epp", SC1284_EPP_WRITE_DATA);
+  ret = epp_write (port, EPP_DATA (port), flags, buffer, len);
+  TRACE_LEAVE (port, "epp", SC1284_EPP_WRITE_DATA, ret);
+  return ret;
+}
+
+static ssize_t
+epp_read_addr (struct parport_internal *port, int flags,
+	       char *buffer, size_t len)
+{
+  ssize_t ret;
+
+  TRACE_ENTER (port, "epp", SC1284_EPP_READ_ADDR);
+  ret = epp_read (port, EPP_ADDR (port), flags, buffer, len);
+  TRACE_LEAVE (port, "epp", SC1284_EPP_READ_ADDR, ret);
+  return ret;
+}
+
+static ssize_t
+epp_write_addr (struct parport_internal *port, int flags,
+		const char *buffer, size_t len)
+{
+  ssize_t ret;
+
+  TRACE_ENTER (port, "epp", SC1284_EPP_WRITE_ADDR);
+  ret = epp_write (port, EPP_ADDR (port), flags, buffer, len);
+  TRACE_LEAVE (port, "epp", SC1284_EPP_WRITE_ADDR, ret);
+  return ret;
+}
+
+/* The timeout bit is clear, or can be cleared, in EPP mode.  On
+ * ports with an ECR, it also mustn't be clearable in the other
+ * modes, or it isn't real EPP (Intel's ECP+EPP bug). */
+static int
+epp_probe (struct parport_internal *port)
+{
+  unsigned char mode;
+  int ret;
+
+  if (port->ecr.fifo_depth)
+    port->fn->do_outb (port, ECR_MODE (ECR_EPP) | ECR_NERRINTREN
+		       | ECR_SERVICEINTR, ECR_ECR (port));
+
+  ret = epp_clear_timeout (port);
+  if (ret && port->ecr.fifo_depth)
+    for (mode = ECR_SPP; mode <= ECR_ECP; mode++)
+      {
+	port->fn->do_outb (port, ECR_MODE (mode), ECR_ECR (port));
+	if (epp_clear_timeout (port))
+	  {
+	    debugprintf ("Phony EPP in ECP mode %d\n", mode);
+	    ret = 0;
+	    break;
+	  }
+      }
+
+  if (port->ecr.fifo_depth)
+    port->fn->do_outb (port, ECR_IDLE, ECR_ECR (port));
+
+  return ret;
+}
+
+int
+epp_install (struct parport_internal *port)
+{
+  if (!epp_probe (port))
+    return 0;
+
+  debugprintf ("EPP registers at %#lx\n", EPP_ADDR (port));
+  port->fn->epp_read_data = epp_read_data;
+  port->fn->epp_write_data = epp_write_data;
+  port->fn->epp_read_addr = epp_read_addr;
+  port->fn->epp_write_addr = epp_write_addr;
+  return 1;
+}
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
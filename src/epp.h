@@ -0,0 +1,44 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _EPP_H_
+#define _EPP_H_
+
+#include "detect.h"
+
+/* EPP registers above the base address.  Accessing them runs an EPP
+ * address or data cycle. */
+#define EPP_ADDR(port)		((port)->base + 3)
+#define EPP_DATA(port)		((port)->base + 4)
+
+/* Set in the status register when the peripheral didn't respond
+ * within about 10us. */
+#define EPP_TIMEOUT		(1<<0)
+
+/* Check whether the port has EPP registers, and if so use them for
+ * the EPP transfer methods.  Returns non-zero if it did. */
+extern int epp_install (struct parport_internal *port);
+
+#endif /* _EPP_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
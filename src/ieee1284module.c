@@ -145,6 +145,10 @@ handle_error (int err)
 		PyErr_SetString (pyieee1284_error,
 				 "Port is invalid (perhaps not opened?)");
 		return;
+	case E1284_CANCELLED:
+		PyErr_SetString (pyieee1284_error,
+				 "Asynchronous transfer cancelled");
+		return;
 	}
 
 	PyErr_SetString (pyieee1284_error, "Unknown error");
@@ -200,6 +204,36 @@ Parport_get_irq_fd (ParportObject *self)
 	return PyLong_FromLong (fd);
 }
 
+static PyObject *
+Parport_get_poll_fd (ParportObject *self, PyObject *args)
+{
+	int events;
+	int fd;
+
+	if (!PyArg_ParseTuple (args, "i", &events))
+		return NULL;
+
+	fd = ieee1284_get_poll_fd (self->port, events);
+	if (fd < 0) {
+		handle_error (fd);
+		return NULL;
+	}
+
+	return PyLong_FromLong (fd);
+}
+
+static PyObject *
+Parport_poll_events (ParportObject *self)
+{
+	int r = ieee1284_poll_events (self->port);
+	if (r < 0) {
+		handle_error (r);
+		return NULL;
+	}
+
+	return PyLong_FromLong (r);
+}
+
 static PyObject *
 Parport_clear_irq (ParportObject *self)
 {
@@ -363,6 +397,72 @@ Parport_frob_control (ParportObject *self, PyObject *args)
 	return Py_None;
 }
 
+static PyObject *
+Parport_pin_program (ParportObject *self, PyObject *args)
+{
+	PyObject *seq, *ret;
+	struct ieee1284_pin_op *ops;
+	unsigned char *out;
+	Py_ssize_t i, n;
+	size_t nout = 0;
+	ssize_t r;
+
+	if (!PyArg_ParseTuple (args, "O", &seq))
+		return NULL;
+
+	seq = PySequence_Fast (seq, "pin_program needs a sequence");
+	if (!seq)
+		return NULL;
+
+	n = PySequence_Fast_GET_SIZE (seq);
+	ops = calloc (n ? n : 1, sizeof *ops);
+	out = malloc (n ? n : 1);
+	if (!ops || !out) {
+		free (ops);
+		free (out);
+		Py_DECREF (seq);
+		return PyErr_NoMemory ();
+	}
+
+	for (i = 0; i < n; i++) {
+		PyObject *item = PySequence_Fast_GET_ITEM (seq, i);
+		int op, mask = 0, val = 0;
+		unsigned long usec = 0;
+		if (!PyArg_ParseTuple (item, "i|iik", &op, &mask, &val,
+				       &usec)) {
+			free (ops);
+			free (out);
+			Py_DECREF (seq);
+			return NULL;
+		}
+
+		ops[i].op = op;
+		ops[i].mask = (unsigned char) mask;
+		ops[i].val = (unsigned char) val;
+		ops[i].usec = usec;
+	}
+	Py_DECREF (seq);
+
+	r = ieee1284_pin_program (self->port, ops, n, out);
+	if (r < 0) {
+		handle_error (r);
+		free (ops);
+		free (out);
+		return NULL;
+	}
+
+	for (i = 0; i < r; i++)
+		if (ops[i].op == P1284_READ_DATA ||
+		    ops[i].op == P1284_READ_STATUS)
+			nout++;
+
+	ret = Py_BuildValue ("(nN)", (Py_ssize_t) r,
+			     PyBytes_FromStringAndSize ((char *) out, nout));
+	free (ops);
+	free (out);
+	return ret;
+}
+
 static PyObject *
 Parport_negotiate (ParportObject *self, PyObject *args)
 {
@@ -430,6 +530,214 @@ Parport_set_timeout (ParportObject *self, PyObject *args)
 	return PyFloat_FromDouble (f);
 }
 
+static const char *stats_call_names[SC1284_CALLS] = {
+	"claim", "release", "get_irq_fd", "clear_irq", "read_data",
+	"write_data", "wait_data", "data_dir", "read_status",
+	"wait_status", "read_control", "write_control", "frob_control",
+	"do_nack_handshake", "pin_program", "negotiate", "terminate",
+	"ecp_fwd_to_rev", "ecp_rev_to_fwd", "nibble_read",
+	"compat_write", "byte_read", "epp_read_data", "epp_write_data",
+	"epp_read_addr", "epp_write_addr", "ecp_read_data",
+	"ecp_write_data", "ecp_read_addr", "ecp_write_addr",
+	"set_timeout"
+};
+
+static int
+stats_set (PyObject *dict, const char *key, PyObject *value)
+{
+	int r;
+	if (!value)
+		return -1;
+	r = PyDict_SetItemString (dict, key, value);
+	Py_DECREF (value);
+	return r;
+}
+
+static PyObject *
+Parport_get_stats (ParportObject *self)
+{
+	struct ieee1284_stats st;
+	PyObject *dict, *calls, *bytes, *events;
+	int i, r = ieee1284_get_stats (self->port, &st);
+	if (r < 0) {
+		handle_error (r);
+		return NULL;
+	}
+
+	dict = PyDict_New ();
+	calls = PyDict_New ();
+	bytes = PyDict_New ();
+	events = PyDict_New ();
+	if (!dict || !calls || !bytes || !events)
+		goto fail;
+
+	for (i = 0; i < SC1284_CALLS; i++) {
+		const char *name = stats_call_names[i];
+		if (st.calls[i] &&
+		    stats_set (calls, name,
+			       PyLong_FromUnsignedLong (st.calls[i])))
+			goto fail;
+		if (st.bytes[i] &&
+		    stats_set (bytes, name,
+			       PyLong_FromUnsignedLong (st.bytes[i])))
+			goto fail;
+	}
+
+	for (i = 0; i < IEEE1284_EVENTS; i++) {
+		PyObject *key, *value;
+		if (!st.event_timeouts[i])
+			continue;
+		key = PyLong_FromLong (i);
+		value = PyLong_FromUnsignedLong (st.event_timeouts[i]);
+		r = (key && value) ? PyDict_SetItem (events, key, value) : -1;
+		Py_XDECREF (key);
+		Py_XDECREF (value);
+		if (r)
+			goto fail;
+	}
+
+#define STAT(x) \
+	if (stats_set (dict, #x, PyLong_FromUnsignedLong (st.x))) \
+		goto fail
+	STAT(syscalls);
+	STAT(wait_reads);
+	STAT(timeouts);
+	STAT(stalls);
+	STAT(negotiations);
+	STAT(negotiations_failed);
+	STAT(terminations);
+	STAT(turnarounds);
+	STAT(writes_skipped);
+#undef STAT
+	if (stats_set (dict, "poll_time",
+		       PyFloat_FromDouble (st.poll_time.tv_sec +
+					   st.poll_time.tv_usec / 1e6)) ||
+	    stats_set (dict, "sleep_time",
+		       PyFloat_FromDouble (st.sleep_time.tv_sec +
+					   st.sleep_time.tv_usec / 1e6)) ||
+	    PyDict_SetItemString (dict, "calls", calls) ||
+	    PyDict_SetItemString (dict, "bytes", bytes) ||
+	    PyDict_SetItemString (dict, "event_timeouts", events))
+		goto fail;
+
+	Py_DECREF (calls);
+	Py_DECREF (bytes);
+	Py_DECREF (events);
+	return dict;
+
+fail:
+	Py_XDECREF (dict);
+	Py_XDECREF (calls);
+	Py_XDECREF (bytes);
+	Py_XDECREF (events);
+	return NULL;
+}
+
+static PyObject *
+Parport_reset_stats (ParportObject *self)
+{
+	ieee1284_reset_stats (self->port);
+	Py_INCREF (Py_None);
+	return Py_None;
+}
+
+static PyObject *
+Parport_get_latency (ParportObject *self, PyObject *args)
+{
+	struct ieee1284_latency lat;
+	PyObject *dict, *buckets;
+	int event = -1;
+	int i, r;
+	if (!PyArg_ParseTuple (args, "|i", &event))
+		return NULL;
+
+	r = ieee1284_get_latency (self->port, event, &lat);
+	if (r < 0) {
+		handle_error (r);
+		return NULL;
+	}
+
+	dict = PyDict_New ();
+	buckets = PyList_New (0);
+	if (!dict || !buckets)
+		goto fail;
+
+	for (i = 0; i < IEEE1284_LATENCY_BUCKETS; i++) {
+		PyObject *item;
+		if (!lat.count[i])
+			continue;
+		item = Py_BuildValue ("(dk)", ieee1284_latency_bucket (i),
+				      lat.count[i]);
+		r = item ? PyList_Append (buckets, item) : -1;
+		Py_XDECREF (item);
+		if (r)
+			goto fail;
+	}
+
+	if (stats_set (dict, "waits", PyLong_FromUnsignedLong (lat.waits)) ||
+	    stats_set (dict, "timeouts",
+		       PyLong_FromUnsignedLong (lat.timeouts)) ||
+	    PyDict_SetItemString (dict, "buckets", buckets))
+		goto fail;
+
+	Py_DECREF (buckets);
+	return dict;
+
+fail:
+	Py_XDECREF (dict);
+	Py_XDECREF (buckets);
+	return NULL;
+}
+
+static PyObject *
+Parport_read_trace (ParportObject *self)
+{
+	char buffer[8192];
+	ssize_t r = ieee1284_read_trace (self->port, buffer, sizeof (buffer));
+	if (r < 0) {
+		handle_error (r);
+		return NULL;
+	}
+
+	return PyBytes_FromStringAndSize (buffer, r);
+}
+
+static PyObject *
+Parport_capture_start (ParportObject *self, PyObject *args)
+{
+	int samples = 0;
+	int r;
+	if (!PyArg_ParseTuple (args, "|i", &samples))
+		return NULL;
+
+	r = ieee1284_capture_start (self->port, samples);
+	if (r < 0) {
+		handle_error (r);
+		return NULL;
+	}
+
+	Py_INCREF (Py_None);
+	return Py_None;
+}
+
+static PyObject *
+Parport_capture_stop (ParportObject *self, PyObject *args)
+{
+	const char *vcd_file = NULL;
+	int r;
+	if (!PyArg_ParseTuple (args, "|z", &vcd_file))
+		return NULL;
+
+	r = ieee1284_capture_stop (self->port, vcd_file);
+	if (r < 0) {
+		handle_error (r);
+		return NULL;
+	}
+
+	Py_INCREF (Py_None);
+	return Py_None;
+}
+
 #define READ_FUNCTION(x)					\
 static PyObject *						\
 Parport_##x (ParportObject *self, PyObject *args)		\
@@ -513,6 +821,13 @@ PyMethodDef Parport_methods[] = {
 	{ "get_irq_fd", (PyCFunction) Parport_get_irq_fd, METH_VARARGS,
 	  "get_irq_fd() -> int\n"
 	  "Returns a pollable IRQ file descriptor." },
+	{ "get_poll_fd", (PyCFunction) Parport_get_poll_fd, METH_VARARGS,
+	  "get_poll_fd(events) -> int\n"
+	  "Returns a file descriptor that polls readable when any of\n"
+	  "the POLL1284_* events may be pending." },
+	{ "poll_events", (PyCFunction) Parport_poll_events, METH_NOARGS,
+	  "poll_events() -> int\n"
+	  "Returns the POLL1284_* events pending on the port." },
 	{ "clear_irq", (PyCFunction) Parport_clear_irq, METH_NOARGS,
 	  "clear_irq(portcount) -> int\n"
 	  "Clears IRQ and returns number of IRQs raised." },
@@ -547,6 +862,10 @@ PyMethodDef Parport_methods[] = {
 	{ "frob_control", (PyCFunction) Parport_frob_control, METH_VARARGS,
 	  "frob_control(mask,val) -> None\n"
 	  "Frobnicates the values on the data lines." },
+	{ "pin_program", (PyCFunction) Parport_pin_program, METH_VARARGS,
+	  "pin_program(ops) -> (int, string)\n"
+	  "Runs a sequence of (op[,mask,val,usec]) pin operations, and\n"
+	  "returns how many completed and the values read." },
 	{ "negotiate", (PyCFunction) Parport_negotiate, METH_VARARGS,
 	  "negotiate(mode) -> None\n"
 	  "Negotiates to the desired IEEE 1284 transer mode." },
@@ -562,6 +881,26 @@ PyMethodDef Parport_methods[] = {
 	{ "set_timeout", (PyCFunction) Parport_set_timeout, METH_VARARGS,
 	  "set_timeout(float) -> float\n"
 	  "Sets transfer timeout, in seconds.  Returns old timeout value." },
+	{ "get_stats", (PyCFunction) Parport_get_stats, METH_NOARGS,
+	  "get_stats() -> dict\n"
+	  "Returns the port's performance counters." },
+	{ "reset_stats", (PyCFunction) Parport_reset_stats, METH_NOARGS,
+	  "reset_stats() -> None\n"
+	  "Sets the port's performance counters back to zero." },
+	{ "get_latency", (PyCFunction) Parport_get_latency, METH_VARARGS,
+	  "get_latency([event]) -> dict\n"
+	  "Returns the response latency histogram for an IEEE 1284 event:\n"
+	  "the waits answered and timed out, and (nanoseconds, count) for\n"
+	  "each bucket in use." },
+	{ "read_trace", (PyCFunction) Parport_read_trace, METH_NOARGS,
+	  "read_trace() -> string\n"
+	  "Takes trace records from the port's ring, as lines of text." },
+	{ "capture_start", (PyCFunction) Parport_capture_start, METH_VARARGS,
+	  "capture_start([samples]) -> None\n"
+	  "Starts recording changes on the port's lines." },
+	{ "capture_stop", (PyCFunction) Parport_capture_stop, METH_VARARGS,
+	  "capture_stop([filename]) -> None\n"
+	  "Stops recording, and writes what was recorded as a VCD file." },
 READ_METHOD(nibble_read)
 READ_METHOD(byte_read)
 READ_METHOD(epp_read_data)
@@ -720,6 +1059,9 @@ PyInit_ieee1284module (void)
 
 	CONSTANT (F1284_FRESH);
 	CONSTANT (F1284_EXCL);
+	CONSTANT (F1284_NOPAUSE);
+	CONSTANT (F1284_DIRECTIO);
+	CONSTANT (F1284_REALTIME);
 	CONSTANT (CAP1284_RAW);
 	CONSTANT (CAP1284_NIBBLE);
 	CONSTANT (CAP1284_BYTE);
@@ -760,6 +1102,16 @@ PyInit_ieee1284module (void)
 	CONSTANT (F1284_SWE);
 	CONSTANT (F1284_RLE);
 	CONSTANT (F1284_FASTEPP);
+	CONSTANT (P1284_WRITE_DATA);
+	CONSTANT (P1284_FROB_CONTROL);
+	CONSTANT (P1284_DATA_DIR);
+	CONSTANT (P1284_WAIT_STATUS);
+	CONSTANT (P1284_READ_DATA);
+	CONSTANT (P1284_READ_STATUS);
+	CONSTANT (P1284_DELAY);
+	CONSTANT (POLL1284_DATA_AVAIL);
+	CONSTANT (POLL1284_WRITE_READY);
+	CONSTANT (POLL1284_STATUS_CHANGED);
 	
 	return m;
 }
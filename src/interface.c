@@ -17,12 +17,29 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include "config.h"
+
+#include <string.h>
+
 #include "ieee1284.h"
+#include "async.h"
+#include "capture.h"
 #include "debug.h"
 #include "detect.h"
+#include "probes.h"
+#include "ready.h"
+#include "rt.h"
+#include "shadow.h"
+#include "stats.h"
+#include "thread.h"
+#include "trace.h"
 
 /* ieee1284_open is in state.c */
 
+/* Each function here fires a probe named after it on entry, with the
+ * port's name and its arguments, and another on return, with the
+ * port's name and what it returns.  See probes.h. */
+
 static const char *needs_open_port = \
 "%s called for port that wasn't opened (use ieee1284_open first)\n";
 static const char *needs_claimed_port = \
@@ -32,24 +49,33 @@ int
 ieee1284_ref (struct parport *port)
 {
   struct parport_internal *priv = port->priv;
-  return ++priv->ref;
+  int ref;
+  PROBE1 (ref_entry, port->name);
+  ref = add_fetch (&priv->ref, 1);
+  PROBE2 (ref_return, port->name, ref);
+  return ref;
 }
 
 int
 ieee1284_unref (struct parport *port)
 {
   struct parport_internal *priv = port->priv;
-  if (priv->opened && priv->ref == 1)
+  PROBE1 (unref_entry, port->name);
+  if (priv->opened && load_acquire (&priv->ref) == 1)
     {
       int ret;
       debugprintf ("ieee1284_unref called for last reference to open port!\n");
       ret = ieee1284_close (port);
       if (ret == E1284_OK)
+	/* That freed the port: close_return was the last probe. */
 	return 0;
 
+      PROBE2 (unref_return, port->name, 1);
       return 1;
     }
 
+  /* The port may be freed, so this comes first. */
+  PROBE2 (unref_return, port->name, load_relaxed (&priv->ref) - 1);
   return deref_port (port);
 }
 
@@ -57,14 +83,24 @@ int
 ieee1284_close (struct parport *port)
 {
   struct parport_internal *priv = port->priv;
+  PROBE1 (close_entry, port->name);
   if (!priv->opened)
     {
       debugprintf (needs_open_port, "ieee1284_close");
+      PROBE2 (close_return, port->name, E1284_INVALIDPORT);
       return E1284_INVALIDPORT;
     }
+  debugprintf ("%lu redundant pin writes skipped\n", priv->shadow.skipped);
+  async_cleanup (priv);
+  ready_cleanup (priv);
   if (priv->fn->cleanup)
     priv->fn->cleanup (priv);
+  rt_close (priv);
+  capture_cleanup (priv);
+  trace_cleanup (priv);
+  stats_cleanup (priv);
   priv->opened = 0;
+  PROBE2 (close_return, port->name, E1284_OK);
   deref_port (port);
   return E1284_OK;
 }
@@ -75,24 +111,34 @@ ieee1284_claim (struct parport *port)
   int ret = E1284_OK;
   struct parport_internal *priv = port->priv;
 
+  priv->stats.c.calls[SC1284_CLAIM]++;
+  PROBE1 (claim_entry, port->name);
+
   if (!priv->opened)
     {
       debugprintf (needs_open_port, "ieee1284_claim");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
-
-  if (priv->claimed)
+  else if (priv->claimed)
     {
       debugprintf ("ieee1284_claim called for a port already claimed\n");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    {
+      if (priv->fn->claim)
+	ret = priv->fn->claim (priv);
 
-  if (priv->fn->claim)
-    ret = priv->fn->claim (priv);
-
-  if (ret == E1284_OK)
-    priv->claimed = 1;
+      if (ret == E1284_OK)
+	{
+	  /* Someone else may have had the lines meanwhile. */
+	  shadow_invalidate (priv);
+	  priv->claimed = 1;
+	  rt_enter (priv);
+	}
+    }
 
+  PROBE2 (claim_return, port->name, ret);
   return ret;
 }
 
@@ -102,14 +148,18 @@ ieee1284_get_irq_fd (struct parport *port)
   int ret = E1284_NOTAVAIL;
   struct parport_internal *priv = port->priv;
 
+  priv->stats.c.calls[SC1284_GET_IRQ_FD]++;
+  PROBE1 (get_irq_fd_entry, port->name);
+
   if (!priv->opened)
     {
       debugprintf (needs_open_port, "ieee1284_get_irq_fd");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
-
-  if (priv->fn->get_irq_fd)
+  else if (priv->fn->get_irq_fd)
     ret = priv->fn->get_irq_fd (priv);
+
+  PROBE2 (get_irq_fd_return, port->name, ret);
   return ret;
 }
 
@@ -119,17 +169,61 @@ ieee1284_clear_irq (struct parport *port, unsigned int *count)
   int ret = E1284_NOTAVAIL;
   struct parport_internal *priv = port->priv;
 
+  priv->stats.c.calls[SC1284_CLEAR_IRQ]++;
+  PROBE1 (clear_irq_entry, port->name);
+
   if (priv->fn->clear_irq)
     {
       if (!priv->claimed)
 	{
 	  debugprintf (needs_claimed_port, "ieee1284_clear_irq");
-	  return E1284_INVALIDPORT;
+	  ret = E1284_INVALIDPORT;
 	}
+      else
+	ret = priv->fn->clear_irq (priv, count);
+    }
 
-      ret = priv->fn->clear_irq (priv, count);
+  PROBE2 (clear_irq_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_get_poll_fd (struct parport *port, int events)
+{
+  struct parport_internal *priv = port->priv;
+  int ret;
+
+  PROBE2 (get_poll_fd_entry, port->name, events);
+
+  if (!priv->claimed)
+    {
+      debugprintf (needs_claimed_port, "ieee1284_get_poll_fd");
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = ready_get_fd (priv, events);
 
+  PROBE2 (get_poll_fd_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_poll_events (struct parport *port)
+{
+  struct parport_internal *priv = port->priv;
+  int ret;
+
+  PROBE1 (poll_events_entry, port->name);
+
+  if (!priv->claimed)
+    {
+      debugprintf (needs_claimed_port, "ieee1284_poll_events");
+      ret = E1284_INVALIDPORT;
+    }
+  else
+    ret = ready_poll (priv);
+
+  PROBE2 (poll_events_return, port->name, ret);
   return ret;
 }
 
@@ -137,9 +231,17 @@ void
 ieee1284_release (struct parport *port)
 {
   struct parport_internal *priv = port->priv;
+
+  priv->stats.c.calls[SC1284_RELEASE]++;
+  PROBE1 (release_entry, port->name);
+
   if (priv->claimed && priv->fn->release)
     priv->fn->release (priv);
+  if (priv->claimed)
+    rt_leave (priv);
   priv->claimed = 0;
+
+  PROBE1 (release_return, port->name);
 }
 
 int
@@ -148,15 +250,18 @@ ieee1284_read_data (struct parport *port)
   int ret = -E1284_NOTAVAIL;
   struct parport_internal *priv = port->priv;
 
+  priv->stats.c.calls[SC1284_READ_DATA]++;
+  PROBE1 (read_data_entry, port->name);
+
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_read_data");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
-
-  if (priv->fn->read_data)
+  else if (priv->fn->read_data)
     ret = priv->fn->read_data (priv);
 
+  PROBE2 (read_data_return, port->name, ret);
   return ret;
 }
 
@@ -164,10 +269,16 @@ void
 ieee1284_write_data (struct parport *port, unsigned char st)
 {
   struct parport_internal *priv = port->priv;
+
+  priv->stats.c.calls[SC1284_WRITE_DATA]++;
+  PROBE2 (write_data_entry, port->name, st);
+
   if (priv->claimed)
     priv->fn->write_data (priv, st);
   else
     debugprintf (needs_claimed_port, "ieee1284_write_data");
+
+  PROBE1 (write_data_return, port->name);
 }
 
 int
@@ -177,14 +288,21 @@ ieee1284_wait_data (struct parport *port,
 		    struct timeval *timeout)
 {
   struct parport_internal *priv = port->priv;
+  int ret;
+
+  priv->stats.c.calls[SC1284_WAIT_DATA]++;
+  PROBE3 (wait_data_entry, port->name, mask, val);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_wait_data");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = priv->fn->wait_data (priv, mask, val, timeout);
 
-  return priv->fn->wait_data (priv, mask, val, timeout);
+  PROBE2 (wait_data_return, port->name, ret);
+  return ret;
 }
 
 int
@@ -193,15 +311,18 @@ ieee1284_data_dir (struct parport *port, int reverse)
   int ret = E1284_NOTAVAIL;
   struct parport_internal *priv = port->priv;
 
+  priv->stats.c.calls[SC1284_DATA_DIR]++;
+  PROBE2 (data_dir_entry, port->name, reverse);
+
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_data_dir");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
-
-  if (priv->fn->data_dir)
+  else if (priv->fn->data_dir)
     ret = priv->fn->data_dir (priv, reverse);
 
+  PROBE2 (data_dir_return, port->name, ret);
   return ret;
 }
 
@@ -209,14 +330,21 @@ int
 ieee1284_read_status (struct parport *port)
 {
   struct parport_internal *priv = port->priv;
+  int ret;
+
+  priv->stats.c.calls[SC1284_READ_STATUS]++;
+  PROBE1 (read_status_entry, port->name);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_read_status");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = priv->fn->read_status (priv);
 
-  return priv->fn->read_status (priv);
+  PROBE2 (read_status_return, port->name, ret);
+  return ret;
 }
 
 int
@@ -226,38 +354,58 @@ ieee1284_wait_status (struct parport *port,
 		      struct timeval *timeout)
 {
   struct parport_internal *priv = port->priv;
+  int ret;
+
+  priv->stats.c.calls[SC1284_WAIT_STATUS]++;
+  PROBE3 (wait_status_entry, port->name, mask, val);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_wait_status");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = priv->fn->wait_status (priv, mask, val, timeout);
 
-  return priv->fn->wait_status (priv, mask, val, timeout);
+  PROBE2 (wait_status_return, port->name, ret);
+  return ret;
 }
 
 int
 ieee1284_read_control (struct parport *port)
 {
   struct parport_internal *priv = port->priv;
+  int ret;
+
+  priv->stats.c.calls[SC1284_READ_CONTROL]++;
+  PROBE1 (read_control_entry, port->name);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_read_control");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = priv->fn->read_control (priv);
 
-  return priv->fn->read_control (priv);
+  PROBE2 (read_control_return, port->name, ret);
+  return ret;
 }
 
 void
 ieee1284_write_control (struct parport *port, unsigned char ct)
 {
   struct parport_internal *priv = port->priv;
+
+  priv->stats.c.calls[SC1284_WRITE_CONTROL]++;
+  PROBE2 (write_control_entry, port->name, ct);
+
   if (priv->claimed)
     priv->fn->write_control (priv, ct);
   else
     debugprintf (needs_claimed_port, "ieee1284_write_control");
+
+  PROBE1 (write_control_return, port->name);
 }
 
 void
@@ -266,10 +414,15 @@ ieee1284_frob_control (struct parport *port, unsigned char mask,
 {
   struct parport_internal *priv = port->priv;
 
+  priv->stats.c.calls[SC1284_FROB_CONTROL]++;
+  PROBE3 (frob_control_entry, port->name, mask, val);
+
   if (priv->claimed)
     priv->fn->frob_control (priv, mask, val);
   else
     debugprintf (needs_claimed_port, "ieee1284_frob_control");
+
+  PROBE1 (frob_control_return, port->name);
 }
 
 int
@@ -279,66 +432,123 @@ ieee1284_do_nack_handshake (struct parport *port,
 			    struct timeval *timeout)
 {
   struct parport_internal *priv = port->priv;
+  int ret;
+
+  priv->stats.c.calls[SC1284_DO_NACK_HANDSHAKE]++;
+  PROBE3 (do_nack_handshake_entry, port->name, ct_before, ct_after);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_do_nack_handshake");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
+    }
+  else
+    ret = priv->fn->do_nack_handshake (priv, ct_before, ct_after, timeout);
+
+  PROBE2 (do_nack_handshake_return, port->name, ret);
+  return ret;
+}
+
+ssize_t
+ieee1284_pin_program (struct parport *port,
+		      const struct ieee1284_pin_op *ops, size_t nops,
+		      unsigned char *out)
+{
+  struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_PIN_PROGRAM]++;
+  PROBE2 (pin_program_entry, port->name, nops);
+
+  if (!priv->claimed)
+    {
+      debugprintf (needs_claimed_port, "ieee1284_pin_program");
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = priv->fn->pin_program (priv, ops, nops, out);
 
-  return priv->fn->do_nack_handshake (priv, ct_before, ct_after, timeout);
+  PROBE2 (pin_program_return, port->name, ret);
+  return ret;
 }
 
 int
 ieee1284_negotiate (struct parport *port, int mode)
 {
   struct parport_internal *priv = port->priv;
+  int ret;
+
+  priv->stats.c.calls[SC1284_NEGOTIATE]++;
+  PROBE2 (negotiate_entry, port->name, mode);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_negotiate");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = priv->fn->negotiate (priv, mode);
 
-  return priv->fn->negotiate (priv, mode);
+  PROBE2 (negotiate_return, port->name, ret);
+  return ret;
 }
 
 void
 ieee1284_terminate (struct parport *port)
 {
   struct parport_internal *priv = port->priv;
+
+  priv->stats.c.calls[SC1284_TERMINATE]++;
+  PROBE1 (terminate_entry, port->name);
+
   if (priv->claimed)
     priv->fn->terminate (priv);
   else
     debugprintf (needs_claimed_port, "ieee1284_terminate");
+
+  PROBE1 (terminate_return, port->name);
 }
 
 int
 ieee1284_ecp_fwd_to_rev (struct parport *port)
 {
   struct parport_internal *priv = port->priv;
+  int ret;
+
+  priv->stats.c.calls[SC1284_ECP_FWD_TO_REV]++;
+  PROBE1 (ecp_fwd_to_rev_entry, port->name);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_ecp_fwd_to_rev");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = priv->fn->ecp_fwd_to_rev (priv);
 
-  return priv->fn->ecp_fwd_to_rev (priv);
+  PROBE2 (ecp_fwd_to_rev_return, port->name, ret);
+  return ret;
 }
 
 int
 ieee1284_ecp_rev_to_fwd (struct parport *port)
 {
   struct parport_internal *priv = port->priv;
+  int ret;
+
+  priv->stats.c.calls[SC1284_ECP_REV_TO_FWD]++;
+  PROBE1 (ecp_rev_to_fwd_entry, port->name);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_ecp_rev_to_fwd");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = priv->fn->ecp_rev_to_fwd (priv);
 
-  return priv->fn->ecp_rev_to_fwd (priv);
+  PROBE2 (ecp_rev_to_fwd_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -346,14 +556,22 @@ ieee1284_nibble_read (struct parport *port, int flags,
 		      char *buffer, size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_NIBBLE_READ]++;
+  PROBE3 (nibble_read_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_nibble_read");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_NIBBLE_READ,
+			  priv->fn->nibble_read (priv, flags, buffer, len));
 
-  return priv->fn->nibble_read (priv, flags, buffer, len);
+  PROBE2 (nibble_read_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -361,14 +579,22 @@ ieee1284_compat_write (struct parport *port, int flags,
 		       const char *buffer, size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_COMPAT_WRITE]++;
+  PROBE3 (compat_write_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_compat_write");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_COMPAT_WRITE,
+			  priv->fn->compat_write (priv, flags, buffer, len));
 
-  return priv->fn->compat_write (priv, flags, buffer, len);
+  PROBE2 (compat_write_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -376,14 +602,22 @@ ieee1284_byte_read (struct parport *port, int flags,
 		    char *buffer, size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_BYTE_READ]++;
+  PROBE3 (byte_read_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_byte_read");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_BYTE_READ,
+			  priv->fn->byte_read (priv, flags, buffer, len));
 
-  return priv->fn->byte_read (priv, flags, buffer, len);
+  PROBE2 (byte_read_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -391,14 +625,22 @@ ieee1284_epp_read_data (struct parport *port, int flags, char *buffer,
 			size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_EPP_READ_DATA]++;
+  PROBE3 (epp_read_data_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_epp_read_data");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_EPP_READ_DATA,
+			  priv->fn->epp_read_data (priv, flags, buffer, len));
 
-  return priv->fn->epp_read_data (priv, flags, buffer, len);
+  PROBE2 (epp_read_data_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -406,14 +648,22 @@ ieee1284_epp_write_data (struct parport *port, int flags,
 			 const char *buffer, size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_EPP_WRITE_DATA]++;
+  PROBE3 (epp_write_data_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_epp_write_data");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_EPP_WRITE_DATA,
+			  priv->fn->epp_write_data (priv, flags, buffer, len));
 
-  return priv->fn->epp_write_data (priv, flags, buffer, len);
+  PROBE2 (epp_write_data_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -421,14 +671,22 @@ ieee1284_epp_read_addr (struct parport *port, int flags, char *buffer,
 			size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_EPP_READ_ADDR]++;
+  PROBE3 (epp_read_addr_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_epp_read_addr");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_EPP_READ_ADDR,
+			  priv->fn->epp_read_addr (priv, flags, buffer, len));
 
-  return priv->fn->epp_read_addr (priv, flags, buffer, len);
+  PROBE2 (epp_read_addr_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -436,14 +694,22 @@ ieee1284_epp_write_addr (struct parport *port, int flags,
 			 const char *buffer, size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_EPP_WRITE_ADDR]++;
+  PROBE3 (epp_write_addr_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_epp_write_addr");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_EPP_WRITE_ADDR,
+			  priv->fn->epp_write_addr (priv, flags, buffer, len));
 
-  return priv->fn->epp_write_addr (priv, flags, buffer, len);
+  PROBE2 (epp_write_addr_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -451,14 +717,22 @@ ieee1284_ecp_read_data (struct parport *port, int flags, char *buffer,
 			size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_ECP_READ_DATA]++;
+  PROBE3 (ecp_read_data_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_ecp_read_data");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_ECP_READ_DATA,
+			  priv->fn->ecp_read_data (priv, flags, buffer, len));
 
-  return priv->fn->ecp_read_data (priv, flags, buffer, len);
+  PROBE2 (ecp_read_data_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -466,14 +740,22 @@ ieee1284_ecp_write_data (struct parport *port, int flags,
 			 const char *buffer, size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_ECP_WRITE_DATA]++;
+  PROBE3 (ecp_write_data_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_ecp_write_data");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_ECP_WRITE_DATA,
+			  priv->fn->ecp_write_data (priv, flags, buffer, len));
 
-  return priv->fn->ecp_write_data (priv, flags, buffer, len);
+  PROBE2 (ecp_write_data_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -481,14 +763,22 @@ ieee1284_ecp_read_addr (struct parport *port, int flags,
 			char *buffer, size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_ECP_READ_ADDR]++;
+  PROBE3 (ecp_read_addr_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_ecp_read_addr");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_ECP_READ_ADDR,
+			  priv->fn->ecp_read_addr (priv, flags, buffer, len));
 
-  return priv->fn->ecp_read_addr (priv, flags, buffer, len);
+  PROBE2 (ecp_read_addr_return, port->name, ret);
+  return ret;
 }
 
 ssize_t
@@ -496,21 +786,386 @@ ieee1284_ecp_write_addr (struct parport *port, int flags,
 			 const char *buffer, size_t len)
 {
   struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  priv->stats.c.calls[SC1284_ECP_WRITE_ADDR]++;
+  PROBE3 (ecp_write_addr_entry, port->name, flags, len);
 
   if (!priv->claimed)
     {
       debugprintf (needs_claimed_port, "ieee1284_ecp_write_addr");
-      return E1284_INVALIDPORT;
+      ret = E1284_INVALIDPORT;
     }
+  else
+    ret = stats_transfer (priv, SC1284_ECP_WRITE_ADDR,
+			  priv->fn->ecp_write_addr (priv, flags, buffer, len));
 
-  return priv->fn->ecp_write_addr (priv, flags, buffer, len);
+  PROBE2 (ecp_write_addr_return, port->name, ret);
+  return ret;
 }
 
 struct timeval *
 ieee1284_set_timeout (struct parport *port, struct timeval *timeout)
 {
   struct parport_internal *priv = port->priv;
-  return priv->fn->set_timeout (priv, timeout);
+  struct timeval *ret;
+
+  priv->stats.c.calls[SC1284_SET_TIMEOUT]++;
+  PROBE2 (set_timeout_entry, port->name, timeout);
+
+  ret = priv->fn->set_timeout (priv, timeout);
+
+  PROBE2 (set_timeout_return, port->name, ret);
+  return ret;
+}
+
+/* The submit functions queue the transfer for async.c, which makes
+ * it with the function above. */
+static int
+submit (struct parport *port, const char *func, int call, int flags,
+	void *buffer, size_t len, ieee1284_callback callback, void *data)
+{
+  struct parport_internal *priv = port->priv;
+
+  if (!priv->claimed)
+    {
+      debugprintf (needs_claimed_port, func);
+      return E1284_INVALIDPORT;
+    }
+
+  return async_submit (port, call, flags, buffer, len, callback, data);
+}
+
+int
+ieee1284_submit_nibble_read (struct parport *port, int flags,
+			     char *buffer, size_t len,
+			     ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_nibble_read_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_nibble_read", SC1284_NIBBLE_READ,
+		flags, buffer, len, callback, data);
+  PROBE2 (submit_nibble_read_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_compat_write (struct parport *port, int flags,
+			      const char *buffer, size_t len,
+			      ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_compat_write_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_compat_write", SC1284_COMPAT_WRITE,
+		flags, (char *) buffer, len, callback, data);
+  PROBE2 (submit_compat_write_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_byte_read (struct parport *port, int flags,
+			   char *buffer, size_t len,
+			   ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_byte_read_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_byte_read", SC1284_BYTE_READ,
+		flags, buffer, len, callback, data);
+  PROBE2 (submit_byte_read_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_epp_read_data (struct parport *port, int flags,
+			       char *buffer, size_t len,
+			       ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_epp_read_data_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_epp_read_data", SC1284_EPP_READ_DATA,
+		flags, buffer, len, callback, data);
+  PROBE2 (submit_epp_read_data_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_epp_write_data (struct parport *port, int flags,
+				const char *buffer, size_t len,
+				ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_epp_write_data_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_epp_write_data", SC1284_EPP_WRITE_DATA,
+		flags, (char *) buffer, len, callback, data);
+  PROBE2 (submit_epp_write_data_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_epp_read_addr (struct parport *port, int flags,
+			       char *buffer, size_t len,
+			       ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_epp_read_addr_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_epp_read_addr", SC1284_EPP_READ_ADDR,
+		flags, buffer, len, callback, data);
+  PROBE2 (submit_epp_read_addr_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_epp_write_addr (struct parport *port, int flags,
+				const char *buffer, size_t len,
+				ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_epp_write_addr_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_epp_write_addr", SC1284_EPP_WRITE_ADDR,
+		flags, (char *) buffer, len, callback, data);
+  PROBE2 (submit_epp_write_addr_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_ecp_read_data (struct parport *port, int flags,
+			       char *buffer, size_t len,
+			       ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_ecp_read_data_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_ecp_read_data", SC1284_ECP_READ_DATA,
+		flags, buffer, len, callback, data);
+  PROBE2 (submit_ecp_read_data_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_ecp_write_data (struct parport *port, int flags,
+				const char *buffer, size_t len,
+				ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_ecp_write_data_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_ecp_write_data", SC1284_ECP_WRITE_DATA,
+		flags, (char *) buffer, len, callback, data);
+  PROBE2 (submit_ecp_write_data_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_ecp_read_addr (struct parport *port, int flags,
+			       char *buffer, size_t len,
+			       ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_ecp_read_addr_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_ecp_read_addr", SC1284_ECP_READ_ADDR,
+		flags, buffer, len, callback, data);
+  PROBE2 (submit_ecp_read_addr_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_submit_ecp_write_addr (struct parport *port, int flags,
+				const char *buffer, size_t len,
+				ieee1284_callback callback, void *data)
+{
+  int ret;
+
+  PROBE3 (submit_ecp_write_addr_entry, port->name, flags, len);
+  ret = submit (port, "ieee1284_submit_ecp_write_addr", SC1284_ECP_WRITE_ADDR,
+		flags, (char *) buffer, len, callback, data);
+  PROBE2 (submit_ecp_write_addr_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_cancel (struct parport *port, int id)
+{
+  struct parport_internal *priv = port->priv;
+  int ret;
+
+  PROBE2 (cancel_entry, port->name, id);
+  ret = async_cancel (priv, id);
+  PROBE2 (cancel_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_get_completion_fd (struct parport *port)
+{
+  struct parport_internal *priv = port->priv;
+  int ret;
+
+  PROBE1 (get_completion_fd_entry, port->name);
+
+  if (!priv->opened)
+    {
+      debugprintf (needs_open_port, "ieee1284_get_completion_fd");
+      ret = E1284_INVALIDPORT;
+    }
+  else
+    ret = async_get_fd (port);
+
+  PROBE2 (get_completion_fd_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_reap (struct parport *port, int flags,
+	       struct ieee1284_completion *completion)
+{
+  struct parport_internal *priv = port->priv;
+  int ret;
+
+  PROBE2 (reap_entry, port->name, flags);
+  ret = async_reap (priv, flags, completion);
+  PROBE2 (reap_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_get_stats (struct parport *port, struct ieee1284_stats *stats)
+{
+  struct parport_internal *priv = port->priv;
+
+  PROBE1 (get_stats_entry, port->name);
+
+  if (!priv->opened)
+    {
+      debugprintf (needs_open_port, "ieee1284_get_stats");
+      PROBE2 (get_stats_return, port->name, E1284_INVALIDPORT);
+      return E1284_INVALIDPORT;
+    }
+
+  *stats = priv->stats.c;
+  stats->poll_time.tv_sec = (long) (priv->stats.poll_ns / 1000000000);
+  stats->poll_time.tv_usec = (long) (priv->stats.poll_ns % 1000000000 / 1000);
+  stats->sleep_time.tv_sec = (long) (priv->stats.sleep_ns / 1000000000);
+  stats->sleep_time.tv_usec = (long) (priv->stats.sleep_ns % 1000000000
+				      / 1000);
+  stats->writes_skipped = priv->shadow.skipped;
+  PROBE2 (get_stats_return, port->name, E1284_OK);
+  return E1284_OK;
+}
+
+void
+ieee1284_reset_stats (struct parport *port)
+{
+  struct parport_internal *priv = port->priv;
+
+  PROBE1 (reset_stats_entry, port->name);
+
+  memset (&priv->stats.c, 0, sizeof priv->stats.c);
+  priv->stats.poll_ns = priv->stats.sleep_ns = 0;
+  priv->shadow.skipped = 0;
+  stats_reset_latency (priv);
+
+  PROBE1 (reset_stats_return, port->name);
+}
+
+int
+ieee1284_get_latency (struct parport *port, int event,
+		      struct ieee1284_latency *latency)
+{
+  struct parport_internal *priv = port->priv;
+  int ret = E1284_OK;
+
+  PROBE2 (get_latency_entry, port->name, event);
+
+  if (!priv->opened)
+    {
+      debugprintf (needs_open_port, "ieee1284_get_latency");
+      ret = E1284_INVALIDPORT;
+    }
+  else if (event < -1 || event >= IEEE1284_EVENTS)
+    ret = E1284_NOTAVAIL;
+  else
+    {
+      if (event == -1)
+	event = IEEE1284_EVENTS;
+
+      if (priv->stats.latency[event])
+	*latency = *priv->stats.latency[event];
+      else
+	memset (latency, 0, sizeof *latency);
+    }
+
+  PROBE2 (get_latency_return, port->name, ret);
+  return ret;
+}
+
+ssize_t
+ieee1284_read_trace (struct parport *port, char *buffer, size_t len)
+{
+  struct parport_internal *priv = port->priv;
+  ssize_t ret;
+
+  PROBE2 (read_trace_entry, port->name, len);
+
+  if (!priv->opened)
+    {
+      debugprintf (needs_open_port, "ieee1284_read_trace");
+      ret = E1284_INVALIDPORT;
+    }
+  else if (!priv->trace.ring)
+    ret = E1284_NOTAVAIL;
+  else
+    ret = trace_read (priv, buffer, len);
+
+  PROBE2 (read_trace_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_capture_start (struct parport *port, size_t samples)
+{
+  struct parport_internal *priv = port->priv;
+  int ret;
+
+  PROBE2 (capture_start_entry, port->name, samples);
+
+  if (!priv->opened)
+    {
+      debugprintf (needs_open_port, "ieee1284_capture_start");
+      ret = E1284_INVALIDPORT;
+    }
+  else
+    ret = capture_start (priv, samples);
+
+  PROBE2 (capture_start_return, port->name, ret);
+  return ret;
+}
+
+int
+ieee1284_capture_stop (struct parport *port, const char *vcd_file)
+{
+  struct parport_internal *priv = port->priv;
+  int ret;
+
+  PROBE2 (capture_stop_entry, port->name, vcd_file);
+
+  if (!priv->opened)
+    {
+      debugprintf (needs_open_port, "ieee1284_capture_stop");
+      ret = E1284_INVALIDPORT;
+    }
+  else
+    ret = capture_stop (priv, vcd_file);
+
+  PROBE2 (capture_stop_return, port->name, ret);
+  return ret;
 }
 
 /*
@@ -1,4 +1,4 @@
-/* Redefine inb and outb_p for 95 and OBSD because they don't have sys/io.h */
+/* Redefine inb, outb and outb_p for 95 and OBSD because they don't have sys/io.h */
 
 #ifndef _IO_H
   
@@ -21,6 +21,12 @@ outb_p (unsigned char value, unsigned short int port)
 			"Nd" (port));
 }
 
+static __inline void
+outb (unsigned char value, unsigned short int port)
+{
+  __asm__ __volatile__ ("outb %b0,%w1": :"a" (value), "Nd" (port));
+}
+
 #else
 
 #include <conio.h>
@@ -37,6 +43,12 @@ outb_p (unsigned char value, unsigned short int port)
   outp (port, value);
 }
 
+static __inline void
+outb (unsigned char value, unsigned short int port)
+{
+  outp (port, value);
+}
+
 #endif /* _MSC_VER */
 
 #endif /* _IO_H */
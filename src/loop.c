@@ -0,0 +1,518 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/*
+ * The event loop.  Each port added to a loop has a queue of
+ * transfers, which the loop makes a chunk at a time with
+ * F1284_NONBLOCK, going round the ports in turn so that none holds
+ * up the others for long.  When a port can't take or give any more
+ * (the transfer returns 0 or E1284_TIMEDOUT, or falls short of the
+ * chunk, or the lines say the peripheral isn't ready) the loop
+ * leaves it until its interrupt arrives, seen through epoll on the
+ * ppdev file descriptor, or until a retry time that backs off from
+ * LOOP_BACKOFF_MIN to LOOP_BACKOFF_MAX, for ports with no interrupt.
+ *
+ * A write completes when all of it is written.  A read completes
+ * when the buffer is full or, once something has been read, when the
+ * peripheral has no more to give, as read(2) would.  Completions are
+ * dispatched to their callbacks from ieee1284_loop_run, which is
+ * where a callback would queue the next transfer on its port.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+#include "async.h"
+#include "debug.h"
+#include "delay.h"
+#include "detect.h"
+#include "ieee1284.h"
+#include "ready.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+
+/* Bytes to a chunk. */
+#define LOOP_CHUNK 512
+
+#define LOOP_BACKOFF_MIN 1000000	/* 1ms */
+#define LOOP_BACKOFF_MAX 64000000	/* 64ms */
+
+/* Ports to take interrupts from in one epoll_wait. */
+#define LOOP_EVENTS 64
+
+struct loop_transfer
+{
+  struct loop_transfer *next;
+  struct ieee1284_completion c;
+  int flags;
+  size_t len;
+  size_t done;
+  ieee1284_callback callback;
+};
+
+struct loop_port
+{
+  struct loop_port *next;
+  struct parport *port;
+  int fd;			/* Interrupts arrive here, or -1 */
+  struct loop_transfer *queue, **queue_tail;
+  int ready;			/* Worth trying now */
+  nsec_t retry_at;		/* If not, when to try again */
+  nsec_t backoff;
+  int removed;			/* Removed from a callback */
+};
+
+struct ieee1284_loop
+{
+  int epfd;
+  struct loop_port *ports;
+  int next_id;
+  int running;			/* In ieee1284_loop_run */
+};
+
+static struct loop_port *
+find_port (struct ieee1284_loop *loop, struct parport *port)
+{
+  struct loop_port *lp;
+
+  for (lp = loop->ports; lp; lp = lp->next)
+    if (lp->port == port && !lp->removed)
+      return lp;
+
+  return NULL;
+}
+
+static int
+is_read (int call)
+{
+  switch (call)
+    {
+    case SC1284_NIBBLE_READ:
+    case SC1284_BYTE_READ:
+    case SC1284_EPP_READ_DATA:
+    case SC1284_EPP_READ_ADDR:
+    case SC1284_ECP_READ_DATA:
+    case SC1284_ECP_READ_ADDR:
+      return 1;
+    }
+
+  return 0;
+}
+
+/* Whether the lines say the peripheral can take part in the
+ * transfer.  The software engines don't honour F1284_NONBLOCK, so
+ * this saves them waiting for a peripheral that is plainly busy. */
+static int
+peripheral_ready (struct parport *port, int call)
+{
+  int st;
+
+  if (call != SC1284_COMPAT_WRITE && call != SC1284_NIBBLE_READ)
+    return 1;
+
+  st = ieee1284_read_status (port);
+  if (st < 0)
+    /* Let the transfer say what's wrong. */
+    return 1;
+
+  return ready_events (port->priv, st) & (call == SC1284_COMPAT_WRITE ?
+					  POLL1284_WRITE_READY :
+					  POLL1284_DATA_AVAIL);
+}
+
+static void
+back_off (struct loop_port *lp)
+{
+  lp->ready = 0;
+  if (!lp->backoff)
+    lp->backoff = LOOP_BACKOFF_MIN;
+  else if (lp->backoff < LOOP_BACKOFF_MAX)
+    lp->backoff *= 2;
+  lp->retry_at = monotonic_ns () + lp->backoff;
+}
+
+/* Take the transfer at the head of the port's queue and call its
+ * callback with RESULT. */
+static void
+complete (struct loop_port *lp, ssize_t result)
+{
+  struct loop_transfer *t = lp->queue;
+
+  lp->queue = t->next;
+  if (!lp->queue)
+    lp->queue_tail = &lp->queue;
+
+  t->c.result = result;
+  if (t->callback)
+    t->callback (lp->port, &t->c);
+  free (t);
+}
+
+/* Make one chunk of the transfer at the head of the port's queue.
+ * Returns the number of transfers completed. */
+static int
+step (struct loop_port *lp)
+{
+  struct loop_transfer *t = lp->queue;
+  size_t chunk = t->len - t->done;
+  ssize_t got;
+
+  if (!chunk)
+    {
+      complete (lp, 0);
+      return 1;
+    }
+
+  if (chunk > LOOP_CHUNK)
+    chunk = LOOP_CHUNK;
+
+  if (!peripheral_ready (lp->port, t->c.call))
+    got = 0;
+  else
+    got = async_transfer (lp->port, t->c.call, t->flags | F1284_NONBLOCK,
+			  (char *) t->c.buffer + t->done, chunk);
+
+  if (got > 0)
+    {
+      t->done += got;
+      lp->backoff = 0;
+    }
+
+  if (got >= 0 || got == E1284_TIMEDOUT)
+    {
+      if (t->done == t->len || (got < (ssize_t) chunk && t->done &&
+				is_read (t->c.call)))
+	{
+	  complete (lp, t->done);
+	  lp->ready = 1;
+	  return 1;
+	}
+
+      if (got < (ssize_t) chunk)
+	back_off (lp);
+      else
+	lp->ready = 1;
+      return 0;
+    }
+
+  complete (lp, t->done ? (ssize_t) t->done : got);
+  lp->ready = 1;
+  return 1;
+}
+
+/* Complete each of the port's transfers with what was done of it, or
+ * E1284_CANCELLED. */
+static void
+cancel_all (struct loop_port *lp)
+{
+  while (lp->queue)
+    complete (lp, (lp->queue->done ? (ssize_t) lp->queue->done
+		   : E1284_CANCELLED));
+}
+
+static void
+free_port (struct ieee1284_loop *loop, struct loop_port *lp)
+{
+  if (lp->fd >= 0)
+    epoll_ctl (loop->epfd, EPOLL_CTL_DEL, lp->fd, NULL);
+  ieee1284_unref (lp->port);
+  free (lp);
+}
+
+/* Free the ports removed while running. */
+static void
+purge (struct ieee1284_loop *loop)
+{
+  struct loop_port **p = &loop->ports, *lp;
+
+  while ((lp = *p) != NULL)
+    if (lp->removed)
+      {
+	*p = lp->next;
+	free_port (loop, lp);
+      }
+    else
+      p = &lp->next;
+}
+
+/* Wait up to TIMEOUT_NS for interrupts, and mark the ports that had
+ * them ready. */
+static void
+wait_events (struct ieee1284_loop *loop, nsec_t timeout_ns)
+{
+  struct epoll_event ev[LOOP_EVENTS];
+  int ms = (int) ((timeout_ns + 999999) / 1000000);
+  int i, n;
+
+  n = epoll_wait (loop->epfd, ev, LOOP_EVENTS, ms);
+  for (i = 0; i < n; i++)
+    {
+      struct loop_port *lp = ev[i].data.ptr;
+
+      ieee1284_clear_irq (lp->port, NULL);
+      lp->ready = 1;
+    }
+}
+
+int
+ieee1284_loop_open (struct ieee1284_loop **loop)
+{
+  struct ieee1284_loop *l = malloc (sizeof *l);
+
+  if (!l)
+    return E1284_NOMEM;
+
+  memset (l, 0, sizeof *l);
+  l->next_id = 1;
+  l->epfd = epoll_create (LOOP_EVENTS);
+  if (l->epfd < 0)
+    {
+      debugprintf ("loop: epoll_create: %s\n", strerror (errno));
+      free (l);
+      return E1284_SYS;
+    }
+
+  *loop = l;
+  return E1284_OK;
+}
+
+void
+ieee1284_loop_close (struct ieee1284_loop *loop)
+{
+  struct loop_port *lp;
+
+  while ((lp = loop->ports) != NULL)
+    {
+      loop->ports = lp->next;
+      cancel_all (lp);
+      free_port (loop, lp);
+    }
+
+  close (loop->epfd);
+  free (loop);
+}
+
+int
+ieee1284_loop_add (struct ieee1284_loop *loop, struct parport *port)
+{
+  struct parport_internal *priv = port->priv;
+  struct loop_port *lp;
+  struct epoll_event ev;
+
+  if (!priv->opened || find_port (loop, port))
+    return E1284_INVALIDPORT;
+
+  lp = malloc (sizeof *lp);
+  if (!lp)
+    return E1284_NOMEM;
+
+  memset (lp, 0, sizeof *lp);
+  lp->port = port;
+  lp->queue_tail = &lp->queue;
+  lp->fd = ieee1284_get_irq_fd (port);
+  if (lp->fd >= 0)
+    {
+      memset (&ev, 0, sizeof ev);
+      ev.events = EPOLLIN;
+      ev.data.ptr = lp;
+      if (epoll_ctl (loop->epfd, EPOLL_CTL_ADD, lp->fd, &ev))
+	{
+	  debugprintf ("loop: can't poll %s: %s\n", priv->name,
+		       strerror (errno));
+	  lp->fd = -1;
+	}
+    }
+
+  ieee1284_ref (port);
+  lp->next = loop->ports;
+  loop->ports = lp;
+  return E1284_OK;
+}
+
+int
+ieee1284_loop_remove (struct ieee1284_loop *loop, struct parport *port)
+{
+  struct loop_port **p, *lp = find_port (loop, port);
+
+  if (!lp)
+    return E1284_INVALIDPORT;
+
+  lp->removed = 1;
+  cancel_all (lp);
+  if (loop->running)
+    /* ieee1284_loop_run will free it. */
+    return E1284_OK;
+
+  for (p = &loop->ports; *p != lp; p = &(*p)->next)
+    ;
+  *p = lp->next;
+  free_port (loop, lp);
+  return E1284_OK;
+}
+
+int
+ieee1284_loop_submit (struct ieee1284_loop *loop, struct parport *port,
+		      int call, int flags, void *buffer, size_t len,
+		      ieee1284_callback callback, void *data)
+{
+  struct parport_internal *priv = port->priv;
+  struct loop_port *lp = find_port (loop, port);
+  struct loop_transfer *t;
+
+  if (call < SC1284_NIBBLE_READ || call > SC1284_ECP_WRITE_ADDR)
+    return E1284_NOTIMPL;
+
+  if (!lp || !priv->claimed)
+    return E1284_INVALIDPORT;
+
+  t = malloc (sizeof *t);
+  if (!t)
+    return E1284_NOMEM;
+
+  memset (t, 0, sizeof *t);
+  t->c.id = loop->next_id++;
+  if (loop->next_id <= 0)
+    loop->next_id = 1;
+  t->c.call = call;
+  t->c.buffer = buffer;
+  t->c.data = data;
+  t->flags = flags;
+  t->len = len;
+  t->callback = callback;
+
+  if (!lp->queue)
+    {
+      lp->ready = 1;
+      lp->backoff = 0;
+    }
+
+  *lp->queue_tail = t;
+  lp->queue_tail = &t->next;
+  return t->c.id;
+}
+
+int
+ieee1284_loop_run (struct ieee1284_loop *loop, struct timeval *timeout)
+{
+  nsec_t deadline = timeout ? timeout_deadline (timeout) : 0;
+  struct loop_port *lp;
+  int completed = 0;
+
+  loop->running = 1;
+  for (;;)
+    {
+      nsec_t now, wake = 0;
+      int busy = 0, ready = 0;
+
+      for (lp = loop->ports; lp; lp = lp->next)
+	{
+	  if (lp->removed || !lp->queue)
+	    continue;
+
+	  if (!lp->ready && monotonic_ns () >= lp->retry_at)
+	    lp->ready = 1;
+
+	  if (lp->ready)
+	    completed += step (lp);
+	}
+
+      purge (loop);
+
+      /* What's left to do, and when to look at it again. */
+      for (lp = loop->ports; lp; lp = lp->next)
+	if (lp->queue)
+	  {
+	    busy = 1;
+	    if (lp->ready)
+	      ready = 1;
+	    else if (!wake || lp->retry_at < wake)
+	      wake = lp->retry_at;
+	  }
+
+      now = monotonic_ns ();
+      if (!busy || (timeout && now >= deadline))
+	break;
+
+      if (ready)
+	wake = now;
+      if (timeout && wake > deadline)
+	wake = deadline;
+      wait_events (loop, wake > now ? wake - now : 0);
+    }
+  loop->running = 0;
+
+  return completed;
+}
+
+#else /* !HAVE_SYS_EPOLL_H */
+
+int
+ieee1284_loop_open (struct ieee1284_loop **loop)
+{
+  return E1284_NOTAVAIL;
+}
+
+void
+ieee1284_loop_close (struct ieee1284_loop *loop)
+{
+}
+
+int
+ieee1284_loop_add (struct ieee1284_loop *loop, struct parport *port)
+{
+  return E1284_NOTAVAIL;
+}
+
+int
+ieee1284_loop_remove (struct ieee1284_loop *loop, struct parport *port)
+{
+  return E1284_NOTAVAIL;
+}
+
+int
+ieee1284_loop_submit (struct ieee1284_loop *loop, struct parport *port,
+		      int call, int flags, void *buffer, size_t len,
+		      ieee1284_callback callback, void *data)
+{
+  return E1284_NOTAVAIL;
+}
+
+int
+ieee1284_loop_run (struct ieee1284_loop *loop, struct timeval *timeout)
+{
+  return E1284_NOTAVAIL;
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
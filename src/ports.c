@@ -34,6 +34,7 @@
 #include "ieee1284.h"
 #include "debug.h"
 #include "detect.h"
+#include "thread.h"
 
 #ifdef HAVE_CYGWIN_NT
 #ifdef HAVE_W32API_WINDOWS_H
@@ -121,6 +122,7 @@ add_port (struct parport_list *list, int flags,
   memset (priv->fn, 0, sizeof *priv->fn);
 
   p->priv = priv;
+  priv->name = p->name;
   priv->device = (char *) (p->filename);
 
   if (udevice)
@@ -139,7 +141,7 @@ add_port (struct parport_list *list, int flags,
     }
 
   priv->base = base;
-  priv->base_hi = 0;
+  priv->base_hi = hibase;
   if (interrupt < -1)
     interrupt = -1;
   priv->interrupt = interrupt;
@@ -373,18 +375,42 @@ populate_by_guessing (struct parport_list *list, int flags)
   return 0;
 }
 
+static int
+populate_simulated (struct parport_list *list, int flags)
+{
+  const struct sim_port_config *sim;
+
+  if (!(capabilities & SIM_CAPABLE))
+    return 0;
+
+  for (sim = conf.sim_ports; sim; sim = sim->next)
+    add_port (list, flags, sim->name, "", NULL, sim->base, sim->ecr_base,
+	      -1);
+
+  return 0;
+}
+
+static thread_once_t setup_once = THREAD_ONCE_INIT;
+
+/* What the whole process shares: see thread.h. */
+static void
+setup (void)
+{
+  read_config_file ();
+  detect_environment (0);
+}
+
 /* Find out what ports there are. */
 int
 ieee1284_find_ports (struct parport_list *list, int flags)
 {
-  read_config_file ();
+  thread_once (&setup_once, setup);
 
   list->portc = 0;
   list->portv = malloc (sizeof(char*) * MAX_PORTS);
   if (!list->portv)
     return E1284_NOMEM;
 
-  detect_environment (0);
 #ifdef HAVE_LINUX
   if (capabilities & PROC_SYS_DEV_PARPORT_CAPABLE)
     populate_from_sys_dev_parport (list, flags);
@@ -397,6 +423,8 @@ ieee1284_find_ports (struct parport_list *list, int flags)
   else 
     populate_by_guessing (list, flags);
 
+  populate_simulated (list, flags);
+
   if (list->portc == 0)
     {
       free (list->portv);
@@ -426,7 +454,7 @@ int
 deref_port (struct parport *p)
 {
   struct parport_internal *priv = p->priv;
-  int count = --priv->ref;
+  int count = add_fetch (&priv->ref, -1);
   if (!count)
     {
       debugprintf ("Destructor for port '%s'\n", p->name);
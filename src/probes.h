@@ -0,0 +1,59 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _PROBES_H_
+#define _PROBES_H_
+
+/*
+ * Static probes for perf, bpftrace and SystemTap, under the provider
+ * name libieee1284.  Each is a nop until something attaches to it.
+ * They are built in wherever <sys/sdt.h> is available.
+ *
+ * The first argument of every probe is the port's name.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define PROBE1(name, a) DTRACE_PROBE1 (libieee1284, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2 (libieee1284, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3 (libieee1284, name, a, b, c)
+#define PROBE4(name, a, b, c, d) \
+  DTRACE_PROBE4 (libieee1284, name, a, b, c, d)
+#define PROBE5(name, a, b, c, d, e) \
+  DTRACE_PROBE5 (libieee1284, name, a, b, c, d, e)
+
+#else
+
+#define PROBE1(name, a) ((void) 0)
+#define PROBE2(name, a, b) ((void) 0)
+#define PROBE3(name, a, b, c) ((void) 0)
+#define PROBE4(name, a, b, c, d) ((void) 0)
+#define PROBE5(name, a, b, c, d, e) ((void) 0)
+
+#endif /* HAVE_SYS_SDT_H */
+
+#endif /* _PROBES_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
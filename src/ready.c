@@ -0,0 +1,263 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Readiness.  What the caller polls is an epoll instance holding two
+ * file descriptors: the ppdev one, where the port has an interrupt,
+ * and a timer.  An nAck interrupt makes it readable, which covers
+ * Busy going low after a byte, nibble mode data becoming available
+ * (event 18) and ECP reverse data (event 43).  The timer makes it
+ * readable at once when an event is already true, since nothing
+ * else would, and otherwise runs as a poller every READY_POLL_NS
+ * where there is no interrupt, or to see the error lines change,
+ * which raises no interrupt.
+ *
+ * The lines are only read in ieee1284_poll_events, on the caller's
+ * thread, so a port is still used by one thread at a time.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined HAVE_SYS_EPOLL_H && defined HAVE_SYS_TIMERFD_H
+#define HAVE_READY_FD
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+#include "debug.h"
+#include "detect.h"
+#include "ieee1284.h"
+#include "ready.h"
+
+/* The lines POLL1284_STATUS_CHANGED watches. */
+#define READY_ERROR_LINES (S1284_NFAULT | S1284_SELECT | S1284_PERROR)
+
+/* How often to look at the lines when nothing else will say. */
+#define READY_POLL_NS 10000000	/* 10ms */
+
+int
+ready_events (struct parport_internal *port, int status)
+{
+  int mode = port->current_mode & ~(M1284_FLAG_DEVICEID |
+				    M1284_FLAG_EXT_LINK);
+  int reverse = (port->current_phase == PH1284_REV_IDLE ||
+		 port->current_phase == PH1284_REV_DATA);
+  int events = 0;
+
+  if (!(status & S1284_BUSY))
+    events |= POLL1284_WRITE_READY;
+
+  if (mode & M1284_ECP)
+    {
+      /* Event 43: PeriphClk low. */
+      if (reverse && !(status & S1284_NACK))
+	events |= POLL1284_DATA_AVAIL;
+    }
+  else if (mode == M1284_NIBBLE || mode == M1284_BYTE)
+    {
+      /* nDataAvail low. */
+      if (!(status & S1284_NFAULT))
+	events |= POLL1284_DATA_AVAIL;
+    }
+
+  return events;
+}
+
+#ifdef HAVE_READY_FD
+
+struct ready_state
+{
+  int epfd;			/* What the caller polls */
+  int timerfd;
+  int irqfd;			/* In epfd too, or -1 */
+  int events;			/* Asked for */
+  int status;			/* Error lines as last reported */
+};
+
+/* Fire the timer after NS nanoseconds, or never if zero. */
+static void
+arm (struct ready_state *r, long ns)
+{
+  struct itimerspec its;
+
+  memset (&its, 0, sizeof its);
+  its.it_value.tv_sec = ns / 1000000000;
+  its.it_value.tv_nsec = ns % 1000000000;
+  timerfd_settime (r->timerfd, 0, &its, NULL);
+}
+
+/* Arm the timer for what EVENTS, just seen, call for. */
+static void
+rearm (struct ready_state *r, int events)
+{
+  if (events & (POLL1284_DATA_AVAIL | POLL1284_WRITE_READY))
+    /* Still true, so still readable. */
+    arm (r, 1);
+  else if (r->irqfd < 0 || (r->events & POLL1284_STATUS_CHANGED))
+    arm (r, READY_POLL_NS);
+  else
+    arm (r, 0);
+}
+
+static void
+free_state (struct ready_state *r)
+{
+  if (r->timerfd >= 0)
+    close (r->timerfd);
+  if (r->epfd >= 0)
+    close (r->epfd);
+  free (r);
+}
+
+static int
+watch (struct ready_state *r, int fd)
+{
+  struct epoll_event ev;
+
+  memset (&ev, 0, sizeof ev);
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  return epoll_ctl (r->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static struct ready_state *
+start (struct parport_internal *port)
+{
+  struct ready_state *r = malloc (sizeof *r);
+
+  if (!r)
+    return NULL;
+
+  r->irqfd = -1;
+  r->events = 0;
+  r->epfd = epoll_create (2);
+  r->timerfd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if (r->epfd < 0 || r->timerfd < 0 || watch (r, r->timerfd))
+    {
+      debugprintf ("ready: can't make a poll fd for %s: %s\n", port->name,
+		   strerror (errno));
+      free_state (r);
+      return NULL;
+    }
+
+  if (port->interrupt != -1 && port->fn->get_irq_fd)
+    {
+      r->irqfd = port->fn->get_irq_fd (port);
+      if (r->irqfd >= 0 && watch (r, r->irqfd))
+	r->irqfd = -1;
+    }
+
+  debugprintf ("ready: %s is %s\n", port->name,
+	       r->irqfd >= 0 ? "interrupt driven" : "polled");
+  port->ready = r;
+  return r;
+}
+
+int
+ready_get_fd (struct parport_internal *port, int events)
+{
+  struct ready_state *r = port->ready;
+  int status;
+
+  status = port->fn->read_status (port);
+  if (status < 0)
+    return status;
+
+  if (!r)
+    {
+      r = start (port);
+      if (!r)
+	return E1284_SYS;
+    }
+
+  r->events = events;
+  r->status = status & READY_ERROR_LINES;
+  rearm (r, ready_events (port, status) & events);
+  return r->epfd;
+}
+
+int
+ready_poll (struct parport_internal *port)
+{
+  struct ready_state *r = port->ready;
+  uint64_t expired;
+  int status, events;
+
+  if (!r)
+    return E1284_NOTAVAIL;
+
+  status = port->fn->read_status (port);
+  if (status < 0)
+    return status;
+
+  while (read (r->timerfd, &expired, sizeof expired) < 0 && errno == EINTR)
+    ;
+  if (r->irqfd >= 0 && port->fn->clear_irq)
+    port->fn->clear_irq (port, NULL);
+
+  events = ready_events (port, status) & r->events;
+  if ((r->events & POLL1284_STATUS_CHANGED) &&
+      (status & READY_ERROR_LINES) != r->status)
+    events |= POLL1284_STATUS_CHANGED;
+  r->status = status & READY_ERROR_LINES;
+
+  rearm (r, events);
+  return events;
+}
+
+void
+ready_cleanup (struct parport_internal *port)
+{
+  if (port->ready)
+    free_state (port->ready);
+  port->ready = NULL;
+}
+
+#else /* !HAVE_READY_FD */
+
+int
+ready_get_fd (struct parport_internal *port, int events)
+{
+  return E1284_NOTAVAIL;
+}
+
+int
+ready_poll (struct parport_internal *port)
+{
+  return E1284_NOTAVAIL;
+}
+
+void
+ready_cleanup (struct parport_internal *port)
+{
+}
+
+#endif /* HAVE_READY_FD */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
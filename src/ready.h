@@ -0,0 +1,40 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _READY_H_
+#define _READY_H_
+
+#include "detect.h"
+
+/* The level-triggered events (POLL1284_DATA_AVAIL and
+ * POLL1284_WRITE_READY) that STATUS shows, in the port's mode. */
+extern int ready_events (struct parport_internal *port, int status);
+
+extern int ready_get_fd (struct parport_internal *port, int events);
+extern int ready_poll (struct parport_internal *port);
+extern void ready_cleanup (struct parport_internal *port);
+
+#endif /* _READY_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
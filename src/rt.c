@@ -0,0 +1,311 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Real time mode.  The software engines time the handshakes
+ * themselves, so a thread preempted between strobe and acknowledge
+ * can miss the peripheral's response or stall a transfer.  While a
+ * port in real time mode is claimed, the claiming thread runs under
+ * SCHED_FIFO, optionally on one CPU, with its memory locked and the
+ * smallest timer slack.  All of it is put back on release.
+ *
+ * The scheduler, affinity and timer slack belong to the claiming
+ * thread, so they are only put back if the port is released by that
+ * same thread.  Locked memory belongs to the whole process: it stays
+ * locked while any real time port is claimed, and is left alone if
+ * it was locked before we came along.
+ *
+ * Each step needs privileges the process may not have; whatever
+ * can't be had is reported and the rest is still done.
+ */
+
+#include "config.h"
+
+#ifdef HAVE_LINUX
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#ifdef HAVE_LINUX
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
+#include "conf.h"
+#include "debug.h"
+#include "detect.h"
+#include "ieee1284.h"
+#include "rt.h"
+
+struct rt_state
+{
+  int priority;
+  int cpu;
+  unsigned long stalls;		/* stats.c.stalls when claimed */
+
+#ifdef HAVE_LINUX
+#ifdef HAVE_PTHREAD_H
+  pthread_t thread;		/* the claiming thread */
+#endif
+
+  /* What to put back on release. */
+  int sched_saved;
+  int saved_policy;
+  struct sched_param saved_param;
+  int affinity_saved;
+  cpu_set_t saved_cpus;
+  int locked;
+  int slack_saved;
+  int saved_slack;
+  long nivcsw;			/* involuntary context switches */
+#endif
+};
+
+int
+rt_open (struct parport_internal *port, const char *name, int flags)
+{
+  const struct rt_port_config *cfg = find_rt_port_config (name);
+  struct rt_state *rt;
+
+  port->rt = NULL;
+  if (!cfg && !(flags & F1284_REALTIME))
+    return E1284_OK;
+
+  rt = malloc (sizeof *rt);
+  if (!rt)
+    return E1284_NOMEM;
+
+  memset (rt, 0, sizeof *rt);
+  rt->priority = cfg ? cfg->priority : 1;
+  rt->cpu = cfg ? cfg->cpu : -1;
+  port->rt = rt;
+  debugprintf ("Real time mode for %s: priority %d, cpu %d\n", name,
+	       rt->priority, rt->cpu);
+  return E1284_OK;
+}
+
+void
+rt_close (struct parport_internal *port)
+{
+  free (port->rt);
+  port->rt = NULL;
+}
+
+#ifdef HAVE_LINUX
+/* Claimed real time ports holding memory locked, and whether the
+ * lock is ours to undo. */
+static int mlock_count;
+static int mlock_ours;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t mlock_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define mlock_mutex_lock() pthread_mutex_lock (&mlock_mutex)
+#define mlock_mutex_unlock() pthread_mutex_unlock (&mlock_mutex)
+#else
+#define mlock_mutex_lock()
+#define mlock_mutex_unlock()
+#endif
+
+/* Does the process have any memory locked already? */
+static int
+memory_locked (void)
+{
+  FILE *f = fopen ("/proc/self/status", "r");
+  char line[128];
+  unsigned long kb = 0;
+
+  if (!f)
+    return 0;
+
+  while (fgets (line, sizeof line, f))
+    if (sscanf (line, "VmLck: %lu", &kb) == 1)
+      break;
+
+  fclose (f);
+  return kb != 0;
+}
+
+static int
+lock_memory (void)
+{
+  int ret = 1;
+
+  mlock_mutex_lock ();
+  if (!mlock_count)
+    {
+      if (memory_locked ())
+	{
+	  debugprintf ("realtime: memory already locked\n");
+	  mlock_ours = 0;
+	}
+      else if (!mlockall (MCL_CURRENT | MCL_FUTURE))
+	mlock_ours = 1;
+      else
+	{
+	  debugprintf ("realtime: can't lock memory: %s\n",
+		       strerror (errno));
+	  ret = 0;
+	}
+    }
+
+  if (ret)
+    mlock_count++;
+  mlock_mutex_unlock ();
+  return ret;
+}
+
+static void
+unlock_memory (void)
+{
+  mlock_mutex_lock ();
+  if (!--mlock_count && mlock_ours)
+    {
+      munlockall ();
+      mlock_ours = 0;
+    }
+  mlock_mutex_unlock ();
+}
+
+static long
+involuntary_switches (void)
+{
+#ifdef RUSAGE_THREAD
+  struct rusage ru;
+
+  if (!getrusage (RUSAGE_THREAD, &ru))
+    return ru.ru_nivcsw;
+#endif
+  return 0;
+}
+#endif
+
+void
+rt_enter (struct parport_internal *port)
+{
+  struct rt_state *rt = port->rt;
+#ifdef HAVE_LINUX
+  struct sched_param param;
+  int min, max;
+#endif
+
+  if (!rt)
+    return;
+
+  rt->stalls = port->stats.c.stalls;
+
+#ifdef HAVE_LINUX
+#ifdef HAVE_PTHREAD_H
+  rt->thread = pthread_self ();
+#endif
+
+  rt->saved_policy = sched_getscheduler (0);
+  if (rt->saved_policy >= 0 && !sched_getparam (0, &rt->saved_param))
+    {
+      min = sched_get_priority_min (SCHED_FIFO);
+      max = sched_get_priority_max (SCHED_FIFO);
+      param.sched_priority = rt->priority;
+      if (param.sched_priority < min)
+	param.sched_priority = min;
+      if (param.sched_priority > max)
+	param.sched_priority = max;
+
+      rt->sched_saved = !sched_setscheduler (0, SCHED_FIFO, &param);
+      if (!rt->sched_saved)
+	debugprintf ("realtime: no SCHED_FIFO: %s\n", strerror (errno));
+    }
+
+  if (rt->cpu >= 0 &&
+      !sched_getaffinity (0, sizeof rt->saved_cpus, &rt->saved_cpus))
+    {
+      cpu_set_t cpus;
+
+      CPU_ZERO (&cpus);
+      CPU_SET (rt->cpu, &cpus);
+      rt->affinity_saved = !sched_setaffinity (0, sizeof cpus, &cpus);
+      if (!rt->affinity_saved)
+	debugprintf ("realtime: can't run on cpu %d: %s\n", rt->cpu,
+		     strerror (errno));
+    }
+
+  rt->locked = lock_memory ();
+
+#ifdef PR_SET_TIMERSLACK
+  rt->saved_slack = prctl (PR_GET_TIMERSLACK, 0, 0, 0, 0);
+  rt->slack_saved = (rt->saved_slack >= 0 &&
+		     !prctl (PR_SET_TIMERSLACK, 1, 0, 0, 0));
+#endif
+
+  rt->nivcsw = involuntary_switches ();
+#endif /* HAVE_LINUX */
+}
+
+void
+rt_leave (struct parport_internal *port)
+{
+  struct rt_state *rt = port->rt;
+
+  if (!rt)
+    return;
+
+#ifdef HAVE_LINUX
+  debugprintf ("realtime: %lu stalls, %ld involuntary context switches "
+	       "while claimed\n", port->stats.c.stalls - rt->stalls,
+	       involuntary_switches () - rt->nivcsw);
+
+  if (rt->locked)
+    unlock_memory ();
+
+#ifdef HAVE_PTHREAD_H
+  if (!pthread_equal (rt->thread, pthread_self ()))
+    debugprintf ("realtime: released by another thread; "
+		 "the claiming thread keeps its settings\n");
+  else
+#endif
+    {
+#ifdef PR_SET_TIMERSLACK
+      if (rt->slack_saved)
+	prctl (PR_SET_TIMERSLACK, (unsigned long) rt->saved_slack, 0, 0, 0);
+#endif
+      if (rt->affinity_saved)
+	sched_setaffinity (0, sizeof rt->saved_cpus, &rt->saved_cpus);
+      if (rt->sched_saved)
+	sched_setscheduler (0, rt->saved_policy, &rt->saved_param);
+    }
+
+  rt->slack_saved = rt->locked = rt->affinity_saved = rt->sched_saved = 0;
+#else
+  debugprintf ("realtime: %lu stalls while claimed\n",
+	       port->stats.c.stalls - rt->stalls);
+#endif
+}
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,41 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _RT_H_
+#define _RT_H_
+
+#include "detect.h"
+
+/* Set up real time mode for a port being opened, if FLAGS include
+ * F1284_REALTIME or the configuration asks for it. */
+extern int rt_open (struct parport_internal *port, const char *name,
+		    int flags);
+extern void rt_close (struct parport_internal *port);
+
+/* Called when the port is claimed and released. */
+extern void rt_enter (struct parport_internal *port);
+extern void rt_leave (struct parport_internal *port);
+
+#endif /* _RT_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,161 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Shadow registers.  These sit between the callers and a port's own
+ * write_data, data_dir, write_control and frob_control methods, and
+ * skip writes that would leave the lines as they already are.  Each
+ * of those costs an ioctl on ppdev, or an outb_p on the io backend.
+ */
+
+#include "config.h"
+
+#include "debug.h"
+#include "detect.h"
+#include "ieee1284.h"
+#include "shadow.h"
+#include "trace.h"
+
+static const unsigned char wm = (C1284_NSTROBE |
+				 C1284_NAUTOFD |
+				 C1284_NINIT |
+				 C1284_NSELECTIN);
+
+static void
+write_data (struct parport_internal *port, unsigned char st)
+{
+  struct shadow_regs *sh = &port->shadow;
+
+  if ((sh->valid & SHADOW_DATA) && sh->data == st)
+    {
+      sh->skipped++;
+      return;
+    }
+
+  sh->write_data (port, st);
+  sh->data = st;
+  sh->valid |= SHADOW_DATA;
+  TRACE_DATA (port, st);
+}
+
+static int
+data_dir (struct parport_internal *port, int reverse)
+{
+  struct shadow_regs *sh = &port->shadow;
+  int ret;
+
+  reverse = reverse ? 1 : 0;
+  if ((sh->valid & SHADOW_DIR) && sh->reverse == reverse)
+    {
+      sh->skipped++;
+      return E1284_OK;
+    }
+
+  ret = sh->data_dir (port, reverse);
+  if (ret == E1284_OK)
+    {
+      sh->reverse = reverse;
+      sh->valid |= SHADOW_DIR;
+      TRACE_DIR (port, reverse);
+    }
+  else
+    sh->valid &= ~SHADOW_DIR;
+
+  return ret;
+}
+
+static void
+write_control (struct parport_internal *port, unsigned char ct)
+{
+  struct shadow_regs *sh = &port->shadow;
+
+  if (!(ct & ~wm) && (sh->valid & SHADOW_CTR) && sh->ctr == ct)
+    {
+      sh->skipped++;
+      return;
+    }
+
+  sh->write_control (port, ct);
+  if (ct & ~wm)
+    /* Some backends change the data direction for bit 5. */
+    sh->valid &= ~SHADOW_DIR;
+
+  sh->ctr = ct & wm;
+  sh->valid |= SHADOW_CTR;
+}
+
+static void
+frob_control (struct parport_internal *port, unsigned char mask,
+	      unsigned char val)
+{
+  struct shadow_regs *sh = &port->shadow;
+
+  if ((mask | val) & ~wm)
+    {
+      sh->frob_control (port, mask, val);
+      sh->valid &= ~(SHADOW_CTR | SHADOW_DIR);
+      return;
+    }
+
+  if (sh->valid & SHADOW_CTR)
+    {
+      unsigned char ctr = (sh->ctr & ~mask) ^ val;
+      if (ctr == sh->ctr)
+	{
+	  sh->skipped++;
+	  return;
+	}
+
+      sh->ctr = ctr;
+    }
+
+  sh->frob_control (port, mask, val);
+}
+
+void
+shadow_install (struct parport_internal *port)
+{
+  struct parport_access_methods *fn = port->fn;
+  struct shadow_regs *sh = &port->shadow;
+
+  shadow_invalidate (port);
+  sh->skipped = 0;
+
+  sh->write_data = fn->write_data;
+  if (fn->write_data)
+    fn->write_data = write_data;
+
+  sh->data_dir = fn->data_dir;
+  if (fn->data_dir)
+    fn->data_dir = data_dir;
+
+  sh->write_control = fn->write_control;
+  if (fn->write_control)
+    fn->write_control = write_control;
+
+  sh->frob_control = fn->frob_control;
+  if (fn->frob_control)
+    fn->frob_control = frob_control;
+}
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,42 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _SHADOW_H_
+#define _SHADOW_H_
+
+#include "detect.h"
+
+/* Which of the shadow registers are known to match the port. */
+#define SHADOW_DATA	(1<<0)
+#define SHADOW_CTR	(1<<1)
+#define SHADOW_DIR	(1<<2)
+
+extern void shadow_install (struct parport_internal *port);
+
+/* Call this when something other than the access methods may have
+ * changed the lines, for instance the kernel driving a transfer. */
+#define shadow_invalidate(port) ((port)->shadow.valid = 0)
+
+#endif /* _SHADOW_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
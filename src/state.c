@@ -30,6 +30,7 @@
 
 #include "config.h"
 #include "access.h"
+#include "capture.h"
 #include "conf.h"
 #include "debug.h"
 #include "default.h"
@@ -38,6 +39,12 @@
 #include "ieee1284.h"
 
 #include "parport.h"
+#include "probes.h"
+#include "rt.h"
+#include "shadow.h"
+#include "stats.h"
+#include "thread.h"
+#include "trace.h"
 
 static int
 init_port (struct parport *port, int flags, int *caps)
@@ -47,6 +54,23 @@ init_port (struct parport *port, int flags, int *caps)
 
   debugprintf ("==> init_port\n");
 
+  /* Simulated ports never fall back to real hardware. */
+  if ((capabilities & SIM_CAPABLE) && find_sim_port_config (port->name))
+    {
+      priv->type = SIM_CAPABLE;
+      memcpy (priv->fn, &sim_access_methods, sizeof *priv->fn);
+      ret = priv->fn->init (port, flags, caps);
+      debugprintf ("Got %d from simulator init\n", ret);
+      if (!ret)
+	{
+	  shadow_install (priv);
+	  stats_install (priv);
+	  trace_install (priv);
+	}
+      debugprintf ("<== %d\n", ret);
+      return ret;
+    }
+
   if ((capabilities & PPDEV_CAPABLE) && priv->device && !conf.disallow_ppdev)
     {
       priv->type = PPDEV_CAPABLE;
@@ -81,6 +105,13 @@ init_port (struct parport *port, int flags, int *caps)
       if (caps != NULL) *caps = CAP1284_COMPAT | CAP1284_NIBBLE;
     }
 
+  if (!ret)
+    {
+      shadow_install (priv);
+      stats_install (priv);
+      trace_install (priv);
+    }
+
   debugprintf ("<== %d\n", ret);
   return ret;
 }
@@ -92,10 +123,12 @@ ieee1284_open (struct parport *port, int flags, int *capabilities)
   int ret;
 
   debugprintf ("==> ieee1284_open\n");
+  PROBE2 (open_entry, port->name, flags);
 
   if (priv->opened)
     {
       debugprintf ("<== E1284_INVALIDPORT (already open)\n");
+      PROBE2 (open_return, port->name, E1284_INVALIDPORT);
       return E1284_INVALIDPORT;
     }
 
@@ -103,15 +136,32 @@ ieee1284_open (struct parport *port, int flags, int *capabilities)
     *capabilities = (CAP1284_NIBBLE | CAP1284_BYTE | CAP1284_COMPAT |
 		     CAP1284_ECPSWE);
 
-  ret = init_port (port, flags, capabilities);
+  memset (&priv->ecr, 0, sizeof priv->ecr);
+  ret = init_port (port, flags & ~F1284_REALTIME, capabilities);
   if (ret)
     {
       debugprintf ("<== %d (propagated)\n", ret);
+      PROBE2 (open_return, port->name, ret);
+      return ret;
+    }
+
+  ret = rt_open (priv, port->name, flags);
+  if (ret)
+    {
+      if (priv->fn->cleanup)
+	priv->fn->cleanup (priv);
+      trace_cleanup (priv);
+      debugprintf ("<== %d\n", ret);
+      PROBE2 (open_return, port->name, ret);
       return ret;
     }
 
+  delay_calibrate ();
+  capture_install (priv, port->name);
+  memset (&priv->poll, 0, sizeof priv->poll);
   priv->opened = 1;
-  priv->ref++;
+  add_fetch (&priv->ref, 1);
+  PROBE2 (open_return, port->name, E1284_OK);
   return E1284_OK;
 }
 
@@ -0,0 +1,245 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Statistics.  Most of the counters are bumped where the work is
+ * done: the entry points in interface.c, the wait loops, and the
+ * access methods' system calls.  Negotiation, termination and ECP
+ * turnarounds are also done by the transfer functions, through the
+ * port's methods, so those methods are wrapped here, the way the
+ * shadow registers wrap the pin writes.
+ *
+ * The time each wait takes to be answered is counted in a histogram
+ * for the event it was waiting for.  The buckets are log-linear:
+ * below 8ns there is one per nanosecond, and above that each power of
+ * two is split into four, so any latency is placed to within 25%
+ * with a few shifts.  The histograms are allocated the first time
+ * their event is waited for.
+ *
+ * The wrappers are also where the negotiation, termination and ECP
+ * turnaround probes are, since every backend's methods go through
+ * them.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "debug.h"
+#include "detect.h"
+#include "ieee1284.h"
+#include "probes.h"
+#include "stats.h"
+#include "trace.h"
+
+static int
+negotiate (struct parport_internal *port, int mode)
+{
+  struct port_stats *st = &port->stats;
+  int ret;
+
+  PROBE2 (negotiate_start, port->name, mode);
+  ret = st->negotiate (port, mode);
+  PROBE3 (negotiate_done, port->name, mode, ret);
+
+  st->c.negotiations++;
+  if (ret != E1284_OK)
+    st->c.negotiations_failed++;
+  return ret;
+}
+
+static void
+terminate (struct parport_internal *port)
+{
+  port->stats.c.terminations++;
+  PROBE2 (terminate_start, port->name, port->current_mode);
+  port->stats.terminate (port);
+  PROBE1 (terminate_done, port->name);
+}
+
+static int
+ecp_fwd_to_rev (struct parport_internal *port)
+{
+  int ret;
+
+  port->stats.c.turnarounds++;
+  PROBE1 (fwd_to_rev_start, port->name);
+  ret = port->stats.ecp_fwd_to_rev (port);
+  PROBE2 (fwd_to_rev_done, port->name, ret);
+  return ret;
+}
+
+static int
+ecp_rev_to_fwd (struct parport_internal *port)
+{
+  int ret;
+
+  port->stats.c.turnarounds++;
+  PROBE1 (rev_to_fwd_start, port->name);
+  ret = port->stats.ecp_rev_to_fwd (port);
+  PROBE2 (rev_to_fwd_done, port->name, ret);
+  return ret;
+}
+
+void
+stats_install (struct parport_internal *port)
+{
+  struct parport_access_methods *fn = port->fn;
+  struct port_stats *st = &port->stats;
+
+  memset (&st->c, 0, sizeof st->c);
+  st->poll_ns = st->sleep_ns = 0;
+  st->event = -1;
+  st->partial = 0;
+  memset (st->latency, 0, sizeof st->latency);
+
+  st->negotiate = fn->negotiate;
+  if (fn->negotiate)
+    fn->negotiate = negotiate;
+
+  st->terminate = fn->terminate;
+  if (fn->terminate)
+    fn->terminate = terminate;
+
+  st->ecp_fwd_to_rev = fn->ecp_fwd_to_rev;
+  if (fn->ecp_fwd_to_rev)
+    fn->ecp_fwd_to_rev = ecp_fwd_to_rev;
+
+  st->ecp_rev_to_fwd = fn->ecp_rev_to_fwd;
+  if (fn->ecp_rev_to_fwd)
+    fn->ecp_rev_to_fwd = ecp_rev_to_fwd;
+}
+
+#define LATENCY_SUB 4		/* Buckets to each power of two */
+
+static int
+latency_bucket (nsec_t ns)
+{
+  int octave = 0;
+
+  while (ns >= 2 * LATENCY_SUB)
+    {
+      ns >>= 1;
+      octave++;
+    }
+
+  /* Octave 0 holds 0 to 7ns, and octave n after that holds four
+   * buckets from 4 << n to 8 << n. */
+  if (octave > IEEE1284_LATENCY_BUCKETS / LATENCY_SUB - 2)
+    return IEEE1284_LATENCY_BUCKETS - 1;
+  return octave * LATENCY_SUB + (int) ns;
+}
+
+double
+ieee1284_latency_bucket (int bucket)
+{
+  if (bucket < 2 * LATENCY_SUB)
+    return bucket;
+
+  return ldexp (bucket % LATENCY_SUB + LATENCY_SUB,
+		bucket / LATENCY_SUB - 1);
+}
+
+void
+stats_wait_done (struct parport_internal *port, int ret,
+		 nsec_t waited_ns, nsec_t slept_ns)
+{
+  struct port_stats *st = &port->stats;
+  struct ieee1284_latency *lat;
+  int event = st->event;
+
+  if (ret == E1284_TIMEDOUT && st->partial)
+    /* The caller carries on waiting, and will account for all of it. */
+    return;
+
+  PROBE5 (wait_done, port->name, st->event, ret, waited_ns, slept_ns);
+
+  if (event < 0 || event >= IEEE1284_EVENTS)
+    event = IEEE1284_EVENTS;
+
+  st->poll_ns += waited_ns - slept_ns;
+  st->sleep_ns += slept_ns;
+  if (ret == E1284_TIMEDOUT)
+    {
+      st->c.timeouts++;
+      if (event < IEEE1284_EVENTS)
+	st->c.event_timeouts[event]++;
+      TRACE (port, TP_TIMEOUT, NULL,
+	     event < IEEE1284_EVENTS ? event : 0xff, 0);
+    }
+
+  lat = st->latency[event];
+  if (!lat)
+    {
+      lat = calloc (1, sizeof *lat);
+      st->latency[event] = lat;
+    }
+
+  if (lat)
+    {
+      if (ret == E1284_OK)
+	{
+	  lat->waits++;
+	  lat->count[latency_bucket (waited_ns)]++;
+	}
+      else
+	lat->timeouts++;
+    }
+
+  st->event = -1;
+}
+
+void
+stats_reset_latency (struct parport_internal *port)
+{
+  int i;
+
+  for (i = 0; i <= IEEE1284_EVENTS; i++)
+    if (port->stats.latency[i])
+      memset (port->stats.latency[i], 0, sizeof *port->stats.latency[i]);
+}
+
+void
+stats_cleanup (struct parport_internal *port)
+{
+  int i;
+
+  for (i = 0; i <= IEEE1284_EVENTS; i++)
+    {
+      free (port->stats.latency[i]);
+      port->stats.latency[i] = NULL;
+    }
+}
+
+ssize_t
+stats_transfer (struct parport_internal *port, int call, ssize_t ret)
+{
+  if (ret > 0)
+    port->stats.c.bytes[call] += ret;
+  return ret;
+}
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
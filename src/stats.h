@@ -0,0 +1,67 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include "detect.h"
+#include "probes.h"
+
+/* Wrap the port's negotiate, terminate and ECP turnaround methods so
+ * that every call is counted, including those made by the transfer
+ * functions themselves. */
+extern void stats_install (struct parport_internal *port);
+
+/* Name the IEEE 1284 event that the next wait is for, so that if it
+ * times out the timeout is counted against that event. */
+#define stats_event(port, n) ((port)->stats.event = (n))
+
+/* Fire the wait_start probe for a wait for the lines selected by
+ * MASK to be VAL, unless it is part of a wait already started. */
+#define stats_wait_start(port, mask, val)				\
+  do {									\
+    if (!(port)->stats.partial)						\
+      PROBE4 (wait_start, (port)->name, (port)->stats.event,		\
+	      (int) (mask), (int) (val));				\
+  } while (0)
+
+/* Account for a wait that has finished with RET after WAITED_NS,
+ * SLEPT_NS of which were spent asleep.  A wait that is answered is
+ * counted in the latency histogram of its event. */
+extern void stats_wait_done (struct parport_internal *port, int ret,
+			     nsec_t waited_ns, nsec_t slept_ns);
+
+/* Clear the latency histograms. */
+extern void stats_reset_latency (struct parport_internal *port);
+
+/* Free the latency histograms. */
+extern void stats_cleanup (struct parport_internal *port);
+
+/* Count the bytes moved by a transfer function that returned RET,
+ * and return RET. */
+extern ssize_t stats_transfer (struct parport_internal *port, int call,
+			       ssize_t ret);
+
+#endif /* _STATS_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
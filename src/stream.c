@@ -0,0 +1,458 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Streams.  ieee1284_stream_write copies into a ring buffer and
+ * returns, and a drain thread sends what is in the ring with the
+ * ordinary blocking transfer function, up to STREAM_CHUNK bytes at a
+ * time.  The producer only waits when the ring is full.  While the
+ * peripheral holds Busy the ring fills, and when it lets go the
+ * drain thread sends bigger chunks.
+ *
+ * The ring has one producer and one consumer and needs no lock: only
+ * the producer moves head and only the drain thread moves tail, each
+ * publishing with a release store.  The lock is taken to sleep and to
+ * be woken.  Each side says it is asleep before it looks at the ring
+ * a last time, and the other looks for that after moving its index,
+ * with a full fence between, so at least one of them sees the other.
+ *
+ * A failed transfer throws away the rest of the ring and is reported
+ * by every later call, until ieee1284_stream_flush.  A transfer that
+ * times out is tried again, since a printer may be busy for a long
+ * time.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+#endif
+
+#include "async.h"
+#include "debug.h"
+#include "detect.h"
+#include "ieee1284.h"
+#include "thread.h"
+
+#ifdef HAVE_PTHREAD_H
+
+/* Most bytes to send in one transfer. */
+#define STREAM_CHUNK 4096
+
+/* Ring sizes, before rounding up to a power of two. */
+#define STREAM_RING_DEFAULT 65536
+#define STREAM_RING_MIN 64
+
+struct ieee1284_stream
+{
+  struct parport *port;
+  int call;			/* SC1284_* of the transfer function */
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t work;		/* The drain thread sleeps here */
+  pthread_cond_t space;		/* The producer sleeps here */
+
+  char *ring;
+  size_t size;			/* A power of two */
+  size_t head;			/* Bytes ever written; the producer's */
+  size_t tail;			/* Bytes ever sent; the drain thread's */
+  size_t low, high;		/* Watermarks */
+
+  int idle;			/* The drain thread is asleep */
+  int waiting;			/* The producer is asleep */
+  int flush;			/* Asked to empty the ring */
+  int quit;
+  int error;			/* From the transfer function */
+};
+
+static size_t
+level (struct ieee1284_stream *s)
+{
+  return load_acquire (&s->head) - load_acquire (&s->tail);
+}
+
+/* Called by the producer having moved head. */
+static void
+wake_drain (struct ieee1284_stream *s)
+{
+  fence_full ();
+  if (load_relaxed (&s->idle))
+    {
+      pthread_mutex_lock (&s->lock);
+      pthread_cond_signal (&s->work);
+      pthread_mutex_unlock (&s->lock);
+    }
+}
+
+/* Called by the drain thread having moved tail or set error. */
+static void
+wake_producer (struct ieee1284_stream *s)
+{
+  fence_full ();
+  if (load_relaxed (&s->waiting))
+    {
+      pthread_mutex_lock (&s->lock);
+      pthread_cond_broadcast (&s->space);
+      pthread_mutex_unlock (&s->lock);
+    }
+}
+
+/* Send up to SEND bytes from the ring. */
+static void
+send_chunk (struct ieee1284_stream *s, size_t send)
+{
+  size_t off = s->tail & (s->size - 1);
+  ssize_t got;
+
+  if (send > s->size - off)
+    send = s->size - off;
+  if (send > STREAM_CHUNK)
+    send = STREAM_CHUNK;
+
+  got = async_transfer (s->port, s->call, 0, s->ring + off, send);
+  if (got == 0 || got == E1284_TIMEDOUT)
+    /* Still busy. */
+    return;
+
+  if (got < 0)
+    {
+      debugprintf ("stream: transfer on %s failed: %d\n", s->port->name,
+		   (int) got);
+      store_release (&s->error, (int) got);
+      store_release (&s->tail, load_acquire (&s->head));
+      wake_producer (s);
+      return;
+    }
+
+  store_release (&s->tail, s->tail + got);
+  wake_producer (s);
+}
+
+static void *
+drain (void *arg)
+{
+  struct ieee1284_stream *s = arg;
+  size_t pending;
+
+  for (;;)
+    {
+      if (load_acquire (&s->flush))
+	{
+	  pthread_mutex_lock (&s->lock);
+	  store_release (&s->tail, load_acquire (&s->head));
+	  store_release (&s->error, 0);
+	  store_release (&s->flush, 0);
+	  pthread_cond_broadcast (&s->space);
+	  pthread_mutex_unlock (&s->lock);
+	  continue;
+	}
+
+      pending = load_acquire (&s->head) - s->tail;
+      if (pending && !load_acquire (&s->error))
+	{
+	  send_chunk (s, pending);
+	  continue;
+	}
+
+      pthread_mutex_lock (&s->lock);
+      store_relaxed (&s->idle, 1);
+      fence_full ();
+      while ((load_acquire (&s->head) == s->tail ||
+	      load_acquire (&s->error)) &&
+	     !load_acquire (&s->flush) && !load_acquire (&s->quit))
+	pthread_cond_wait (&s->work, &s->lock);
+      store_relaxed (&s->idle, 0);
+      pthread_mutex_unlock (&s->lock);
+
+      if (load_acquire (&s->quit))
+	break;
+    }
+
+  return NULL;
+}
+
+/* Wait until no more than MOST bytes are in the ring, or there is an
+ * error, or the time UNTIL (if not NULL) has come. */
+static int
+wait_level (struct ieee1284_stream *s, size_t most,
+	    const struct timespec *until)
+{
+  int ret = E1284_OK;
+
+  pthread_mutex_lock (&s->lock);
+  store_relaxed (&s->waiting, 1);
+  fence_full ();
+  while (level (s) > most && !load_acquire (&s->error))
+    {
+      if (!until)
+	pthread_cond_wait (&s->space, &s->lock);
+      else if (pthread_cond_timedwait (&s->space, &s->lock,
+				       until) == ETIMEDOUT)
+	{
+	  ret = E1284_TIMEDOUT;
+	  break;
+	}
+    }
+  store_relaxed (&s->waiting, 0);
+  pthread_mutex_unlock (&s->lock);
+
+  return ret;
+}
+
+static void
+free_stream (struct ieee1284_stream *s)
+{
+  pthread_cond_destroy (&s->space);
+  pthread_cond_destroy (&s->work);
+  pthread_mutex_destroy (&s->lock);
+  free (s->ring);
+  free (s);
+}
+
+int
+ieee1284_stream_open (struct parport *port, int mode, size_t ring_size,
+		      struct ieee1284_stream **stream)
+{
+  struct parport_internal *priv = port->priv;
+  struct ieee1284_stream *s;
+  size_t size = STREAM_RING_MIN;
+  int call;
+
+  if (mode == M1284_COMPAT)
+    call = SC1284_COMPAT_WRITE;
+  else if (mode & M1284_ECP)
+    call = SC1284_ECP_WRITE_DATA;
+  else
+    return E1284_NOTIMPL;
+
+  if (!priv->claimed)
+    return E1284_INVALIDPORT;
+
+  if (!ring_size)
+    ring_size = STREAM_RING_DEFAULT;
+  while (size < ring_size)
+    {
+      size <<= 1;
+      if (!size)
+	return E1284_NOMEM;
+    }
+
+  s = malloc (sizeof *s);
+  if (!s)
+    return E1284_NOMEM;
+
+  memset (s, 0, sizeof *s);
+  s->ring = malloc (size);
+  if (!s->ring)
+    {
+      free (s);
+      return E1284_NOMEM;
+    }
+
+  s->port = port;
+  s->call = call;
+  s->size = size;
+  s->low = size / 2;
+  s->high = size;
+  pthread_mutex_init (&s->lock, NULL);
+  pthread_cond_init (&s->work, NULL);
+  pthread_cond_init (&s->space, NULL);
+
+  if (pthread_create (&s->thread, NULL, drain, s))
+    {
+      debugprintf ("stream: can't start the drain thread for %s\n",
+		   priv->name);
+      free_stream (s);
+      return E1284_SYS;
+    }
+
+  debugprintf ("stream: %lu byte ring for %s\n", (unsigned long) size,
+	       priv->name);
+  ieee1284_ref (port);
+  *stream = s;
+  return E1284_OK;
+}
+
+int
+ieee1284_stream_close (struct ieee1284_stream *stream)
+{
+  int ret = ieee1284_stream_drain (stream, NULL);
+
+  pthread_mutex_lock (&stream->lock);
+  store_release (&stream->quit, 1);
+  pthread_cond_signal (&stream->work);
+  pthread_mutex_unlock (&stream->lock);
+  pthread_join (stream->thread, NULL);
+
+  ieee1284_unref (stream->port);
+  free_stream (stream);
+  return ret;
+}
+
+ssize_t
+ieee1284_stream_write (struct ieee1284_stream *stream, int flags,
+		       const char *buffer, size_t len)
+{
+  struct ieee1284_stream *s = stream;
+  size_t done = 0, room, off, n;
+  int err;
+
+  while (done < len)
+    {
+      err = load_acquire (&s->error);
+      if (err)
+	return done ? (ssize_t) done : err;
+
+      if (level (s) >= s->high)
+	{
+	  if (flags & F1284_NONBLOCK)
+	    break;
+	  wait_level (s, s->low, NULL);
+	  continue;
+	}
+
+      room = s->high - level (s);
+      n = len - done < room ? len - done : room;
+      off = s->head & (s->size - 1);
+      if (n > s->size - off)
+	{
+	  memcpy (s->ring + off, buffer + done, s->size - off);
+	  memcpy (s->ring, buffer + done + s->size - off,
+		  n - (s->size - off));
+	}
+      else
+	memcpy (s->ring + off, buffer + done, n);
+
+      store_release (&s->head, s->head + n);
+      done += n;
+      wake_drain (s);
+    }
+
+  if (len && !done)
+    return E1284_TIMEDOUT;
+
+  return done;
+}
+
+void
+ieee1284_stream_set_watermarks (struct ieee1284_stream *stream, size_t low,
+				size_t high)
+{
+  if (!high || high > stream->size)
+    high = stream->size;
+  if (low >= high)
+    low = high - 1;
+
+  stream->low = low;
+  stream->high = high;
+}
+
+int
+ieee1284_stream_flush (struct ieee1284_stream *stream)
+{
+  pthread_mutex_lock (&stream->lock);
+  store_release (&stream->flush, 1);
+  pthread_cond_signal (&stream->work);
+  while (load_acquire (&stream->flush))
+    pthread_cond_wait (&stream->space, &stream->lock);
+  pthread_mutex_unlock (&stream->lock);
+
+  return E1284_OK;
+}
+
+int
+ieee1284_stream_drain (struct ieee1284_stream *stream,
+		       struct timeval *timeout)
+{
+  struct timespec until;
+  int ret;
+
+  if (timeout)
+    {
+      clock_gettime (CLOCK_REALTIME, &until);
+      until.tv_sec += timeout->tv_sec;
+      until.tv_nsec += timeout->tv_usec * 1000L;
+      if (until.tv_nsec >= 1000000000L)
+	{
+	  until.tv_sec++;
+	  until.tv_nsec -= 1000000000L;
+	}
+    }
+
+  ret = wait_level (stream, 0, timeout ? &until : NULL);
+  if (load_acquire (&stream->error))
+    ret = load_acquire (&stream->error);
+
+  return ret;
+}
+
+#else /* !HAVE_PTHREAD_H */
+
+int
+ieee1284_stream_open (struct parport *port, int mode, size_t ring_size,
+		      struct ieee1284_stream **stream)
+{
+  return E1284_NOTAVAIL;
+}
+
+int
+ieee1284_stream_close (struct ieee1284_stream *stream)
+{
+  return E1284_NOTAVAIL;
+}
+
+ssize_t
+ieee1284_stream_write (struct ieee1284_stream *stream, int flags,
+		       const char *buffer, size_t len)
+{
+  return E1284_NOTAVAIL;
+}
+
+void
+ieee1284_stream_set_watermarks (struct ieee1284_stream *stream, size_t low,
+				size_t high)
+{
+}
+
+int
+ieee1284_stream_flush (struct ieee1284_stream *stream)
+{
+  return E1284_NOTAVAIL;
+}
+
+int
+ieee1284_stream_drain (struct ieee1284_stream *stream,
+		       struct timeval *timeout)
+{
+  return E1284_NOTAVAIL;
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
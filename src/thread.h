@@ -0,0 +1,86 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+/*
+ * Threads.  Each port is meant to be driven by one thread at a time,
+ * with different ports driven by different threads at once, so the
+ * transfer paths share nothing that needs a lock.  What is shared is
+ * set up once for the whole process: the configuration file, the
+ * access methods found, the debugging switch and the delay
+ * calibration.  That is done under thread_once.  Port structures are
+ * shared by whoever holds a reference, so the reference counts are
+ * atomic.
+ */
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+
+typedef pthread_once_t thread_once_t;
+#define THREAD_ONCE_INIT PTHREAD_ONCE_INIT
+#define thread_once(once, fn) pthread_once ((once), (fn))
+
+#else
+
+/* No threads to race with. */
+typedef int thread_once_t;
+#define THREAD_ONCE_INIT 0
+#define thread_once(once, fn)			\
+  do {						\
+    if (!*(once))				\
+      {						\
+	*(once) = 1;				\
+	(fn) ();				\
+      }						\
+  } while (0)
+
+#endif /* HAVE_PTHREAD_H */
+
+#if defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define load_acquire(p) __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define load_relaxed(p) __atomic_load_n ((p), __ATOMIC_RELAXED)
+#define store_release(p, v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#define store_relaxed(p, v) __atomic_store_n ((p), (v), __ATOMIC_RELAXED)
+#define fence_acquire() __atomic_thread_fence (__ATOMIC_ACQUIRE)
+#define fence_release() __atomic_thread_fence (__ATOMIC_RELEASE)
+#define fence_full() __atomic_thread_fence (__ATOMIC_SEQ_CST)
+#define add_fetch(p, v) __atomic_add_fetch ((p), (v), __ATOMIC_ACQ_REL)
+#else
+/* Good enough where stores are not reordered with each other, and
+ * without threads. */
+#define load_acquire(p) (*(p))
+#define load_relaxed(p) (*(p))
+#define store_release(p, v) (*(p) = (v))
+#define store_relaxed(p, v) (*(p) = (v))
+#define fence_acquire()
+#define fence_release()
+#define fence_full()
+#define add_fetch(p, v) (*(p) += (v))
+#endif
+
+#endif /* _THREAD_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
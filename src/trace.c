@@ -0,0 +1,340 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Trace points.  Each port that is traced has a ring of fixed-size
+ * binary records, filled by whichever thread is driving the port and
+ * emptied by ieee1284_read_trace, perhaps in another thread, without
+ * locks.  Records are only turned into text when they are read.
+ *
+ * The writer announces each record in 'started' before filling it
+ * in and publishes it in 'head' afterwards.  The ring is overwritten
+ * when full, so the reader copies a record out and then checks that
+ * the writer had not started on that slot again meanwhile.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "debug.h"
+#include "delay.h"
+#include "detect.h"
+#include "ieee1284.h"
+#include "capture.h"
+#include "thread.h"
+#include "trace.h"
+
+#define ENVAR "LIBIEEE1284_TRACE"
+#define TRACE_MAX_RECORDS (1UL << 20)
+
+/* The longest line trace_read writes. */
+#define TRACE_LINE_MAX 128
+
+struct trace_record
+{
+  nsec_t time;
+  const char *tag;
+  long arg;
+  unsigned char point;
+  unsigned char a;
+};
+
+struct trace_ring
+{
+  unsigned long mask;		/* Records in the ring, less one */
+  volatile unsigned long started; /* Records the writer has begun */
+  volatile unsigned long head;	/* Records the writer has finished */
+  unsigned long tail;		/* Records the reader has taken */
+  unsigned long lost;		/* Overwritten before they were read */
+  struct trace_record rec[1];
+};
+
+static const char *call_names[SC1284_CALLS] = {
+  "claim", "release", "get_irq_fd", "clear_irq", "read_data",
+  "write_data", "wait_data", "data_dir", "read_status", "wait_status",
+  "read_control", "write_control", "frob_control", "do_nack_handshake",
+  "pin_program", "negotiate", "terminate", "ecp_fwd_to_rev",
+  "ecp_rev_to_fwd", "nibble_read", "compat_write", "byte_read",
+  "epp_read_data", "epp_write_data", "epp_read_addr", "epp_write_addr",
+  "ecp_read_data", "ecp_write_data", "ecp_read_addr", "ecp_write_addr",
+  "set_timeout"
+};
+
+void
+trace_install (struct parport_internal *port)
+{
+  struct trace_state *tr = &port->trace;
+  unsigned long want = 0, size = 1;
+  const char *env = getenv (ENVAR);
+
+  tr->ring = NULL;
+  tr->capture = NULL;
+  trace_forget (port);
+
+  if (env)
+    want = strtoul (env, NULL, 0);
+  if (want > TRACE_MAX_RECORDS)
+    want = TRACE_MAX_RECORDS;
+
+  if (want)
+    {
+      while (size < want)
+	size <<= 1;
+
+      tr->ring = malloc (sizeof *tr->ring +
+			 (size - 1) * sizeof tr->ring->rec[0]);
+      if (tr->ring)
+	{
+	  memset (tr->ring, 0, sizeof *tr->ring);
+	  tr->ring->mask = size - 1;
+	  debugprintf ("Tracing to a ring of %lu records\n", size);
+	}
+      else
+	debugprintf ("No memory for %lu trace records\n", size);
+    }
+
+  trace_update (port);
+}
+
+void
+trace_cleanup (struct parport_internal *port)
+{
+  free (port->trace.ring);
+  port->trace.ring = NULL;
+  port->trace.on = 0;
+}
+
+void
+trace_update (struct parport_internal *port)
+{
+  struct trace_state *tr = &port->trace;
+  tr->on = tr->ring || tr->capture || debug_enabled ();
+}
+
+void
+trace_forget (struct parport_internal *port)
+{
+  struct trace_state *tr = &port->trace;
+  tr->status = tr->control = tr->data = tr->reverse = -1;
+}
+
+static const char *
+call_name (unsigned char call)
+{
+  return call < SC1284_CALLS ? call_names[call] : "?";
+}
+
+/* Describe R in BUF, which has room for TRACE_LINE_MAX bytes. */
+static void
+decode (const struct trace_record *r, char *buf)
+{
+  unsigned char x = r->a;
+
+  switch (r->point)
+    {
+    case TP_ENTER:
+    case TP_LEAVE:
+      sprintf (buf, "%s %s%s%s", r->point == TP_ENTER ? "==>" : "<==",
+	       r->tag ? r->tag : "", r->tag ? "_" : "", call_name (x));
+      if (r->point == TP_LEAVE)
+	sprintf (buf + strlen (buf), " %ld", r->arg);
+      break;
+
+    case TP_STATUS:
+      sprintf (buf, "STATUS: %cnFault %cSelect %cPError %cnAck %cBusy",
+	       x & S1284_NFAULT ? ' ' : '!',
+	       x & S1284_SELECT ? ' ' : '!',
+	       x & S1284_PERROR ? ' ' : '!',
+	       x & S1284_NACK ? ' ' : '!',
+	       x & S1284_BUSY ? ' ' : '!');
+      break;
+
+    case TP_CONTROL:
+      sprintf (buf, "CONTROL: %cnStrobe %cnAutoFd %cnInit %cnSelectIn",
+	       x & C1284_NSTROBE ? ' ' : '!',
+	       x & C1284_NAUTOFD ? ' ' : '!',
+	       x & C1284_NINIT ? ' ' : '!',
+	       x & C1284_NSELECTIN ? ' ' : '!');
+      break;
+
+    case TP_DATA:
+      sprintf (buf, "DATA: %#04x", x);
+      break;
+
+    case TP_DIR:
+      strcpy (buf, x ? "DATA: reverse" : "DATA: forward");
+      break;
+
+    case TP_TIMEOUT:
+      if (x == 0xff)
+	strcpy (buf, "Timed out");
+      else
+	sprintf (buf, "Timed out at event %d", x);
+      break;
+
+    case TP_NOTE:
+      /* The tags of notes are formats written in the library. */
+      sprintf (buf, r->tag, r->arg);
+      break;
+
+    default:
+      sprintf (buf, "Unknown trace point %d", r->point);
+    }
+}
+
+void
+trace_point (struct parport_internal *port, int point, const char *tag,
+	     unsigned char a, long arg)
+{
+  struct trace_state *tr = &port->trace;
+  struct trace_ring *ring = tr->ring;
+  struct trace_record *r, local;
+  unsigned long i;
+
+  /* Only changes on the lines are worth a record. */
+  switch (point)
+    {
+    case TP_FROB:
+      /* Bits not yet seen are taken as high. */
+      a = (unsigned char) (((tr->control < 0 ? 0xff : tr->control) & ~a)
+			   ^ (arg & a));
+      point = TP_CONTROL;
+      /* Fall through */
+    case TP_CONTROL:
+      if (a == tr->control)
+	return;
+      tr->control = a;
+      break;
+
+    case TP_STATUS:
+      if (a == tr->status)
+	return;
+      tr->status = a;
+      break;
+
+    case TP_DATA:
+      if (a == tr->data)
+	return;
+      tr->data = a;
+      break;
+
+    case TP_DIR:
+      if (a == tr->reverse)
+	return;
+      tr->reverse = a;
+      break;
+    }
+
+  if (ring)
+    {
+      i = load_relaxed (&ring->started);
+      store_relaxed (&ring->started, i + 1);
+      fence_release ();
+      r = &ring->rec[i & ring->mask];
+    }
+  else
+    r = &local;
+
+  r->time = monotonic_ns ();
+  r->tag = tag;
+  r->arg = arg;
+  r->point = (unsigned char) point;
+  r->a = a;
+
+  if (ring)
+    store_release (&ring->head, i + 1);
+
+  if (tr->capture && point >= TP_STATUS && point <= TP_DIR)
+    capture_sample (port, r->time, point, a);
+
+  if (debug_enabled ())
+    {
+      char text[TRACE_LINE_MAX], when[DEBUG_TIMEOFDAY_MAX];
+
+      decode (r, text);
+      if (point == TP_STATUS || point == TP_CONTROL)
+	debugprintf ("%s %s\n", debug_timeofday (when), text);
+      else
+	debugprintf ("%s\n", text);
+    }
+}
+
+ssize_t
+trace_read (struct parport_internal *port, char *buffer, size_t len)
+{
+  struct trace_ring *ring = port->trace.ring;
+  char line[TRACE_LINE_MAX + 40], text[TRACE_LINE_MAX];
+  struct trace_record r;
+  unsigned long head, size = ring->mask + 1;
+  size_t used = 0, n;
+
+  for (;;)
+    {
+      head = load_acquire (&ring->head);
+      if (head - ring->tail > size)
+	{
+	  ring->lost += head - size - ring->tail;
+	  ring->tail = head - size;
+	}
+
+      if (ring->lost)
+	n = sprintf (line, "(%lu trace records lost)\n", ring->lost);
+      else if (ring->tail == head)
+	break;
+      else
+	{
+	  r = ring->rec[ring->tail & ring->mask];
+	  fence_acquire ();
+	  if (load_relaxed (&ring->started) - ring->tail > size)
+	    {
+	      /* Overwritten while we copied it. */
+	      ring->lost++;
+	      ring->tail++;
+	      continue;
+	    }
+
+	  decode (&r, text);
+	  n = sprintf (line, "%ld.%09ld %s\n",
+		       (long) (r.time / 1000000000),
+		       (long) (r.time % 1000000000), text);
+	}
+
+      if (n > len - used)
+	break;
+
+      memcpy (buffer + used, line, n);
+      used += n;
+      if (ring->lost)
+	ring->lost = 0;
+      else
+	ring->tail++;
+    }
+
+  return (ssize_t) used;
+}
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,97 @@
+/*
+ * libieee1284 - IEEE 1284 library
+ * Copyright (C) 2026  agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stddef.h>
+
+#include "detect.h"
+
+/* Trace points.  Each one that fires stores a fixed-size record in
+ * the port's trace ring, and says what it was on stderr as well if
+ * LIBIEEE1284_DEBUG is set.  Changes on the lines are also passed on
+ * to a capture, if there is one (see capture.c).  With neither, a
+ * trace point costs a test of port->trace.on; configure with
+ * --disable-trace to remove them altogether. */
+enum trace_point
+{
+  TP_ENTER,			/* A: SC1284_ call, TAG: engine */
+  TP_LEAVE,			/* A: SC1284_ call, TAG: engine, ARG: return */
+  TP_STATUS,			/* A: status lines, when they change */
+  TP_CONTROL,			/* A: control lines, when they change */
+  TP_FROB,			/* A: mask, ARG: value; kept as TP_CONTROL */
+  TP_DATA,			/* A: data lines, when they change */
+  TP_DIR,			/* A: 1 for reverse, when it changes */
+  TP_TIMEOUT,			/* A: IEEE 1284 event, or 0xff */
+  TP_NOTE			/* TAG: printf format for ARG, a long */
+};
+
+#ifdef DISABLE_TRACE
+#define trace_on(port) 0
+#else
+#define trace_on(port) ((port)->trace.on)
+#endif
+
+#define TRACE(port, point, tag, a, arg)					\
+  do {									\
+    if (trace_on (port))						\
+      trace_point ((port), (point), (tag), (unsigned char) (a),		\
+		   (long) (arg));					\
+  } while (0)
+
+#define TRACE_ENTER(port, tag, call) TRACE (port, TP_ENTER, tag, call, 0)
+#define TRACE_LEAVE(port, tag, call, ret)	\
+  TRACE (port, TP_LEAVE, tag, call, ret)
+#define TRACE_STATUS(port, st) TRACE (port, TP_STATUS, NULL, st, 0)
+#define TRACE_CONTROL(port, ct) TRACE (port, TP_CONTROL, NULL, ct, 0)
+#define TRACE_FROB(port, mask, val) TRACE (port, TP_FROB, NULL, mask, val)
+#define TRACE_DATA(port, d) TRACE (port, TP_DATA, NULL, d, 0)
+#define TRACE_DIR(port, reverse) TRACE (port, TP_DIR, NULL, (reverse) != 0, 0)
+#define TRACE_NOTE(port, fmt, arg) TRACE (port, TP_NOTE, fmt, 0, arg)
+
+/* Set up tracing for a newly opened port: a ring of as many records
+ * as LIBIEEE1284_TRACE says, if it is set. */
+extern void trace_install (struct parport_internal *port);
+extern void trace_cleanup (struct parport_internal *port);
+
+/* Work out port->trace.on again, after adding or removing a ring or
+ * a capture. */
+extern void trace_update (struct parport_internal *port);
+
+/* Forget what the lines were, so that the next trace point for each
+ * is recorded whether it changed or not. */
+extern void trace_forget (struct parport_internal *port);
+
+extern void trace_point (struct parport_internal *port, int point,
+			 const char *tag, unsigned char a, long arg);
+
+/* Take records from the ring and write them to BUFFER as lines of
+ * text, as many as fit in LEN bytes.  Returns the number of bytes
+ * written. */
+extern ssize_t trace_read (struct parport_internal *port, char *buffer,
+			   size_t len);
+
+#endif /* _TRACE_H_ */
+
+/*
+ * Local Variables:
+ * eval: (c-set-style "gnu")
+ * End:
+ */
@@ -0,0 +1,432 @@
+/* Throughput and latency benchmark for the block transfer functions.
+ *
+ * By default this runs against simulated ports, one of them with an
+ * ECP FIFO and EPP registers, described in a temporary configuration
+ * file; use -c and -p to run it against other ports.  Results are
+ * written to stdout as JSON.  With -L, each result also has the
+ * response latency histogram of every IEEE 1284 event waited for. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ieee1284.h>
+
+/* From interpose.c */
+extern unsigned long bench_syscalls;
+extern int bench_counting;
+extern const int bench_can_count;
+
+struct bench_function
+{
+  const char *name;
+  int mode;
+  ssize_t (*read) (struct parport *, int, char *, size_t);
+  ssize_t (*write) (struct parport *, int, const char *, size_t);
+};
+
+/* EPP goes last: the software EPP engine leaves the peripheral in EPP
+ * mode, and a fresh open does not reset real hardware. */
+static const struct bench_function functions[] = {
+  { "compat_write", M1284_COMPAT, NULL, ieee1284_compat_write },
+  { "nibble_read", M1284_NIBBLE, ieee1284_nibble_read, NULL },
+  { "byte_read", M1284_BYTE, ieee1284_byte_read, NULL },
+  { "ecp_write_data", M1284_ECP, NULL, ieee1284_ecp_write_data },
+  { "ecp_read_data", M1284_ECP, ieee1284_ecp_read_data, NULL },
+  { "ecp_write_addr", M1284_ECP, NULL, ieee1284_ecp_write_addr },
+  { "ecp_read_addr", M1284_ECP, ieee1284_ecp_read_addr, NULL },
+  { "epp_write_data", M1284_EPP, NULL, ieee1284_epp_write_data },
+  { "epp_read_data", M1284_EPP, ieee1284_epp_read_data, NULL },
+  { "epp_write_addr", M1284_EPP, NULL, ieee1284_epp_write_addr },
+  { "epp_read_addr", M1284_EPP, ieee1284_epp_read_addr, NULL },
+};
+#define NFUNCTIONS (sizeof (functions) / sizeof (functions[0]))
+
+static const char default_config[] =
+  "# written by libieee1284_bench\n"
+  "simulate port sim0 {\n"
+  "  latency fixed 1\n"
+  "  setup fixed 5\n"
+  "  access-time 1\n"
+  "  seed 1\n"
+  "}\n"
+  "simulate port sim1 {\n"
+  "  latency fixed 1\n"
+  "  setup fixed 5\n"
+  "  access-time 1\n"
+  "  ecp-fifo 16\n"
+  "  epp-registers 1\n"
+  "  seed 1\n"
+  "}\n";
+
+static size_t default_sizes[] = { 1, 64, 1024 };
+
+static struct
+{
+  size_t *sizes;
+  int nsizes;
+  int min_iterations;
+  int max_iterations;
+  double min_seconds;
+  const char *only;
+  int open_flags;
+  int latency;
+} opts = { default_sizes, 3, 5, 10000, 0.1, NULL, 0, 0 };
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+static double percentile (const double *sorted, int n, double p)
+{
+  int i = (int) (p * (n - 1) + 0.5);
+  return sorted[i];
+}
+
+/* The latency below which a fraction P of the waits were answered,
+ * to the resolution of the histogram. */
+static double latency_percentile (const struct ieee1284_latency *lat,
+				  double p)
+{
+  unsigned long want = (unsigned long) (p * lat->waits + 0.5), seen = 0;
+  int i;
+
+  for (i = 0; i < IEEE1284_LATENCY_BUCKETS - 1; i++)
+    {
+      seen += lat->count[i];
+      if (seen >= want && seen)
+	break;
+    }
+
+  return ieee1284_latency_bucket (i + 1);
+}
+
+/* Print the latency histograms of the events waited for. */
+static void print_latency (struct parport *port)
+{
+  struct ieee1284_latency lat;
+  int event, i, first = 1, firstbucket;
+
+  printf (",\n          \"latency\": {");
+  for (event = -1; event < IEEE1284_EVENTS; event++)
+    {
+      if (ieee1284_get_latency (port, event, &lat) ||
+	  !(lat.waits || lat.timeouts))
+	continue;
+
+      printf ("%s\n            \"%d\": { \"waits\": %lu, "
+	      "\"timeouts\": %lu",
+	      first ? "" : ",", event, lat.waits, lat.timeouts);
+      first = 0;
+      if (lat.waits)
+	printf (", \"p50_ns\": %.0f, \"p99_ns\": %.0f",
+		latency_percentile (&lat, 0.5),
+		latency_percentile (&lat, 0.99));
+
+      printf (",\n              \"ns\": [");
+      for (i = 0, firstbucket = 1; i < IEEE1284_LATENCY_BUCKETS; i++)
+	if (lat.count[i])
+	  {
+	    printf ("%s[%.0f, %lu]", firstbucket ? "" : ", ",
+		    ieee1284_latency_bucket (i), lat.count[i]);
+	    firstbucket = 0;
+	  }
+      printf ("] }");
+    }
+  printf (" }");
+}
+
+/* Run one function at one size, and print its JSON object.  Returns
+ * the error code that stopped it, or 0. */
+static int run_size (struct parport *port, const struct bench_function *f,
+		     size_t size, char *buf, int first)
+{
+  double *samples = malloc (opts.max_iterations * sizeof (double));
+  double elapsed = 0;
+  unsigned long syscalls = 0;
+  size_t total = 0;
+  int n = 0, err = 0;
+
+  if (!samples)
+    return E1284_NOMEM;
+
+  if (opts.latency)
+    ieee1284_reset_stats (port);
+
+  while (n < opts.max_iterations &&
+	 (n < opts.min_iterations || elapsed < opts.min_seconds * 1e9))
+    {
+      double t;
+      ssize_t got;
+
+      bench_syscalls = 0;
+      bench_counting = 1;
+      t = now ();
+      if (f->read)
+	got = f->read (port, 0, buf, size);
+      else
+	got = f->write (port, 0, buf, size);
+      t = now () - t;
+      bench_counting = 0;
+
+      if (got <= 0)
+	{
+	  err = got ? got : E1284_TIMEDOUT;
+	  break;
+	}
+
+      samples[n++] = t / got;
+      elapsed += t;
+      total += got;
+      syscalls += bench_syscalls;
+    }
+
+  printf ("%s\n        { \"function\": \"%s\", \"size\": %lu, "
+	  "\"iterations\": %d, \"bytes\": %lu, \"seconds\": %.9f",
+	  first ? "" : ",", f->name, (unsigned long) size, n,
+	  (unsigned long) total, elapsed / 1e9);
+  if (n)
+    {
+      qsort (samples, n, sizeof (double), compare);
+      printf (",\n          \"bytes_per_second\": %.1f,\n"
+	      "          \"ns_per_byte\": { \"min\": %.1f, \"p50\": %.1f, "
+	      "\"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f }",
+	      total / (elapsed / 1e9), samples[0],
+	      percentile (samples, n, 0.5), percentile (samples, n, 0.9),
+	      percentile (samples, n, 0.99), samples[n - 1]);
+      if (bench_can_count)
+	printf (",\n          \"syscalls_per_byte\": %.3f",
+		(double) syscalls / total);
+      else
+	printf (",\n          \"syscalls_per_byte\": null");
+    }
+  if (opts.latency)
+    print_latency (port);
+  if (err)
+    printf (",\n          \"error\": %d", err);
+  printf (" }");
+
+  free (samples);
+  return err;
+}
+
+/* Run one function across all sizes on a freshly opened port. */
+static void run_function (struct parport *port,
+			  const struct bench_function *f, char *buf,
+			  int *first)
+{
+  int caps, err, i;
+
+  err = ieee1284_open (port, opts.open_flags, &caps);
+  if (!err)
+    {
+      err = ieee1284_claim (port);
+      if (err)
+	ieee1284_close (port);
+    }
+  if (!err && f->mode != M1284_COMPAT)
+    {
+      err = ieee1284_negotiate (port, f->mode);
+      if (err)
+	{
+	  ieee1284_release (port);
+	  ieee1284_close (port);
+	}
+    }
+
+  if (err)
+    {
+      printf ("%s\n        { \"function\": \"%s\", \"error\": %d }",
+	      *first ? "" : ",", f->name, err);
+      *first = 0;
+      return;
+    }
+
+  for (i = 0; i < opts.nsizes; i++)
+    {
+      err = run_size (port, f, opts.sizes[i], buf, *first);
+      *first = 0;
+      if (err)
+	break;
+    }
+
+  ieee1284_terminate (port);
+  ieee1284_release (port);
+  ieee1284_close (port);
+}
+
+static void run_port (struct parport *port, int first)
+{
+  size_t max = 0;
+  char *buf;
+  int i, firstresult = 1;
+
+  for (i = 0; i < opts.nsizes; i++)
+    if (opts.sizes[i] > max)
+      max = opts.sizes[i];
+
+  buf = malloc (max);
+  if (!buf)
+    return;
+  for (i = 0; i < max; i++)
+    buf[i] = i;
+
+  printf ("%s\n    { \"port\": \"%s\", \"results\": [",
+	  first ? "" : ",", port->name);
+  for (i = 0; i < NFUNCTIONS; i++)
+    if (!opts.only || strstr (functions[i].name, opts.only))
+      run_function (port, &functions[i], buf, &firstresult);
+  printf ("\n      ] }");
+
+  free (buf);
+}
+
+static int parse_sizes (char *arg)
+{
+  char *p;
+  int n = 1;
+
+  for (p = arg; *p; p++)
+    if (*p == ',')
+      n++;
+
+  opts.sizes = malloc (n * sizeof (size_t));
+  if (!opts.sizes)
+    return 1;
+
+  for (opts.nsizes = 0, p = strtok (arg, ","); p; p = strtok (NULL, ","))
+    {
+      unsigned long size = strtoul (p, NULL, 0);
+      if (!size)
+	return 1;
+      opts.sizes[opts.nsizes++] = size;
+    }
+
+  return opts.nsizes == 0;
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr,
+	   "usage: %s [-c config] [-p port]... [-s size,size,...]\n"
+	   "          [-n min-iterations] [-N max-iterations] "
+	   "[-t min-seconds]\n"
+	   "          [-f function] [-P] [-L]\n", argv0);
+  exit (1);
+}
+
+int main (int argc, char *argv[])
+{
+  struct parport_list pl;
+  const char *ports[16];
+  char config[] = "/tmp/libieee1284_benchXXXXXX";
+  int nports = 0, generated = 0;
+  int c, i, j, first = 1;
+
+  while ((c = getopt (argc, argv, "c:p:s:n:N:t:f:PL")) != -1)
+    switch (c)
+      {
+      case 'c':
+	setenv ("LIBIEEE1284_CONF", optarg, 1);
+	break;
+      case 'p':
+	if (nports == sizeof (ports) / sizeof (ports[0]))
+	  usage (argv[0]);
+	ports[nports++] = optarg;
+	break;
+      case 's':
+	if (parse_sizes (optarg))
+	  usage (argv[0]);
+	break;
+      case 'n':
+	opts.min_iterations = atoi (optarg);
+	break;
+      case 'N':
+	opts.max_iterations = atoi (optarg);
+	break;
+      case 't':
+	opts.min_seconds = atof (optarg);
+	break;
+      case 'f':
+	opts.only = optarg;
+	break;
+      case 'P':
+	opts.open_flags |= F1284_NOPAUSE;
+	break;
+      case 'L':
+	opts.latency = 1;
+	break;
+      default:
+	usage (argv[0]);
+      }
+
+  if (opts.max_iterations < 1 || opts.min_iterations > opts.max_iterations)
+    usage (argv[0]);
+
+  if (!getenv ("LIBIEEE1284_CONF"))
+    {
+      /* No configuration given: benchmark a simulated port. */
+      int fd = mkstemp (config);
+      if (fd < 0 ||
+	  write (fd, default_config, strlen (default_config)) < 0)
+	{
+	  perror (config);
+	  return 1;
+	}
+      close (fd);
+      setenv ("LIBIEEE1284_CONF", config, 1);
+      generated = 1;
+      if (!nports)
+	{
+	  ports[nports++] = "sim0";
+	  ports[nports++] = "sim1";
+	}
+    }
+  else if (!nports)
+    {
+      fprintf (stderr, "Specify the ports to benchmark with -p.\n");
+      return 1;
+    }
+
+  if (ieee1284_find_ports (&pl, 0))
+    {
+      fprintf (stderr, "Couldn't get port list\n");
+      return 1;
+    }
+
+  if (generated)
+    unlink (config);
+
+  printf ("{\n  \"syscall_counting\": %s,\n  \"ports\": [",
+	  bench_can_count ? "true" : "false");
+  for (i = 0; i < nports; i++)
+    {
+      for (j = 0; j < pl.portc; j++)
+	if (!strcmp (pl.portv[j]->name, ports[i]))
+	  break;
+
+      if (j == pl.portc)
+	{
+	  fprintf (stderr, "%s: no such port\n", ports[i]);
+	  continue;
+	}
+
+      run_port (pl.portv[j], first);
+      first = 0;
+    }
+  printf ("\n  ]\n}\n");
+
+  ieee1284_free_ports (&pl);
+  return 0;
+}
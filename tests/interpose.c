@@ -0,0 +1,144 @@
+/* Count the system calls made through the C library, by interposing
+ * the wrappers the library uses.  Only built where dlsym(RTLD_NEXT)
+ * is available. */
+
+#include "config.h"
+
+#if defined HAVE_DLFCN_H && defined __linux__
+
+#define _GNU_SOURCE
+#undef _FORTIFY_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+unsigned long bench_syscalls;
+int bench_counting;
+const int bench_can_count = 1;
+
+#define REAL(fn, ret, args)					\
+  static ret (*real_##fn) args;					\
+  if (!real_##fn)						\
+    real_##fn = (ret (*) args) dlsym (RTLD_NEXT, #fn);		\
+  if (bench_counting)						\
+    bench_syscalls++
+
+int
+ioctl (int fd, unsigned long request, ...)
+{
+  va_list ap;
+  void *arg;
+  REAL (ioctl, int, (int, unsigned long, ...));
+  va_start (ap, request);
+  arg = va_arg (ap, void *);
+  va_end (ap);
+  return real_ioctl (fd, request, arg);
+}
+
+int
+fcntl (int fd, int cmd, ...)
+{
+  va_list ap;
+  long arg;
+  REAL (fcntl, int, (int, int, ...));
+  va_start (ap, cmd);
+  arg = va_arg (ap, long);
+  va_end (ap);
+  return real_fcntl (fd, cmd, arg);
+}
+
+ssize_t
+read (int fd, void *buf, size_t count)
+{
+  REAL (read, ssize_t, (int, void *, size_t));
+  return real_read (fd, buf, count);
+}
+
+ssize_t
+write (int fd, const void *buf, size_t count)
+{
+  REAL (write, ssize_t, (int, const void *, size_t));
+  return real_write (fd, buf, count);
+}
+
+ssize_t
+pread (int fd, void *buf, size_t count, off_t offset)
+{
+  REAL (pread, ssize_t, (int, void *, size_t, off_t));
+  return real_pread (fd, buf, count, offset);
+}
+
+ssize_t
+pwrite (int fd, const void *buf, size_t count, off_t offset)
+{
+  REAL (pwrite, ssize_t, (int, const void *, size_t, off_t));
+  return real_pwrite (fd, buf, count, offset);
+}
+
+ssize_t
+preadv (int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+  REAL (preadv, ssize_t, (int, const struct iovec *, int, off_t));
+  return real_preadv (fd, iov, iovcnt, offset);
+}
+
+off_t
+lseek (int fd, off_t offset, int whence)
+{
+  REAL (lseek, off_t, (int, off_t, int));
+  return real_lseek (fd, offset, whence);
+}
+
+int
+select (int nfds, fd_set *rfds, fd_set *wfds, fd_set *efds,
+	struct timeval *timeout)
+{
+  REAL (select, int, (int, fd_set *, fd_set *, fd_set *, struct timeval *));
+  return real_select (nfds, rfds, wfds, efds, timeout);
+}
+
+int
+poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  REAL (poll, int, (struct pollfd *, nfds_t, int));
+  return real_poll (fds, nfds, timeout);
+}
+
+int
+nanosleep (const struct timespec *req, struct timespec *rem)
+{
+  REAL (nanosleep, int, (const struct timespec *, struct timespec *));
+  return real_nanosleep (req, rem);
+}
+
+int
+clock_nanosleep (clockid_t clock, int flags, const struct timespec *req,
+		 struct timespec *rem)
+{
+  REAL (clock_nanosleep, int, (clockid_t, int, const struct timespec *,
+			       struct timespec *));
+  return real_clock_nanosleep (clock, flags, req, rem);
+}
+
+int
+sched_yield (void)
+{
+  REAL (sched_yield, int, (void));
+  return real_sched_yield ();
+}
+
+#else
+
+unsigned long bench_syscalls;
+int bench_counting;
+const int bench_can_count = 0;
+
+#endif
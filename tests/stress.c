@@ -0,0 +1,1062 @@
+/* Stress benchmark for driving many ports from one process.
+ *
+ * Runs one thread per simulated port, each finding, opening,
+ * claiming and transferring on its own port with no locking between
+ * them, for 1, 2, 4... threads up to -j.  With -a, one thread drives
+ * all the ports instead, keeping two asynchronous transfers queued on
+ * each; with -l, one thread runs them all in an ieee1284_loop; with
+ * -S, each thread writes through an ieee1284_stream.  The ports are
+ * described in a temporary configuration file.  Results, including
+ * how aggregate throughput scales with the number of ports, are
+ * written to stdout as JSON.
+ *
+ * With -c, the data is checked as well: what is read against the
+ * simulated peripheral's pattern, and what is written against what
+ * the peripheral says it received.  With -C, the loop and
+ * asynchronous transfers are put through removal from a callback,
+ * cancellation and short reads instead.  Either way the exit status
+ * is non-zero if anything didn't match. */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ieee1284.h>
+
+struct stress_function
+{
+  const char *name;
+  int mode;
+  ssize_t (*read) (struct parport *, int, char *, size_t);
+  ssize_t (*write) (struct parport *, int, const char *, size_t);
+  int (*submit_read) (struct parport *, int, char *, size_t,
+		      ieee1284_callback, void *);
+  int (*submit_write) (struct parport *, int, const char *, size_t,
+		       ieee1284_callback, void *);
+  int call_read, call_write;	/* For ieee1284_loop_submit */
+};
+
+static const struct stress_function functions[] = {
+  { "compat_write", M1284_COMPAT, NULL, ieee1284_compat_write,
+    NULL, ieee1284_submit_compat_write, 0, SC1284_COMPAT_WRITE },
+  { "nibble_read", M1284_NIBBLE, ieee1284_nibble_read, NULL,
+    ieee1284_submit_nibble_read, NULL, SC1284_NIBBLE_READ, 0 },
+  { "byte_read", M1284_BYTE, ieee1284_byte_read, NULL,
+    ieee1284_submit_byte_read, NULL, SC1284_BYTE_READ, 0 },
+  { "ecp_write_data", M1284_ECP, NULL, ieee1284_ecp_write_data,
+    NULL, ieee1284_submit_ecp_write_data, 0, SC1284_ECP_WRITE_DATA },
+  { "ecp_read_data", M1284_ECP, ieee1284_ecp_read_data, NULL,
+    ieee1284_submit_ecp_read_data, NULL, SC1284_ECP_READ_DATA, 0 },
+  { "epp_write_data", M1284_EPP, NULL, ieee1284_epp_write_data,
+    NULL, ieee1284_submit_epp_write_data, 0, SC1284_EPP_WRITE_DATA },
+  { "epp_read_data", M1284_EPP, ieee1284_epp_read_data, NULL,
+    ieee1284_submit_epp_read_data, NULL, SC1284_EPP_READ_DATA, 0 },
+};
+#define NFUNCTIONS (sizeof (functions) / sizeof (functions[0]))
+
+static struct
+{
+  int max_threads;
+  size_t size;
+  double seconds;
+  const struct stress_function *function;
+  enum { THREADS, ASYNC, LOOP, STREAM } driver;
+  int check;
+} opts = { 8, 1024, 0.5, &functions[3], THREADS, 0 };
+
+static const char *driver_names[] = { "threads", "async", "loop", "stream" };
+
+/* With -c or -C, each simulated peripheral sends runs of this length
+ * and copies what it receives to the configuration file's name with
+ * the port's appended. */
+#define RUN_LENGTH 4
+
+/* For -C: transfer sizes, and how much the peripheral on simshort
+ * has to send. */
+#define CHECK_SIZE 65536
+#define SHORT_BYTES 1000
+
+/* For -C: ports with their ECR where cards put it. */
+static const struct
+{
+  const char *name;
+  unsigned long base, ecr_base;
+} ecr_ports[] = {
+  { "simlegacy", 0x378, 0 },	/* ECR at 0x77a */
+  { "simpcie", 0xd010, 0xd000 },
+};
+#define NECR_PORTS (sizeof (ecr_ports) / sizeof (ecr_ports[0]))
+static char config[] = "/tmp/libieee1284_stressXXXXXX";
+static int failed;
+
+/* Set by the main thread to end a round. */
+static int stop;
+#define stopping() __atomic_load_n (&stop, __ATOMIC_RELAXED)
+#define set_stop(v) __atomic_store_n (&stop, (v), __ATOMIC_RELAXED)
+
+struct worker
+{
+  pthread_t thread;
+  char name[16];
+  struct parport_list pl;
+  struct parport *port;
+  char *buf[2];
+  unsigned long transfers;
+  unsigned long bytes;
+  int error;
+  int caps;
+
+  /* For -c. */
+  unsigned long queued;		/* bytes of pattern queued so far */
+  unsigned long checked;	/* bytes transferred and checked */
+  unsigned long hash;		/* of the bytes written */
+  unsigned long mismatches;
+};
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* FNV-1a, continuing from HASH. */
+static unsigned long hash (unsigned long hash, const char *buf, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    hash = ((hash ^ (unsigned char) buf[i]) * 16777619UL) & 0xffffffffUL;
+  return hash;
+}
+#define HASH_INIT 2166136261UL
+
+/* What the simulated peripheral sends at OFFSET, and what we write. */
+#define sim_byte(offset) ((char) ((offset) / RUN_LENGTH))
+#define our_byte(offset) ((char) ((offset) + (offset) / 251))
+
+/* Fill BUF with the next bytes to write. */
+static void fill (struct worker *w, char *buf)
+{
+  size_t i;
+
+  if (!opts.check || opts.function->read)
+    return;
+
+  for (i = 0; i < opts.size; i++)
+    buf[i] = our_byte (w->queued + i);
+  w->queued += opts.size;
+}
+
+/* Check the GOT bytes a transfer left in BUF: if they were read, that
+ * they are what the peripheral sent; if written, add them to what it
+ * should have received. */
+static void check (struct worker *w, const char *buf, ssize_t got)
+{
+  ssize_t i;
+
+  if (!opts.check || got <= 0)
+    return;
+
+  if (!opts.function->read)
+    w->hash = hash (w->hash, buf, got);
+  else
+    for (i = 0; i < got; i++)
+      if (buf[i] != sim_byte (w->checked + i))
+	{
+	  if (!w->mismatches++)
+	    fprintf (stderr, "%s: byte %lu is %#x, not %#x\n", w->name,
+		     w->checked + i, (unsigned char) buf[i],
+		     (unsigned char) sim_byte (w->checked + i));
+	  break;
+	}
+
+  w->checked += got;
+}
+
+/* The file the peripheral on port NAME copies what it receives to. */
+static void sink_name (char *file, const char *name)
+{
+  sprintf (file, "%s.%s", config, name);
+}
+
+/* Compare what the peripheral received, now that the port is closed,
+ * with what was written.  Returns non-zero if they differ. */
+static int check_sink (const char *name, unsigned long bytes,
+		       unsigned long expect)
+{
+  char file[sizeof config + 16], buf[4096];
+  unsigned long h = HASH_INIT, n = 0;
+  size_t got;
+  FILE *f;
+
+  sink_name (file, name);
+  f = fopen (file, "rb");
+  if (!f)
+    {
+      perror (file);
+      return 1;
+    }
+
+  while ((got = fread (buf, 1, sizeof buf, f)) > 0)
+    {
+      h = hash (h, buf, got);
+      n += got;
+    }
+  fclose (f);
+
+  if (n == bytes && h == expect)
+    return 0;
+
+  fprintf (stderr, "%s: peripheral received %lu bytes (hash %#lx), "
+	   "expected %lu (hash %#lx)\n", name, n, h, bytes, expect);
+  return 1;
+}
+
+static void check_worker_sink (struct worker *w)
+{
+  if (opts.check && w->port && !opts.function->read &&
+      check_sink (w->name, w->checked, w->hash))
+    w->mismatches++;
+}
+
+/* Find, open, claim and negotiate this worker's port.  Returns
+ * non-zero, with the error noted, if that can't be done. */
+static int setup_port (struct worker *w)
+{
+  const struct stress_function *f = opts.function;
+  int err, i, j;
+
+  w->hash = HASH_INIT;
+  for (j = 0; j < 2; j++)
+    {
+      w->buf[j] = malloc (opts.size);
+      if (!w->buf[j])
+	{
+	  w->error = E1284_NOMEM;
+	  return 1;
+	}
+      for (i = 0; i < opts.size; i++)
+	w->buf[j][i] = i;
+    }
+
+  err = ieee1284_find_ports (&w->pl, 0);
+  if (err)
+    {
+      w->error = err;
+      return 1;
+    }
+
+  for (i = 0; i < w->pl.portc; i++)
+    if (!strcmp (w->pl.portv[i]->name, w->name))
+      w->port = w->pl.portv[i];
+
+  err = w->port ? ieee1284_open (w->port, 0, &w->caps) : E1284_INVALIDPORT;
+  if (!err)
+    {
+      /* Hold our own reference, as a caller sharing the port
+       * between threads would. */
+      ieee1284_ref (w->port);
+      err = ieee1284_claim (w->port);
+      if (!err && f->mode != M1284_COMPAT)
+	{
+	  err = ieee1284_negotiate (w->port, f->mode);
+	  if (err)
+	    ieee1284_release (w->port);
+	}
+      if (err)
+	{
+	  ieee1284_close (w->port);
+	  ieee1284_unref (w->port);
+	}
+    }
+
+  if (err)
+    {
+      w->error = err;
+      ieee1284_free_ports (&w->pl);
+      w->port = NULL;
+      return 1;
+    }
+
+  return 0;
+}
+
+/* Put back what setup_port did. */
+static void finish_port (struct worker *w)
+{
+  if (w->port)
+    {
+      ieee1284_terminate (w->port);
+      ieee1284_release (w->port);
+      ieee1284_close (w->port);
+      ieee1284_unref (w->port);
+      ieee1284_free_ports (&w->pl);
+      check_worker_sink (w);
+    }
+  free (w->buf[0]);
+  free (w->buf[1]);
+}
+
+/* Count a transfer that returned GOT, noting the error if it failed.
+ * Returns non-zero on failure. */
+static int count (struct worker *w, ssize_t got)
+{
+  if (got <= 0)
+    {
+      if (!w->error)
+	w->error = got ? got : E1284_TIMEDOUT;
+      return 1;
+    }
+
+  w->transfers++;
+  w->bytes += got;
+  return 0;
+}
+
+/* Write through a stream on this worker's port until told to stop,
+ * counting what the stream has taken.  Closing the stream waits for
+ * the rest to be sent, so the round's time includes it. */
+static void run_stream (struct worker *w)
+{
+  struct ieee1284_stream *stream;
+  int err;
+
+  err = ieee1284_stream_open (w->port, opts.function->mode, 0, &stream);
+  if (err)
+    {
+      w->error = err;
+      return;
+    }
+
+  while (!stopping ())
+    {
+      ssize_t got;
+
+      fill (w, w->buf[0]);
+      got = ieee1284_stream_write (stream, 0, w->buf[0], opts.size);
+      check (w, w->buf[0], got);
+      if (count (w, got))
+	break;
+    }
+
+  err = ieee1284_stream_close (stream);
+  if (err && !w->error)
+    w->error = err;
+}
+
+/* Transfer on this worker's port until told to stop. */
+static void *run_worker (void *arg)
+{
+  struct worker *w = arg;
+  const struct stress_function *f = opts.function;
+
+  if (setup_port (w))
+    ;
+  else if (opts.driver == STREAM)
+    run_stream (w);
+  else
+    while (!stopping ())
+      {
+	ssize_t got;
+
+	if (f->read)
+	  got = f->read (w->port, 0, w->buf[0], opts.size);
+	else
+	  {
+	    fill (w, w->buf[0]);
+	    got = f->write (w->port, 0, w->buf[0], opts.size);
+	  }
+
+	check (w, w->buf[0], got);
+	if (count (w, got))
+	  break;
+      }
+
+  finish_port (w);
+  return NULL;
+}
+
+static int submit (struct worker *w, char *buf)
+{
+  const struct stress_function *f = opts.function;
+  int ret;
+
+  fill (w, buf);
+  if (f->read)
+    ret = f->submit_read (w->port, 0, buf, opts.size, NULL, NULL);
+  else
+    ret = f->submit_write (w->port, 0, buf, opts.size, NULL, NULL);
+
+  if (ret < 0)
+    count (w, ret);
+  return ret < 0;
+}
+
+/* Drive all N workers' ports from this thread until UNTIL,
+ * keeping two transfers queued on each. */
+static void run_async (struct worker *workers, int n, double until)
+{
+  struct pollfd *fds = calloc (n, sizeof *fds);
+  int i, j;
+
+  if (!fds)
+    return;
+
+  for (i = 0; i < n; i++)
+    {
+      fds[i].fd = -1;
+      if (setup_port (&workers[i]))
+	continue;
+
+      fds[i].fd = ieee1284_get_completion_fd (workers[i].port);
+      fds[i].events = POLLIN;
+      if (fds[i].fd < 0)
+	count (&workers[i], fds[i].fd);
+      else
+	for (j = 0; j < 2; j++)
+	  submit (&workers[i], workers[i].buf[j]);
+    }
+
+  while (now () < until)
+    {
+      if (poll (fds, n, 10) <= 0)
+	continue;
+
+      for (i = 0; i < n; i++)
+	{
+	  struct ieee1284_completion c;
+
+	  if (!(fds[i].revents & POLLIN))
+	    continue;
+
+	  while (!ieee1284_reap (workers[i].port, F1284_NONBLOCK, &c))
+	    {
+	      check (&workers[i], c.buffer, c.result);
+	      if (count (&workers[i], c.result) ||
+		  submit (&workers[i], c.buffer))
+		break;
+	    }
+	}
+    }
+
+  /* Let what's queued finish before closing the ports. */
+  for (i = 0; i < n; i++)
+    {
+      struct ieee1284_completion c;
+
+      if (fds[i].fd >= 0)
+	while (!ieee1284_reap (workers[i].port, 0, &c))
+	  /* Not counted, but checked. */
+	  check (&workers[i], c.buffer, c.result);
+      finish_port (&workers[i]);
+    }
+
+  free (fds);
+}
+
+static struct ieee1284_loop *loop;
+static double loop_until;
+
+/* Count a transfer made by the loop and queue the next, until it's
+ * time to stop. */
+static void loop_done (struct parport *port,
+		       const struct ieee1284_completion *c)
+{
+  struct worker *w = c->data;
+
+  check (w, c->buffer, c->result);
+  if (!count (w, c->result) && now () < loop_until)
+    {
+      fill (w, c->buffer);
+      ieee1284_loop_submit (loop, port, c->call, 0, c->buffer, opts.size,
+			    loop_done, w);
+    }
+}
+
+/* Drive all N workers' ports from one loop on this thread until
+ * UNTIL. */
+static void run_loop (struct worker *workers, int n, double until)
+{
+  const struct stress_function *f = opts.function;
+  int call = f->read ? f->call_read : f->call_write;
+  int err, i;
+
+  err = ieee1284_loop_open (&loop);
+  if (err)
+    {
+      workers[0].error = err;
+      return;
+    }
+
+  loop_until = until;
+  for (i = 0; i < n; i++)
+    {
+      if (setup_port (&workers[i]))
+	continue;
+
+      err = ieee1284_loop_add (loop, workers[i].port);
+      fill (&workers[i], workers[i].buf[0]);
+      if (!err)
+	err = ieee1284_loop_submit (loop, workers[i].port, call, 0,
+				    workers[i].buf[0], opts.size,
+				    loop_done, &workers[i]);
+      if (err < 0)
+	count (&workers[i], err);
+    }
+
+  ieee1284_loop_run (loop, NULL);
+  ieee1284_loop_close (loop);
+
+  for (i = 0; i < n; i++)
+    finish_port (&workers[i]);
+}
+
+/* Run N workers at once for the configured time, and print the JSON
+ * object for the round.  Returns the aggregate throughput. */
+static double run_round (int n, double single, int first)
+{
+  struct worker *workers = calloc (n, sizeof *workers);
+  unsigned long bytes = 0, transfers = 0, slowest = 0, fastest = 0;
+  unsigned long mismatches = 0;
+  double start, elapsed, rate;
+  int i, started = 0, errors = 0;
+
+  if (!workers)
+    return 0;
+
+  for (i = 0; i < n; i++)
+    sprintf (workers[i].name, "sim%d", i);
+
+  set_stop (0);
+  start = now ();
+  if (opts.driver == ASYNC)
+    {
+      run_async (workers, n, start + opts.seconds);
+      started = n;
+    }
+  else if (opts.driver == LOOP)
+    {
+      run_loop (workers, n, start + opts.seconds);
+      started = n;
+    }
+  else
+    {
+      for (i = 0; i < n; i++)
+	{
+	  if (pthread_create (&workers[i].thread, NULL, run_worker,
+			      &workers[i]))
+	    break;
+	  started++;
+	}
+
+      usleep ((useconds_t) (opts.seconds * 1e6));
+      set_stop (1);
+      for (i = 0; i < started; i++)
+	pthread_join (workers[i].thread, NULL);
+    }
+  elapsed = now () - start;
+
+  for (i = 0; i < started; i++)
+    {
+      bytes += workers[i].bytes;
+      transfers += workers[i].transfers;
+      if (!i || workers[i].bytes < slowest)
+	slowest = workers[i].bytes;
+      if (workers[i].bytes > fastest)
+	fastest = workers[i].bytes;
+      if (workers[i].error)
+	errors++;
+      mismatches += workers[i].mismatches;
+    }
+
+  rate = bytes / elapsed;
+  printf ("%s\n    { \"%s\": %d, \"started\": %d, \"seconds\": %.6f, "
+	  "\"transfers\": %lu, \"bytes\": %lu,\n"
+	  "      \"bytes_per_second\": %.1f, "
+	  "\"per_%s\": { \"min\": %.1f, \"max\": %.1f }",
+	  first ? "" : ",", opts.driver ? "ports" : "threads", n, started,
+	  elapsed, transfers, bytes, rate, opts.driver ? "port" : "thread",
+	  slowest / elapsed, fastest / elapsed);
+  if (single > 0)
+    printf (",\n      \"scaling\": %.3f", rate / single);
+  printf (", \"errors\": %d", errors);
+  if (opts.check)
+    {
+      printf (", \"mismatches\": %lu", mismatches);
+      if (errors || mismatches)
+	failed = 1;
+    }
+  for (i = 0; i < started; i++)
+    if (workers[i].error)
+      {
+	printf (", \"first_error\": { \"port\": \"%s\", \"error\": %d }",
+		workers[i].name, workers[i].error);
+	break;
+      }
+  printf (" }");
+
+  free (workers);
+  return rate;
+}
+
+/* A transfer made for -C, and what it completed with. */
+struct check_transfer
+{
+  struct worker *w;
+  int remove;			/* take the port out of the loop after */
+  int done;
+  ssize_t result;
+};
+
+static void check_done (struct parport *port,
+			const struct ieee1284_completion *c)
+{
+  struct check_transfer *t = c->data;
+
+  t->done = 1;
+  t->result = c->result;
+  check (t->w, c->buffer, c->result);
+  if (t->remove)
+    ieee1284_loop_remove (loop, port);
+}
+
+static void report (const char *name, int ok)
+{
+  static int first = 1;
+
+  printf ("%s\n    { \"check\": \"%s\", \"ok\": %s }", first ? "" : ",",
+	  name, ok ? "true" : "false");
+  first = 0;
+  if (!ok)
+    failed = 1;
+}
+
+/* Set up W on port NAME for F.  Returns non-zero, having reported
+ * CHECK as failed, if that can't be done. */
+static int check_setup (struct worker *w, const char *name,
+			const struct stress_function *f, const char *check)
+{
+  memset (w, 0, sizeof *w);
+  strcpy (w->name, name);
+  opts.function = f;
+  if (!setup_port (w))
+    return 0;
+
+  fprintf (stderr, "%s: can't set up %s: %d\n", check, name, w->error);
+  finish_port (w);
+  report (check, 0);
+  return 1;
+}
+
+/* Reads from a peripheral with less to send than was asked for
+ * should return what there was, through the loop or not. */
+static void check_short_read (const struct stress_function *f, int use_loop)
+{
+  struct check_transfer t = { NULL, 0, 0, 0 };
+  struct worker w;
+  struct timeval tv = { 5, 0 };
+  char name[64];
+  int id;
+
+  sprintf (name, "%s_short_%s", use_loop ? "loop" : "async", f->name);
+  if (check_setup (&w, "simshort", f, name))
+    return;
+
+  t.w = &w;
+  if (use_loop)
+    {
+      if (!ieee1284_loop_open (&loop))
+	{
+	  if (!ieee1284_loop_add (loop, w.port) &&
+	      ieee1284_loop_submit (loop, w.port, f->call_read, 0, w.buf[0],
+				    opts.size, check_done, &t) > 0)
+	    ieee1284_loop_run (loop, &tv);
+	  ieee1284_loop_close (loop);
+	}
+    }
+  else
+    {
+      struct ieee1284_completion c;
+
+      id = f->submit_read (w.port, 0, w.buf[0], opts.size, NULL, NULL);
+      if (id > 0 && !ieee1284_reap (w.port, 0, &c))
+	{
+	  t.done = 1;
+	  t.result = c.result;
+	  check (&w, c.buffer, c.result);
+	}
+    }
+
+  if (t.done && t.result != SHORT_BYTES)
+    fprintf (stderr, "%s: read %ld bytes, not %d\n", name,
+	     (long) t.result, SHORT_BYTES);
+  finish_port (&w);
+  report (name, t.done && t.result == SHORT_BYTES && !w.mismatches);
+}
+
+/* Transfers queued on a port that is then taken out of the loop
+ * should complete as cancelled, and none of them should be made. */
+static void check_loop_cancel (void)
+{
+  struct check_transfer t[3];
+  struct worker w;
+  int i, ok = 0;
+
+  if (check_setup (&w, "sim0", &functions[0], "loop_cancel"))
+    return;
+
+  memset (t, 0, sizeof t);
+  if (!ieee1284_loop_open (&loop))
+    {
+      ok = !ieee1284_loop_add (loop, w.port);
+      for (i = 0; ok && i < 3; i++)
+	{
+	  t[i].w = &w;
+	  fill (&w, w.buf[i & 1]);
+	  ok = ieee1284_loop_submit (loop, w.port, SC1284_COMPAT_WRITE, 0,
+				     w.buf[i & 1], opts.size, check_done,
+				     &t[i]) > 0;
+	}
+
+      if (ok)
+	ok = !ieee1284_loop_remove (loop, w.port);
+      if (ok)
+	ok = !ieee1284_loop_run (loop, NULL);
+      for (i = 0; ok && i < 3; i++)
+	ok = t[i].done && t[i].result == E1284_CANCELLED;
+      ieee1284_loop_close (loop);
+    }
+
+  finish_port (&w);
+  report ("loop_cancel", ok && !w.mismatches);
+}
+
+/* A transfer cancelled before it starts completes as cancelled, and
+ * the ones before it are made. */
+static void check_async_cancel (void)
+{
+  struct ieee1284_completion c;
+  struct worker w;
+  int i, id = 0, ok = 1;
+
+  if (check_setup (&w, "sim0", &functions[0], "async_cancel"))
+    return;
+
+  for (i = 0; ok && i < 3; i++)
+    {
+      fill (&w, w.buf[i & 1]);
+      id = ieee1284_submit_compat_write (w.port, 0, w.buf[i & 1], opts.size,
+					 NULL, NULL);
+      ok = id > 0;
+    }
+
+  if (ok)
+    ok = !ieee1284_cancel (w.port, id);
+  for (i = 0; ok && i < 3; i++)
+    {
+      ok = !ieee1284_reap (w.port, 0, &c);
+      if (ok)
+	{
+	  check (&w, c.buffer, c.result);
+	  ok = c.result == (i < 2 ? (ssize_t) opts.size : E1284_CANCELLED);
+	}
+    }
+
+  finish_port (&w);
+  report ("async_cancel", ok && !w.mismatches);
+}
+
+/* A callback that takes its own port out of the loop cancels the
+ * rest of that port's transfers and leaves the other ports going. */
+static void check_loop_remove (void)
+{
+  struct check_transfer t[2][2];
+  struct worker w[2];
+  struct timeval tv = { 5, 0 };
+  int i, j, ok = 0;
+
+  if (check_setup (&w[0], "sim0", &functions[0], "loop_remove"))
+    return;
+  if (check_setup (&w[1], "sim1", &functions[0], "loop_remove"))
+    {
+      finish_port (&w[0]);
+      return;
+    }
+
+  memset (t, 0, sizeof t);
+  t[0][0].remove = 1;
+  if (!ieee1284_loop_open (&loop))
+    {
+      ok = 1;
+      for (i = 0; ok && i < 2; i++)
+	{
+	  ok = !ieee1284_loop_add (loop, w[i].port);
+	  for (j = 0; ok && j < 2; j++)
+	    {
+	      t[i][j].w = &w[i];
+	      fill (&w[i], w[i].buf[j]);
+	      ok = ieee1284_loop_submit (loop, w[i].port, SC1284_COMPAT_WRITE,
+					 0, w[i].buf[j], opts.size, check_done,
+					 &t[i][j]) > 0;
+	    }
+	}
+
+      if (ok)
+	ok = ieee1284_loop_run (loop, &tv) >= 0;
+      for (i = 0; ok && i < 2; i++)
+	ok = t[i][0].done && t[i][1].done;
+      ok = (ok && t[0][0].result == opts.size
+	    && t[0][1].result == E1284_CANCELLED
+	    && t[1][0].result == opts.size && t[1][1].result == opts.size);
+      ieee1284_loop_close (loop);
+    }
+
+  finish_port (&w[0]);
+  finish_port (&w[1]);
+  report ("loop_remove", ok && !w[0].mismatches && !w[1].mismatches);
+}
+
+/* The ECR should be found wherever the port's registers are, and its
+ * FIFO should move the data both ways. */
+static void check_ecr_base (const char *name)
+{
+  struct worker w;
+  char check_name[64];
+  ssize_t got;
+  int ok;
+
+  sprintf (check_name, "ecr_base_%s", name);
+  if (check_setup (&w, name, &functions[3], check_name))
+    return;
+
+  ok = (w.caps & CAP1284_ECP) != 0;
+  fill (&w, w.buf[0]);
+  got = ieee1284_ecp_write_data (w.port, 0, w.buf[0], opts.size);
+  check (&w, w.buf[0], got);
+  ok = ok && got == (ssize_t) opts.size;
+  finish_port (&w);
+  ok = ok && !w.mismatches;
+
+  if (check_setup (&w, name, &functions[4], check_name))
+    return;
+
+  got = ieee1284_ecp_read_data (w.port, 0, w.buf[0], opts.size);
+  check (&w, w.buf[0], got);
+  ok = ok && got == (ssize_t) opts.size && !w.mismatches;
+  finish_port (&w);
+
+  report (check_name, ok);
+}
+
+static void run_checks (void)
+{
+  static const int reads[] = { 1, 2, 4 };
+  int i;
+
+  printf ("{\n  \"checks\": [");
+  for (i = 0; i < sizeof reads / sizeof reads[0]; i++)
+    {
+      check_short_read (&functions[reads[i]], 1);
+      check_short_read (&functions[reads[i]], 0);
+    }
+  check_loop_cancel ();
+  check_async_cancel ();
+  check_loop_remove ();
+  for (i = 0; i < NECR_PORTS; i++)
+    check_ecr_base (ecr_ports[i].name);
+  printf ("\n  ]\n}\n");
+}
+
+static int write_config (void)
+{
+  char file[sizeof config + 16];
+  FILE *f;
+  int fd, i;
+
+  fd = mkstemp (config);
+  if (fd < 0)
+    return 1;
+
+  f = fdopen (fd, "w");
+  if (!f)
+    {
+      close (fd);
+      return 1;
+    }
+
+  fprintf (f, "# written by libieee1284_stress\n");
+  for (i = 0; i < opts.max_threads; i++)
+    {
+      fprintf (f, "simulate port sim%d {\n"
+	       "  latency fixed 1\n"
+	       "  setup fixed 5\n"
+	       "  access-time 1\n"
+	       "  ecp-fifo 16\n"
+	       "  epp-registers 1\n"
+	       "  seed %d\n", i, i + 1);
+      if (opts.check)
+	{
+	  char name[16];
+
+	  sprintf (name, "sim%d", i);
+	  sink_name (file, name);
+	  fprintf (f, "  run-length %d\n"
+		   "  sink %s\n", RUN_LENGTH, file);
+	}
+      fprintf (f, "}\n");
+    }
+
+  /* For -C: a peripheral with little to send. */
+  fprintf (f, "simulate port simshort {\n"
+	   "  latency fixed 1\n"
+	   "  setup fixed 5\n"
+	   "  access-time 1\n"
+	   "  ecp-fifo 16\n"
+	   "  run-length %d\n"
+	   "  reverse-bytes %d\n"
+	   "}\n", RUN_LENGTH, SHORT_BYTES);
+
+  for (i = 0; i < NECR_PORTS; i++)
+    {
+      sink_name (file, ecr_ports[i].name);
+      fprintf (f, "simulate port %s {\n"
+	       "  latency fixed 1\n"
+	       "  setup fixed 5\n"
+	       "  access-time 1\n"
+	       "  ecp-fifo 16\n"
+	       "  run-length %d\n"
+	       "  base %#lx\n"
+	       "  ecr-base %#lx\n"
+	       "  sink %s\n"
+	       "}\n", ecr_ports[i].name, RUN_LENGTH, ecr_ports[i].base,
+	       ecr_ports[i].ecr_base, file);
+    }
+
+  return fclose (f) != 0;
+}
+
+static void usage (const char *argv0)
+{
+  fprintf (stderr,
+	   "usage: %s [-a|-l|-S] [-c] [-j max-threads] [-s size] "
+	   "[-t seconds] [-f function]\n"
+	   "       %s -C\n", argv0, argv0);
+  exit (1);
+}
+
+/* Remove the configuration file and whatever it made. */
+static void remove_files (void)
+{
+  char file[sizeof config + 16], name[16];
+  int i;
+
+  for (i = 0; i < opts.max_threads; i++)
+    {
+      sprintf (name, "sim%d", i);
+      sink_name (file, name);
+      unlink (file);
+    }
+  for (i = 0; i < NECR_PORTS; i++)
+    {
+      sink_name (file, ecr_ports[i].name);
+      unlink (file);
+    }
+  unlink (config);
+}
+
+int main (int argc, char *argv[])
+{
+  double single = 0;
+  int c, i, n, checks = 0;
+
+  while ((c = getopt (argc, argv, "alScCj:s:t:f:")) != -1)
+    switch (c)
+      {
+      case 'c':
+	opts.check = 1;
+	break;
+      case 'C':
+	checks = 1;
+	break;
+      case 'a':
+	opts.driver = ASYNC;
+	break;
+      case 'l':
+	opts.driver = LOOP;
+	break;
+      case 'S':
+	opts.driver = STREAM;
+	break;
+      case 'j':
+	opts.max_threads = atoi (optarg);
+	break;
+      case 's':
+	opts.size = strtoul (optarg, NULL, 0);
+	break;
+      case 't':
+	opts.seconds = atof (optarg);
+	break;
+      case 'f':
+	for (i = 0; i < NFUNCTIONS; i++)
+	  if (!strcmp (functions[i].name, optarg))
+	    break;
+	if (i == NFUNCTIONS)
+	  usage (argv[0]);
+	opts.function = &functions[i];
+	break;
+      default:
+	usage (argv[0]);
+      }
+
+  if (opts.max_threads < 1 || !opts.size || opts.seconds <= 0 ||
+      (opts.driver == STREAM && opts.function->read))
+    usage (argv[0]);
+
+  if (checks)
+    {
+      opts.check = 1;
+      opts.size = CHECK_SIZE;
+      if (opts.max_threads < 2)
+	opts.max_threads = 2;
+    }
+
+  if (write_config ())
+    {
+      perror (config);
+      return 1;
+    }
+  setenv ("LIBIEEE1284_CONF", config, 1);
+
+  if (checks)
+    {
+      run_checks ();
+      remove_files ();
+      return failed;
+    }
+
+  printf ("{\n  \"function\": \"%s\", \"size\": %lu, "
+	  "\"driver\": \"%s\",\n  \"rounds\": [", opts.function->name,
+	  (unsigned long) opts.size, driver_names[opts.driver]);
+  for (n = 1; ; n *= 2)
+    {
+      if (n > opts.max_threads)
+	n = opts.max_threads;
+
+      if (n == 1)
+	single = run_round (n, 0, 1);
+      else
+	run_round (n, single, 0);
+
+      if (n == opts.max_threads)
+	break;
+    }
+  printf ("\n  ]\n}\n");
+
+  remove_files ();
+  return failed;
+}